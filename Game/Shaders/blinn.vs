@@ -3,6 +3,12 @@
 layout(location = 0) in vec3 vertex_position;
 layout(location = 1) in vec3 vertex_normal;
 layout(location = 2) in vec2 vertex_uv0;
+layout(location = 3) in mat4 instance_model;
+layout(location = 7) in vec4 instance_position_offset;
+layout(location = 8) in vec4 instance_position_scale;
+
+// Quantized normals come as two normalized components in octahedral encoding
+uniform int octahedralNormals;
 
 layout (std140) uniform Matrices
 {
@@ -10,16 +16,27 @@ layout (std140) uniform Matrices
     mat4 view;
 };
 
-uniform mat4 model;
-
 out vec3 position;
 out vec3 normal;
 out vec2 uv0;
 
+vec3 decode_octahedral(vec2 encoded)
+{
+    vec3 n = vec3(encoded, 1.0f - abs(encoded.x) - abs(encoded.y));
+    if (n.z < 0.0f)
+    {
+        n.xy = (1.0f - abs(n.yx)) * mix(vec2(-1.0f), vec2(1.0f), greaterThanEqual(n.xy, vec2(0.0f)));
+    }
+    return normalize(n);
+}
+
 void main()
 {
-    position = (model * vec4(vertex_position, 1.0f)).xyz;
-	normal = (model * vec4(vertex_normal, 0.0f)).xyz;
+    vec3 local_position = vertex_position * instance_position_scale.xyz + instance_position_offset.xyz;
+    vec3 local_normal = (octahedralNormals != 0) ? decode_octahedral(vertex_normal.xy) : vertex_normal;
+
+    position = (instance_model * vec4(local_position, 1.0f)).xyz;
+	normal = (instance_model * vec4(local_normal, 0.0f)).xyz;
     gl_Position = proj * view * vec4(position, 1.0f);
     uv0 = vertex_uv0;
 }
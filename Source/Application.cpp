@@ -11,8 +11,11 @@
 #include "ModuleLibrary.h"
 #include "ModuleFileSystem.h"
 #include "ModuleTime.h"
+#include "JobSystem.h"
 
 Application::Application() {
+	jobs = new JobSystem();
+
 	modules.push_back(fileSystem = new ModuleFileSystem());
 	modules.push_back(window = new ModuleWindow());
 	modules.push_back(renderer = new ModuleRender());
@@ -33,16 +36,25 @@ Application::~Application() {
 		*it = nullptr;
 	}
 	modules.clear();
+
+	delete jobs;
+	jobs = nullptr;
 }
 
 bool Application::Init() {
 
 	bool ret = true;
 
+	jobs->Init();
+
 	for(std::list<Module*>::iterator it = modules.begin(); it != modules.end() && ret; ++it) { 
 		ret = (*it)->Init();
 	}
 
+	if (ret && headless) {
+		scene->LoadScene();
+	}
+
 	return ret;
 }
 
@@ -68,6 +80,10 @@ update_status Application::Update() {
 }
 
 void Application::FinishUpdate() {
+	if (headless) {
+		return;
+	}
+
 	int ms_cap = 1000 / time->maxFps;
 	if (time->frameTimer.Read() < ms_cap) {
 		SDL_Delay(ms_cap - time->frameTimer.Read());
@@ -81,6 +97,8 @@ bool Application::CleanUp() {
 		ret = (*it)->CleanUp();
 	}
 
+	jobs->CleanUp();
+
 	return ret;
 }
 
@@ -21,6 +21,7 @@ class ModuleScene;
 class ModuleDebugDraw;
 class ModuleFileSystem;
 class ModuleLibrary;
+class JobSystem;
 
 class Application
 {
@@ -50,6 +51,12 @@ class Application
 		ModuleFileSystem* fileSystem = nullptr;
 		ModuleLibrary* library = nullptr;
 
+		JobSystem* jobs = nullptr;
+
+		// Set from the command line, runs without window nor GL context and records the render submission
+		bool headless = false;
+		unsigned benchmarkFrames = 0u;
+
 	private:
 		std::list<Module*>	modules;
 
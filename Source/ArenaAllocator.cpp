@@ -0,0 +1,168 @@
+#include "Globals.h"
+#include "ArenaAllocator.h"
+#include <assert.h>
+
+static unsigned AlignUp(unsigned value, unsigned alignment) {
+	return ((value + alignment - 1u) / alignment) * alignment;
+}
+
+ArenaAllocator::ArenaAllocator(unsigned capacity) {
+	Grow(capacity);
+}
+
+ArenaAllocator::~ArenaAllocator() { }
+
+bool ArenaAllocator::Allocate(unsigned size, unsigned alignment, ArenaBlock& block) {
+	assert(alignment > 0u);
+
+	if (size == 0u) {
+		return false;
+	}
+
+	// First fit, blocks are sorted by offset so the arena is filled from the beginning
+	for (std::map<unsigned, unsigned>::iterator it = freeBlocks.begin(); it != freeBlocks.end(); ++it) {
+		unsigned blockOffset = it->first;
+		unsigned blockSize = it->second;
+		unsigned alignedOffset = AlignUp(blockOffset, alignment);
+		unsigned padding = alignedOffset - blockOffset;
+
+		if (padding + size <= blockSize) {
+			freeBlocks.erase(it);
+
+			if (padding > 0u) {
+				freeBlocks[blockOffset] = padding;
+			}
+
+			unsigned remaining = blockSize - padding - size;
+			if (remaining > 0u) {
+				freeBlocks[alignedOffset + size] = remaining;
+			}
+
+			UsedBlock usedBlock;
+			usedBlock.size = size;
+			usedBlock.alignment = alignment;
+			usedBlocks[alignedOffset] = usedBlock;
+			used += size;
+
+			block.offset = alignedOffset;
+			block.size = size;
+
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void ArenaAllocator::Free(const ArenaBlock& block) {
+	std::map<unsigned, UsedBlock>::iterator it = usedBlocks.find(block.offset);
+
+	if (it == usedBlocks.end()) {
+		LOG("Error: Arena block at %u is not allocated", block.offset);
+		return;
+	}
+
+	used -= it->second.size;
+	InsertFreeBlock(it->first, it->second.size);
+	usedBlocks.erase(it);
+}
+
+void ArenaAllocator::Grow(unsigned newCapacity) {
+	if (newCapacity <= capacity) {
+		return;
+	}
+
+	unsigned oldCapacity = capacity;
+	capacity = newCapacity;
+	InsertFreeBlock(oldCapacity, newCapacity - oldCapacity);
+}
+
+// Packs every live block to the beginning of the arena, all of them are reported so the caller can copy into a fresh buffer
+void ArenaAllocator::Defragment(std::vector<ArenaMove>& moves) {
+	moves.clear();
+	moves.reserve(usedBlocks.size());
+
+	std::map<unsigned, UsedBlock> packedBlocks;
+	freeBlocks.clear();
+
+	unsigned cursor = 0u;
+	for (std::map<unsigned, UsedBlock>::const_iterator it = usedBlocks.begin(); it != usedBlocks.end(); ++it) {
+		unsigned destination = AlignUp(cursor, it->second.alignment);
+
+		if (destination > cursor) {
+			freeBlocks[cursor] = destination - cursor;
+		}
+
+		ArenaMove move;
+		move.from = it->first;
+		move.to = destination;
+		move.size = it->second.size;
+		moves.push_back(move);
+
+		packedBlocks[destination] = it->second;
+		cursor = destination + it->second.size;
+	}
+
+	if (cursor < capacity) {
+		freeBlocks[cursor] = capacity - cursor;
+	}
+
+	usedBlocks.swap(packedBlocks);
+}
+
+unsigned ArenaAllocator::Capacity() const {
+	return capacity;
+}
+
+unsigned ArenaAllocator::Used() const {
+	return used;
+}
+
+unsigned ArenaAllocator::LargestFreeBlock() const {
+	unsigned largest = 0u;
+
+	for (std::map<unsigned, unsigned>::const_iterator it = freeBlocks.begin(); it != freeBlocks.end(); ++it) {
+		largest = MAX(largest, it->second);
+	}
+
+	return largest;
+}
+
+unsigned ArenaAllocator::FreeBlocksNumber() const {
+	return freeBlocks.size();
+}
+
+float ArenaAllocator::Fragmentation() const {
+	unsigned freeSpace = capacity - used;
+
+	if (freeSpace == 0u) {
+		return 0.0f;
+	}
+
+	return 1.0f - (float)LargestFreeBlock() / (float)freeSpace;
+}
+
+void ArenaAllocator::InsertFreeBlock(unsigned offset, unsigned size) {
+	if (size == 0u) {
+		return;
+	}
+
+	std::map<unsigned, unsigned>::iterator next = freeBlocks.lower_bound(offset);
+
+	// Merge with the following block
+	if (next != freeBlocks.end() && offset + size == next->first) {
+		size += next->second;
+		next = freeBlocks.erase(next);
+	}
+
+	// Merge with the previous block
+	if (next != freeBlocks.begin()) {
+		std::map<unsigned, unsigned>::iterator previous = std::prev(next);
+		if (previous->first + previous->second == offset) {
+			previous->second += size;
+			return;
+		}
+	}
+
+	freeBlocks[offset] = size;
+}
@@ -0,0 +1,51 @@
+#ifndef __ARENAALLOCATOR_H__
+#define __ARENAALLOCATOR_H__
+
+#include <map>
+#include <vector>
+
+struct ArenaBlock {
+	unsigned offset = 0u;
+	unsigned size = 0u;
+};
+
+struct ArenaMove {
+	unsigned from = 0u;
+	unsigned to = 0u;
+	unsigned size = 0u;
+};
+
+// CPU side free-list allocator, works over byte ranges so it does not need a GL context
+class ArenaAllocator
+{
+	public:
+		ArenaAllocator(unsigned capacity = 0u);
+		~ArenaAllocator();
+
+		bool		Allocate(unsigned size, unsigned alignment, ArenaBlock& block);
+		void		Free(const ArenaBlock& block);
+		void		Grow(unsigned newCapacity);
+		void		Defragment(std::vector<ArenaMove>& moves);
+
+		unsigned	Capacity() const;
+		unsigned	Used() const;
+		unsigned	LargestFreeBlock() const;
+		unsigned	FreeBlocksNumber() const;
+		float		Fragmentation() const;
+
+	private:
+		void		InsertFreeBlock(unsigned offset, unsigned size);
+
+	private:
+		struct UsedBlock {
+			unsigned size = 0u;
+			unsigned alignment = 1u;
+		};
+
+		unsigned						capacity = 0u;
+		unsigned						used = 0u;
+		std::map<unsigned, unsigned>	freeBlocks; // offset -> size
+		std::map<unsigned, UsedBlock>	usedBlocks; // offset -> size & alignment
+};
+
+#endif
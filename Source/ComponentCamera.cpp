@@ -6,6 +6,7 @@
 #include "ModuleCamera.h"
 #include "ModuleRender.h"
 #include "ComponentCamera.h"
+#include "GLStateCache.h"
 
 ComponentCamera::ComponentCamera(GameObject* goParent) : Component(goParent, ComponentType::CAMERA) {
 	InitFrustum();
@@ -16,9 +17,11 @@ ComponentCamera::ComponentCamera(GameObject* goParent) : Component(goParent, Com
 
 ComponentCamera::~ComponentCamera() { 
 
-	glDeleteFramebuffers(1, &fbo);
-	glDeleteRenderbuffers(1, &rbo);
-	glDeleteTextures(1, &renderTexture);
+	if (!App->headless) {
+		App->renderer->glState->DeleteFramebuffer(fbo);
+		glDeleteRenderbuffers(1, &rbo);
+		App->renderer->glState->DeleteTexture(renderTexture);
+	}
 
 	for (std::list<ComponentCamera*>::iterator it = App->camera->gameCameras.begin(); it != App->camera->gameCameras.end(); ++it) {
 		if ((*it) == this) {
@@ -181,14 +184,18 @@ void ComponentCamera::Orbit(float dx, float dy) {
 }
 
 void ComponentCamera::CreateFrameBuffer(float winWidth, float winHeight) {
-	glDeleteFramebuffers(1, &fbo);
+	if (App->headless) {
+		return;
+	}
+
+	App->renderer->glState->DeleteFramebuffer(fbo);
 	glDeleteRenderbuffers(1, &rbo);
 
 	glGenFramebuffers(1, &fbo);
-	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	App->renderer->glState->BindFramebuffer(GL_FRAMEBUFFER, fbo);
 
 	glGenTextures(1, &renderTexture);
-	glBindTexture(GL_TEXTURE_2D, renderTexture);
+	App->renderer->glState->BindTexture(GL_TEXTURE_2D, renderTexture);
 
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, winWidth, winHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
 
@@ -197,8 +204,6 @@ void ComponentCamera::CreateFrameBuffer(float winWidth, float winHeight) {
 
 	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, renderTexture, 0);
 
-	glBindTexture(GL_TEXTURE_2D, 0);
-
 	glGenRenderbuffers(1, &rbo);
 	glBindRenderbuffer(GL_RENDERBUFFER, rbo);
 	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, winWidth, winHeight);
@@ -210,7 +215,7 @@ void ComponentCamera::CreateFrameBuffer(float winWidth, float winHeight) {
 		LOG("Error: Framebuffer issue");
 	}
 
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	App->renderer->glState->BindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 /* RapidJson Storage */
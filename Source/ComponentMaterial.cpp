@@ -3,10 +3,12 @@
 #include "GameObject.h"
 #include "Application.h"
 #include "ModuleProgram.h"
+#include "ModuleRender.h"
 #include "ModuleLibrary.h"
 #include "imgui_internal.h"
 #include "ModuleTextures.h"
 #include "ComponentMaterial.h"
+#include "GLStateCache.h"
 
 ComponentMaterial::ComponentMaterial(GameObject* goContainer) : Component(goContainer, ComponentType::MATERIAL) { }
 
@@ -18,6 +20,12 @@ ComponentMaterial::ComponentMaterial(const ComponentMaterial& duplicatedComponen
 	specularSelected = duplicatedComponent.specularSelected;
 	emissiveSelected = duplicatedComponent.emissiveSelected;
 	material = duplicatedComponent.material;
+
+	// The copy holds its own references, each destructor releases one
+	App->textures->AddReference(material.occlusionMap);
+	App->textures->AddReference(material.diffuseMap);
+	App->textures->AddReference(material.specularMap);
+	App->textures->AddReference(material.emissiveMap);
 }
 
 ComponentMaterial::~ComponentMaterial() { 
@@ -29,9 +37,7 @@ Component* ComponentMaterial::Duplicate() {
 }
 
 void ComponentMaterial::DeleteTexture(unsigned id) {
-	if (id != 0u) {
-		glDeleteTextures(1, &id);
-	}
+	App->textures->Unload(id);
 }
 
 void ComponentMaterial::DrawProperties(bool staticGo) {
@@ -77,6 +83,7 @@ void ComponentMaterial::DrawProperties(bool staticGo) {
 			}
 			if (diffuseSelected != "") {
 				ImGui::Text("Dimensions: %dx%d", material.diffuseWidth, material.diffuseHeight);
+				ImGui::Text("Memory: %.1f KB", (float)App->textures->TextureBytes(material.diffuseMap) / 1024.0f);
 				ImGui::Image((ImTextureID)material.diffuseMap, ImVec2(200, 200));
 				ImGui::SliderFloat("K diffuse", &material.diffuseK, 0.0f, 1.0f);
 			}
@@ -89,6 +96,7 @@ void ComponentMaterial::DrawProperties(bool staticGo) {
 			}
 			if (occlusionSelected != "") {
 				ImGui::Text("Dimensions: %dx%d", material.ambientWidth, material.ambientHeight);
+				ImGui::Text("Memory: %.1f KB", (float)App->textures->TextureBytes(material.occlusionMap) / 1024.0f);
 				ImGui::Image((ImTextureID)material.occlusionMap, ImVec2(200, 200));
 				ImGui::SliderFloat("K ambient", &material.ambientK, 0.0f, 1.0f);
 			}
@@ -102,6 +110,7 @@ void ComponentMaterial::DrawProperties(bool staticGo) {
 			}
 			if (specularSelected != "") {
 				ImGui::Text("Dimensions: %dx%d", material.specularWidth, material.specularHeight);
+				ImGui::Text("Memory: %.1f KB", (float)App->textures->TextureBytes(material.specularMap) / 1024.0f);
 				ImGui::Image((ImTextureID)material.specularMap, ImVec2(200, 200));
 				ImGui::SliderFloat("K specular", &material.specularK, 0.0f, 1.0f);
 				ImGui::SliderFloat("K shininess", &material.shininess, 0.0f, 128.0f);
@@ -116,6 +125,7 @@ void ComponentMaterial::DrawProperties(bool staticGo) {
 			}
 			if (emissiveSelected != "") {
 				ImGui::Text("Dimensions: %dx%d", material.emissiveWidth, material.emissiveHeight);
+				ImGui::Text("Memory: %.1f KB", (float)App->textures->TextureBytes(material.emissiveMap) / 1024.0f);
 				ImGui::Image((ImTextureID)material.emissiveMap, ImVec2(200, 200));
 			}
 		}
@@ -1,6 +1,5 @@
 #include "assert.h"
 #include "Config.h"
-#include "par_shapes.h"
 #include "GameObject.h"
 #include "Application.h"
 #include "ModuleScene.h"
@@ -10,15 +9,19 @@
 #include "ModuleLibrary.h"
 #include "imgui_internal.h"
 #include "ComponentMaterial.h"
+#include "ResourceMesh.h"
 #include "Math/float3.h"
 #include "Math/float2.h"
+#include "Geometry/Frustum.h"
 
 ComponentMesh::ComponentMesh(GameObject* goContainer) : Component(goContainer, ComponentType::MESH) { }
 
 ComponentMesh::ComponentMesh(const ComponentMesh& duplicatedComponent) : Component(duplicatedComponent) {
-	mesh = duplicatedComponent.mesh;
+	// The copy shares the resource, its buffers stay alive until both are gone
+	resource = duplicatedComponent.resource;
 	currentMesh = duplicatedComponent.currentMesh;
-	if (mesh.indicesNumber > 0) {
+	if (resource != nullptr) {
+		++resource->references;
 		App->renderer->meshes.push_back(this);
 	}
 }
@@ -34,74 +37,33 @@ Component* ComponentMesh::Duplicate() {
 void ComponentMesh::CleanUp() {
 
 	App->renderer->meshes.remove(this);
-
-	if (mesh.vbo != 0) {
-		glDeleteBuffers(1, &mesh.vbo);
-	}
-
-	if (mesh.ibo != 0) {
-		glDeleteBuffers(1, &mesh.ibo);
-	}
-	
-	MeshImporter::CleanUpStructMesh(&mesh);
+	App->library->ReleaseMesh(resource);
+	resource = nullptr;
+	activeLod = 0u;
 }
 
-void ComponentMesh::Draw(unsigned shaderProgram, const ComponentMaterial* material) const {
-
-	if (material == nullptr) {
-		return;
-	}
-
-	glActiveTexture(GL_TEXTURE0);
-
-	glUniform4f(glGetUniformLocation(shaderProgram, "diffuseColor"), material->material.diffuseColor.x, material->material.diffuseColor.y, material->material.diffuseColor.z, 1.0f);
-	glUniform4f(glGetUniformLocation(shaderProgram, "emissiveColor"), material->material.emissiveColor.x, material->material.emissiveColor.y, material->material.emissiveColor.z, 1.0f);
-	glUniform4f(glGetUniformLocation(shaderProgram, "specularColor"), material->material.specularColor.x, material->material.specularColor.y, material->material.specularColor.z, 1.0f);
-	glUniform3fv(glGetUniformLocation(shaderProgram, "light_pos"), 1, (float*)&App->scene->lightPosition);
-	glUniform1f(glGetUniformLocation(shaderProgram, "ambient"), App->scene->ambientLight);
-	glUniform1f(glGetUniformLocation(shaderProgram, "shininess"), material->material.shininess);
-	glUniform1f(glGetUniformLocation(shaderProgram, "k_ambient"), material->material.ambientK);
-	glUniform1f(glGetUniformLocation(shaderProgram, "k_diffuse"), material->material.diffuseK);
-	glUniform1f(glGetUniformLocation(shaderProgram, "k_specular"), material->material.specularK);
-	glUniform4fv(glGetUniformLocation(shaderProgram, "newColor"), 1, (float*)&material->material.color);
-
-	glActiveTexture(GL_TEXTURE0);
-	if (material->enabled && material->material.diffuseMap != 0) {
-		glBindTexture(GL_TEXTURE_2D, material->material.diffuseMap);
-	} else {
-		glBindTexture(GL_TEXTURE_2D, App->renderer->fallback);
-	}
-	glUniform1i(glGetUniformLocation(shaderProgram, "diffuseMap"), 0);
-
-	glActiveTexture(GL_TEXTURE1);
-	if (material->enabled && material->material.emissiveMap != 0) {
-		glBindTexture(GL_TEXTURE_2D, material->material.emissiveMap);
-	} else {
-		glBindTexture(GL_TEXTURE_2D, App->renderer->fallback);
-	}
-	glUniform1i(glGetUniformLocation(shaderProgram, "emissiveMap"), 1);
+const Mesh* ComponentMesh::GetMesh() const {
+	return resource != nullptr && resource->IsResident() ? &resource->mesh : nullptr;
+}
 
-	glActiveTexture(GL_TEXTURE2);
-	if (material->enabled && material->material.occlusionMap != 0) {
-		glBindTexture(GL_TEXTURE_2D, material->material.occlusionMap);
-	} else {
-		glBindTexture(GL_TEXTURE_2D, App->renderer->fallback);
+math::AABB ComponentMesh::GetBoundingBox() const {
+	const Mesh* mesh = GetMesh();
+	if (mesh != nullptr) {
+		return mesh->bbox;
 	}
-	glUniform1i(glGetUniformLocation(shaderProgram, "occlusionMap"), 2);
 
-	glActiveTexture(GL_TEXTURE3);
-	if (material->enabled && material->material.specularMap != 0) {
-		glBindTexture(GL_TEXTURE_2D, material->material.specularMap);
-	} else {
-		glBindTexture(GL_TEXTURE_2D, App->renderer->fallback);
-	}
-	glUniform1i(glGetUniformLocation(shaderProgram, "specularMap"), 3);
+	// Culled with a placeholder until the mesh is resident, the library recomputes the box then
+	return math::AABB(math::float3::FromScalar(-MESH_PLACEHOLDER_EXTENT), math::float3::FromScalar(MESH_PLACEHOLDER_EXTENT));
+}
 
-	glBindVertexArray(mesh.vao);
-	glDrawElements(GL_TRIANGLES, mesh.indicesNumber, GL_UNSIGNED_INT, 0);
+math::Sphere ComponentMesh::GetBoundingSphere() const {
+	const Mesh* mesh = GetMesh();
+	return (mesh != nullptr) ? mesh->bsphere : math::Sphere(math::float3::zero, GetBoundingBox().HalfDiagonal().Length());
+}
 
-	glBindVertexArray(0);
-	glBindTexture(GL_TEXTURE_2D, 0);
+math::OBB ComponentMesh::GetBoundingObb() const {
+	const Mesh* mesh = GetMesh();
+	return (mesh != nullptr) ? mesh->obb : math::OBB(GetBoundingBox());
 }
 
 void ComponentMesh::DrawProperties(bool staticGo) {
@@ -137,15 +99,28 @@ void ComponentMesh::DrawProperties(bool staticGo) {
 			ImGui::EndCombo();
 		} ImGui::SameLine();
 		if (ImGui::Button("Empty")) {
-			App->renderer->meshes.remove(this);
-			MeshImporter::CleanUpStructMesh(&mesh);
+			CleanUp();
 			currentMesh = "";
 		}
 
 		ImGui::Separator();
 
-		ImGui::Text("Triangles count: %d", mesh.verticesNumber / 3);
-		ImGui::Text("Vertices count: %d", mesh.verticesNumber);
+		if (resource != nullptr && !resource->IsResident()) {
+			ImGui::Text(resource->state == ResourceState::FAILED ? "Mesh failed to load" : "Streaming...");
+		} else if (resource != nullptr) {
+			const Mesh& mesh = resource->mesh;
+			ImGui::Text("Shared by %u components", resource->references);
+			ImGui::Text("Triangles count: %d", mesh.GetLod(0u).indicesNumber / 3);
+			ImGui::Text("Vertices count: %d", mesh.verticesNumber);
+			ImGui::Text("Index size: %u bits, %u submeshes", mesh.indexSize * 8u, mesh.SubmeshesNumber());
+
+			if (mesh.lodsNumber > 1u) {
+				ImGui::Text("Active LOD: %u (%.3f of the screen)", activeLod, projectedSize);
+				for (unsigned i = 0u; i < mesh.lodsNumber; ++i) {
+					ImGui::BulletText("LOD %u: %u triangles", i, mesh.lods[i].indicesNumber / 3u);
+				}
+			}
+		}
 
 		if (staticGo) {
 			ImGui::PopItemFlag();
@@ -158,164 +133,55 @@ void ComponentMesh::DrawProperties(bool staticGo) {
 }
 
 void ComponentMesh::LoadMesh(const char* name) {
-	App->renderer->meshes.remove(this); 
-
-	if (mesh.vbo != 0) {
-		glDeleteBuffers(1, &mesh.vbo);
-	}
+	// Acquired before releasing the current one, selecting the same mesh again does not reload it.
+	// New meshes stream in, the object is culled with a placeholder box until they are resident.
+	ResourceMesh* loaded = App->library->AcquireMesh(name);
+	CleanUp();
 
-	if (mesh.ibo != 0) {
-		glDeleteBuffers(1, &mesh.ibo);
+	resource = loaded;
+	if (resource != nullptr) {
+		goContainer->ComputeBBox();
+		App->renderer->meshes.push_back(this);
 	}
-
-	MeshImporter::CleanUpStructMesh(&mesh);
-	MeshImporter::Load(&mesh, name);
-
-	ComputeMesh();
-	goContainer->ComputeBBox();
-	App->renderer->meshes.push_back(this);
 }
 
-void ComponentMesh::ComputeMesh() { 
-	glGenBuffers(1, &mesh.vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
-
-	unsigned offset = sizeof(math::float3);
-
-	if (mesh.normals != nullptr) {
-		mesh.normalsOffset = offset;
-		offset += sizeof(math::float3);
-	}
-
-	if (mesh.uvs != nullptr) {
-		mesh.texturesOffset = offset;
-		offset += sizeof(math::float2);
-	}
-
-	mesh.vertexSize = offset;
-
-	glBufferData(GL_ARRAY_BUFFER, mesh.vertexSize * mesh.verticesNumber, nullptr, GL_STATIC_DRAW);
-	glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(float) * 3 * mesh.verticesNumber, mesh.vertices);
-
-	if (mesh.normals != nullptr) {
-		glBufferSubData(GL_ARRAY_BUFFER, mesh.normalsOffset * mesh.verticesNumber, sizeof(float) * 3 * mesh.verticesNumber, mesh.normals);
-	}
-
-	if (mesh.uvs != nullptr) {
-		glBufferSubData(GL_ARRAY_BUFFER, mesh.texturesOffset * mesh.verticesNumber, sizeof(float2)*mesh.verticesNumber, mesh.uvs);
-	}
-
-	glUnmapBuffer(GL_ARRAY_BUFFER);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-	glGenBuffers(1, &mesh.ibo);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ibo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indicesNumber * sizeof(unsigned), mesh.indices, GL_STATIC_DRAW);
-
-	glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-
-	glGenVertexArrays(1, &mesh.vao);
-
-	glBindVertexArray(mesh.vao);
-	glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ibo);
-
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
-
-	if (mesh.normalsOffset != 0) {
-		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, (void*)(mesh.normalsOffset * mesh.verticesNumber));
-	}
+void ComponentMesh::LoadPrimitive(GeometryType type, unsigned slices, unsigned stacks, float scale) {
+	// Every primitive with the same key draws from the same buffers, consecutive ones become instances
+	ResourceMesh* generated = App->library->AcquirePrimitive(type, slices, stacks, scale);
+	CleanUp();
 
-	if (mesh.texturesOffset != 0) {
-		glEnableVertexAttribArray(2);
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, (void*)(mesh.texturesOffset * mesh.verticesNumber));
+	resource = generated;
+	if (resource != nullptr) {
+		App->renderer->meshes.push_back(this);
 	}
-
-	glBindVertexArray(0);
-
-	mesh.bbox.SetNegativeInfinity();
-	mesh.bbox.Enclose((float3*)mesh.vertices, mesh.verticesNumber);
-
-	glDisableVertexAttribArray(0);
-	glDisableVertexAttribArray(1);
-	glDisableVertexAttribArray(2);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
-void ComponentMesh::ComputeMesh(par_shapes_mesh_s* parMesh) {
-	assert(parMesh != nullptr);
-
-	glGenBuffers(1, &mesh.vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
-
-	unsigned offset = sizeof(math::float3);
-
-	if (parMesh->normals) {
-		mesh.normalsOffset = offset;
-		offset += sizeof(math::float3);
+void ComponentMesh::UpdateLod(const math::Frustum& frustum, const float* thresholds, float hysteresis, bool enabled) {
+	unsigned lodsNumber = GetMesh() != nullptr ? GetMesh()->LodsNumber() : 1u;
+	if (!enabled || lodsNumber == 1u) {
+		activeLod = 0u;
+		return;
 	}
 
-	mesh.vertexSize = offset;
-
-	glBufferData(GL_ARRAY_BUFFER, mesh.vertexSize * parMesh->npoints, nullptr, GL_STATIC_DRAW);
-	glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(math::float3) * parMesh->npoints, parMesh->points);
-
-	if (parMesh->normals) {
-		glBufferSubData(GL_ARRAY_BUFFER, mesh.normalsOffset * parMesh->npoints, sizeof(math::float3) * parMesh->npoints, parMesh->normals);
+	// Fraction of the screen height covered by the bounding sphere of the box
+	const math::AABB& bbox = goContainer->bbox;
+	float radius = bbox.HalfDiagonal().Length();
+	if (frustum.type == math::OrthographicFrustum) {
+		projectedSize = 2.0f * radius / frustum.orthographicHeight;
 	}
-
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-	glGenBuffers(1, &mesh.ibo);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ibo);
-
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned) * parMesh->ntriangles * 3, nullptr, GL_STATIC_DRAW);
-
-	unsigned* indices = (unsigned*)glMapBufferRange(GL_ELEMENT_ARRAY_BUFFER, 0, sizeof(unsigned) * parMesh->ntriangles * 3, GL_MAP_WRITE_BIT);
-
-	for (unsigned i = 0; i< unsigned(parMesh->ntriangles * 3); ++i) {
-		*(indices++) = parMesh->triangles[i];
+	else {
+		float distance = MAX(bbox.CenterPoint().Distance(frustum.pos), frustum.nearPlaneDistance);
+		projectedSize = radius / (distance * tanf(frustum.verticalFov * 0.5f));
 	}
 
-	glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-
-	mesh.verticesNumber = parMesh->npoints;
-	mesh.indicesNumber = parMesh->ntriangles * 3;
-
-	glGenVertexArrays(1, &mesh.vao);
-
-	glBindVertexArray(mesh.vao);
-	glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ibo);
-
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
-
-	if (mesh.normalsOffset != 0) {
-		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, (void*)(mesh.normalsOffset * mesh.verticesNumber));
+	// The band around every threshold keeps meshes sitting on it from switching every frame
+	activeLod = MIN(activeLod, lodsNumber - 1u);
+	while (activeLod + 1u < lodsNumber && projectedSize < thresholds[activeLod] * (1.0f - hysteresis)) {
+		++activeLod;
 	}
-
-	if (mesh.texturesOffset != 0) {
-		glEnableVertexAttribArray(2);
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, (void*)(mesh.texturesOffset * mesh.verticesNumber));
+	while (activeLod > 0u && projectedSize > thresholds[activeLod - 1u] * (1.0f + hysteresis)) {
+		--activeLod;
 	}
-
-	glBindVertexArray(0);
-
-	mesh.bbox.SetNegativeInfinity();
-	mesh.bbox.Enclose((float3*)parMesh->points, parMesh->npoints);
-
-	glDisableVertexAttribArray(0);
-	glDisableVertexAttribArray(1);
-	glDisableVertexAttribArray(2);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
 /* RapidJson storage */
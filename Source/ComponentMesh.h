@@ -5,11 +5,14 @@
 #include <assimp/mesh.h>
 #include "Component.h"
 #include "Math/float3.h"
+#include "Geometry/AABB.h"
 #include "ModuleTextures.h"
 
-struct par_shapes_mesh_s;
+namespace math { class Frustum; }
 class ComponentMaterial;
 class GameObject;
+class ResourceMesh;
+enum class GeometryType;
 
 class ComponentMesh : public Component
 {
@@ -20,20 +23,29 @@ class ComponentMesh : public Component
 
 		void CleanUp();
 
-		void		ComputeMesh();
-		void		ComputeMesh(par_shapes_mesh_s* parMesh);
-		void		Draw(unsigned shaderProgram, const ComponentMaterial* material) const;
 		void		DrawProperties(bool enabled) override;
 		void		LoadMesh(const char* name);
+		void		LoadPrimitive(GeometryType type, unsigned slices, unsigned stacks, float scale);
 		Component*	Duplicate() override;
 
+		// thresholds are screen height fractions, one per level after the first
+		void		UpdateLod(const math::Frustum& frustum, const float* thresholds, float hysteresis, bool enabled);
+
+		// Shared with every component showing the same mesh, nullptr while empty or still streaming
+		const Mesh*	GetMesh() const;
+		math::AABB	GetBoundingBox() const;
+		math::Sphere GetBoundingSphere() const;
+		math::OBB	GetBoundingObb() const;
+
 	private:
 		void		Save(Config* config) override;
 		void		Load(Config* config, rapidjson::Value& value) override;
 
 	public:
-		Mesh					 mesh;
+		ResourceMesh*			 resource = nullptr;
 		std::vector<std::string> fileMeshesList;
+		unsigned				 activeLod = 0u;
+		float					 projectedSize = 0.0f;
 
 	private:
 		std::string currentMesh;
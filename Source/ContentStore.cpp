@@ -0,0 +1,67 @@
+#include "Globals.h"
+#include "ContentStore.h"
+#include "Application.h"
+#include "ModuleFileSystem.h"
+#include <mutex>
+
+// Import jobs of different sources may cook the same content at the same time
+static std::mutex storeMutex;
+
+unsigned long long ContentStore::Hash(const void* data, unsigned size) {
+	unsigned long long hash = 14695981039346656037ull;
+	const unsigned char* cursor = (const unsigned char*)data;
+
+	for (unsigned i = 0u; i < size; ++i) {
+		hash ^= cursor[i];
+		hash *= 1099511628211ull;
+	}
+
+	return hash;
+}
+
+std::string ContentStore::GetPath(unsigned long long hash, const char* extension) {
+	char name[32];
+	sprintf_s(name, 32, "%016llx", hash);
+
+	std::string path(CONTENT_STORE_PATH);
+	path.append(name);
+	path.append(extension);
+
+	return path;
+}
+
+bool ContentStore::Store(const char* referencePath, const void* data, unsigned size, const char* extension, unsigned long long* hash) {
+	ContentReference reference;
+	reference.hash = Hash(data, size);
+
+	if (hash != nullptr) {
+		*hash = reference.hash;
+	}
+
+	std::string contentPath = GetPath(reference.hash, extension);
+	{
+		std::lock_guard<std::mutex> lock(storeMutex);
+		if (!App->fileSystem->Exists(contentPath.c_str()) && App->fileSystem->Save(contentPath.c_str(), data, size, false) != size) {
+			LOG("Error: Cooked content %s cannot be saved", contentPath.c_str());
+			return false;
+		}
+	}
+
+	return App->fileSystem->Save(referencePath, &reference, sizeof(ContentReference), false) == sizeof(ContentReference);
+}
+
+bool ContentStore::ReadReference(const char* buffer, unsigned size, unsigned long long& hash) {
+	if (buffer == nullptr || size != sizeof(ContentReference)) {
+		return false;
+	}
+
+	ContentReference reference;
+	memcpy(&reference, buffer, sizeof(ContentReference));
+	if (reference.magic != CONTENT_REFERENCE_MAGIC || reference.version != CONTENT_REFERENCE_VERSION) {
+		return false;
+	}
+
+	hash = reference.hash;
+
+	return true;
+}
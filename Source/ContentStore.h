@@ -0,0 +1,29 @@
+#ifndef __CONTENTSTORE_H__
+#define __CONTENTSTORE_H__
+
+#include <string>
+
+#define CONTENT_STORE_PATH "/Library/Content/"
+#define CONTENT_REFERENCE_MAGIC 0x46455243u // "CREF"
+#define CONTENT_REFERENCE_VERSION 1u
+
+// Written under the name of the source sub-asset in place of its cooked data
+struct ContentReference {
+	unsigned			magic = CONTENT_REFERENCE_MAGIC;
+	unsigned			version = CONTENT_REFERENCE_VERSION;
+	unsigned long long	hash = 0u; // FNV-1a of the whole cooked file
+};
+
+// Cooked files stored once by content hash, identical sub-assets of different sources end up in a single file
+class ContentStore
+{
+	public:
+		static unsigned long long	Hash(const void* data, unsigned size);
+		static std::string			GetPath(unsigned long long hash, const char* extension);
+
+		// Stores the data unless its hash is already there, then points referencePath to it
+		static bool					Store(const char* referencePath, const void* data, unsigned size, const char* extension, unsigned long long* hash = nullptr);
+		static bool					ReadReference(const char* buffer, unsigned size, unsigned long long& hash);
+};
+
+#endif
@@ -0,0 +1,414 @@
+#include "DdsFile.h"
+#include "Globals.h"
+#include <stdio.h>
+#include <string.h>
+
+unsigned DdsFile::Write(unsigned fourCC, const std::vector<DdsLevel>& levels, bool bottomUp, char** buffer) {
+	if (levels.empty()) {
+		*buffer = nullptr;
+		return 0u;
+	}
+
+	DdsHeader header;
+	header.flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_LINEARSIZE;
+	header.width = levels[0].width;
+	header.height = levels[0].height;
+	header.pitchOrLinearSize = levels[0].blocks.size();
+	header.pixelFormat.flags = DDPF_FOURCC;
+	header.pixelFormat.fourCC = fourCC;
+	header.caps = DDSCAPS_TEXTURE;
+	if (levels.size() > 1u) {
+		header.flags |= DDSD_MIPMAPCOUNT;
+		header.mipMapCount = levels.size();
+		header.caps |= DDSCAPS_COMPLEX | DDSCAPS_MIPMAP;
+	}
+	if (bottomUp) {
+		header.reserved1[9] = DDS_BOTTOM_UP;
+	}
+
+	unsigned size = sizeof(unsigned) + sizeof(DdsHeader);
+	for (std::vector<DdsLevel>::const_iterator it = levels.begin(); it != levels.end(); ++it) {
+		size += it->blocks.size();
+	}
+
+	*buffer = new char[size];
+	char* cursor = *buffer;
+	unsigned magic = DDS_MAGIC;
+	memcpy(cursor, &magic, sizeof(unsigned));
+	cursor += sizeof(unsigned);
+	memcpy(cursor, &header, sizeof(DdsHeader));
+	cursor += sizeof(DdsHeader);
+	for (std::vector<DdsLevel>::const_iterator it = levels.begin(); it != levels.end(); ++it) {
+		memcpy(cursor, &it->blocks[0], it->blocks.size());
+		cursor += it->blocks.size();
+	}
+
+	return size;
+}
+
+bool DdsFile::ReadHeader(const char* buffer, unsigned size, DdsHeader& header) {
+	if (buffer == nullptr || size < sizeof(unsigned) + sizeof(DdsHeader)) {
+		return false;
+	}
+
+	unsigned magic = 0u;
+	memcpy(&magic, buffer, sizeof(unsigned));
+	memcpy(&header, buffer + sizeof(unsigned), sizeof(DdsHeader));
+
+	return magic == DDS_MAGIC && header.size == sizeof(DdsHeader) && header.pixelFormat.size == sizeof(DdsPixelFormat);
+}
+
+bool DdsFile::Read(const char* buffer, unsigned size, DdsTexture& texture) {
+	DdsHeader header;
+	if (!ReadHeader(buffer, size, header)) {
+		return false;
+	}
+
+	// Uncompressed and DX10 files are left to the conversion fallback
+	if ((header.pixelFormat.flags & DDPF_FOURCC) == 0u || BlockBytes(header.pixelFormat.fourCC) == 0u) {
+		return false;
+	}
+
+	if (header.width == 0u || header.height == 0u) {
+		return false;
+	}
+
+	// Writers disagree on the flags, a count of 0 means a single level anyway
+	unsigned levelsNumber = MAX(header.mipMapCount, 1u);
+	unsigned fullChain = 1u;
+	for (unsigned side = MAX(header.width, header.height); side > 1u; side /= 2u) {
+		++fullChain;
+	}
+	levelsNumber = MIN(levelsNumber, fullChain);
+
+	texture.fourCC = header.pixelFormat.fourCC;
+	texture.bottomUp = header.reserved1[9] == DDS_BOTTOM_UP;
+	texture.levels.resize(levelsNumber);
+
+	unsigned offset = sizeof(unsigned) + sizeof(DdsHeader);
+	unsigned width = header.width;
+	unsigned height = header.height;
+	for (unsigned i = 0u; i < levelsNumber; ++i) {
+		unsigned bytes = LevelBytes(texture.fourCC, width, height);
+		if (bytes > size - offset) {
+			texture.levels.clear();
+			return false;
+		}
+
+		DdsLevel& level = texture.levels[i];
+		level.width = width;
+		level.height = height;
+		level.blocks.assign(buffer + offset, buffer + offset + bytes);
+
+		offset += bytes;
+		width = MAX(width / 2u, 1u);
+		height = MAX(height / 2u, 1u);
+	}
+
+	return true;
+}
+
+bool DdsFile::Flip(DdsTexture& texture) {
+	unsigned blockBytes = BlockBytes(texture.fourCC);
+
+	// Rows only move inside their block and blocks only swap whole rows, a partial last block row would shift everything
+	for (std::vector<DdsLevel>::const_iterator it = texture.levels.begin(); it != texture.levels.end(); ++it) {
+		if (it->height > DDS_BLOCK_SIZE && it->height % DDS_BLOCK_SIZE != 0u) {
+			return false;
+		}
+	}
+
+	std::vector<unsigned char> row;
+	for (std::vector<DdsLevel>::iterator it = texture.levels.begin(); it != texture.levels.end(); ++it) {
+		unsigned rowBytes = (it->width + DDS_BLOCK_SIZE - 1u) / DDS_BLOCK_SIZE * blockBytes;
+		unsigned blockRows = (it->height + DDS_BLOCK_SIZE - 1u) / DDS_BLOCK_SIZE;
+		unsigned rowsNumber = MIN(it->height, DDS_BLOCK_SIZE);
+
+		for (unsigned offset = 0u; offset < it->blocks.size(); offset += blockBytes) {
+			FlipBlock(texture.fourCC, &it->blocks[offset], rowsNumber);
+		}
+
+		row.resize(rowBytes);
+		for (unsigned top = 0u, bottom = blockRows - 1u; top < bottom; ++top, --bottom) {
+			memcpy(&row[0], &it->blocks[top * rowBytes], rowBytes);
+			memcpy(&it->blocks[top * rowBytes], &it->blocks[bottom * rowBytes], rowBytes);
+			memcpy(&it->blocks[bottom * rowBytes], &row[0], rowBytes);
+		}
+	}
+
+	texture.bottomUp = !texture.bottomUp;
+
+	return true;
+}
+
+static bool Fail(std::string* error, const char* reason) {
+	if (error != nullptr) {
+		*error = reason;
+	}
+
+	return false;
+}
+
+bool DdsFile::Validate(const char* buffer, unsigned size, std::string* error) {
+	DdsTexture texture;
+	if (!Read(buffer, size, texture)) {
+		return Fail(error, "not a complete DXT1, DXT3 or DXT5 file");
+	}
+
+	char* written = nullptr;
+	unsigned writtenSize = Write(texture.fourCC, texture.levels, texture.bottomUp, &written);
+	DdsTexture reread;
+	bool same = Read(written, writtenSize, reread) && reread.fourCC == texture.fourCC && reread.bottomUp == texture.bottomUp && reread.levels.size() == texture.levels.size();
+	for (unsigned i = 0u; same && i < texture.levels.size(); ++i) {
+		same = reread.levels[i].width == texture.levels[i].width && reread.levels[i].height == texture.levels[i].height && reread.levels[i].blocks == texture.levels[i].blocks;
+	}
+	delete[] written;
+	if (!same) {
+		return Fail(error, "writing it back does not read the same levels");
+	}
+
+	// Odd sized levels cannot be flipped, such files are fine as long as they are cooked bottom up
+	DdsTexture flipped = texture;
+	if (!Flip(flipped)) {
+		return texture.bottomUp ? true : Fail(error, "stored top down with levels that cannot be flipped");
+	}
+
+	std::vector<unsigned char> pixels;
+	std::vector<unsigned char> flippedPixels;
+	for (unsigned i = 0u; i < texture.levels.size(); ++i) {
+		const DdsLevel& level = texture.levels[i];
+		DecodeLevel(texture.fourCC, level, pixels);
+		DecodeLevel(texture.fourCC, flipped.levels[i], flippedPixels);
+
+		unsigned pitch = (level.width + DDS_BLOCK_SIZE - 1u) / DDS_BLOCK_SIZE * DDS_BLOCK_SIZE * 4u;
+		for (unsigned y = 0u; y < level.height; ++y) {
+			if (memcmp(&pixels[y * pitch], &flippedPixels[(level.height - 1u - y) * pitch], level.width * 4u) != 0) {
+				return Fail(error, "flipped rows do not mirror the original ones");
+			}
+		}
+	}
+
+	if (!Flip(flipped) || flipped.bottomUp != texture.bottomUp) {
+		return Fail(error, "cannot be flipped back");
+	}
+	for (unsigned i = 0u; i < texture.levels.size(); ++i) {
+		if (flipped.levels[i].blocks != texture.levels[i].blocks) {
+			return Fail(error, "flipping twice does not give the original blocks");
+		}
+	}
+
+	return true;
+}
+
+// One block of each read format, every row picks another color so flipped rows never match by chance
+struct DdsSample {
+	unsigned		fourCC;
+	unsigned char	block[16];
+};
+
+static const DdsSample ddsSamples[] = {
+	{ DDS_FOURCC('D', 'X', 'T', '1'), { 0x00, 0xF8, 0x1F, 0x00, 0x00, 0x55, 0xAA, 0xFF } },
+	{ DDS_FOURCC('D', 'X', 'T', '3'), { 0x00, 0x00, 0x55, 0x55, 0xAA, 0xAA, 0xFF, 0xFF, 0xE0, 0x07, 0x1F, 0x00, 0xE4, 0xE4, 0x1B, 0x1B } },
+	{ DDS_FOURCC('D', 'X', 'T', '5'), { 0xFF, 0x10, 0x00, 0x00, 0x00, 0x49, 0x92, 0x24, 0x00, 0xF8, 0xE0, 0x07, 0xFF, 0xAA, 0x55, 0x00 } }
+};
+
+// Odd, thin and multiple of four sizes, the odd ones cannot be flipped and are written bottom up like the cooker does
+static const unsigned ddsSampleSizes[][2] = { { 1u, 1u }, { 3u, 2u }, { 8u, 3u }, { 12u, 8u }, { 64u, 64u }, { 20u, 36u } };
+
+bool DdsFile::ValidateFormats(std::string* error) {
+	for (unsigned f = 0u; f < sizeof(ddsSamples) / sizeof(ddsSamples[0]); ++f) {
+		const DdsSample& sample = ddsSamples[f];
+		unsigned blockBytes = BlockBytes(sample.fourCC);
+
+		for (unsigned s = 0u; s < sizeof(ddsSampleSizes) / sizeof(ddsSampleSizes[0]); ++s) {
+			std::vector<DdsLevel> levels;
+			unsigned width = ddsSampleSizes[s][0];
+			unsigned height = ddsSampleSizes[s][1];
+			while (true) {
+				levels.push_back(DdsLevel());
+				DdsLevel& level = levels.back();
+				level.width = width;
+				level.height = height;
+				level.blocks.resize(LevelBytes(sample.fourCC, width, height));
+
+				// The first byte numbers the block, so blocks moved to the wrong place are found too
+				for (unsigned i = 0u; i < level.blocks.size(); i += blockBytes) {
+					memcpy(&level.blocks[i], sample.block, blockBytes);
+					level.blocks[i] ^= (unsigned char)(i / blockBytes + levels.size());
+				}
+
+				if (width == 1u && height == 1u) {
+					break;
+				}
+				width = MAX(width / 2u, 1u);
+				height = MAX(height / 2u, 1u);
+			}
+
+			char* buffer = nullptr;
+			unsigned size = Write(sample.fourCC, levels, true, &buffer);
+			bool valid = Validate(buffer, size, error);
+			DdsTexture truncated;
+			if (valid && Read(buffer, size - 1u, truncated)) {
+				valid = Fail(error, "a truncated file is read");
+			}
+			delete[] buffer;
+
+			if (!valid) {
+				if (error != nullptr) {
+					char name[64];
+					sprintf_s(name, 64, "%.4s %ux%u: ", (const char*)&sample.fourCC, ddsSampleSizes[s][0], ddsSampleSizes[s][1]);
+					error->insert(0u, name);
+				}
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+void DdsFile::DecodeLevel(unsigned fourCC, const DdsLevel& level, std::vector<unsigned char>& pixels) {
+	unsigned blockBytes = BlockBytes(fourCC);
+	unsigned blocksWide = MAX((level.width + DDS_BLOCK_SIZE - 1u) / DDS_BLOCK_SIZE, 1u);
+	unsigned blocksHigh = MAX((level.height + DDS_BLOCK_SIZE - 1u) / DDS_BLOCK_SIZE, 1u);
+	unsigned pitch = blocksWide * DDS_BLOCK_SIZE * 4u;
+	pixels.assign(pitch * blocksHigh * DDS_BLOCK_SIZE, 0u);
+
+	for (unsigned by = 0u; by < blocksHigh; ++by) {
+		for (unsigned bx = 0u; bx < blocksWide; ++bx) {
+			const unsigned char* block = &level.blocks[(by * blocksWide + bx) * blockBytes];
+			unsigned char* target = &pixels[by * DDS_BLOCK_SIZE * pitch + bx * DDS_BLOCK_SIZE * 4u];
+
+			if (fourCC == DDS_FOURCC('D', 'X', 'T', '1')) {
+				DecodeColorBlock(block, false, target, pitch);
+				continue;
+			}
+
+			DecodeColorBlock(block + 8u, true, target, pitch);
+
+			unsigned char alphas[16];
+			if (fourCC == DDS_FOURCC('D', 'X', 'T', '3')) {
+				for (unsigned i = 0u; i < 16u; ++i) {
+					alphas[i] = ((block[i / 2u] >> ((i % 2u) * 4u)) & 0xfu) * 17u;
+				}
+			} else {
+				unsigned palette[8] = { block[0], block[1] };
+				if (palette[0] > palette[1]) {
+					for (unsigned i = 1u; i < 7u; ++i) {
+						palette[i + 1u] = ((7u - i) * palette[0] + i * palette[1]) / 7u;
+					}
+				} else {
+					for (unsigned i = 1u; i < 5u; ++i) {
+						palette[i + 1u] = ((5u - i) * palette[0] + i * palette[1]) / 5u;
+					}
+					palette[6] = 0u;
+					palette[7] = 255u;
+				}
+
+				unsigned long long indices = 0u;
+				for (unsigned i = 0u; i < 6u; ++i) {
+					indices |= (unsigned long long)block[2u + i] << (8u * i);
+				}
+				for (unsigned i = 0u; i < 16u; ++i) {
+					alphas[i] = (unsigned char)palette[(indices >> (3u * i)) & 7u];
+				}
+			}
+
+			for (unsigned i = 0u; i < 16u; ++i) {
+				target[(i / DDS_BLOCK_SIZE) * pitch + (i % DDS_BLOCK_SIZE) * 4u + 3u] = alphas[i];
+			}
+		}
+	}
+}
+
+void DdsFile::DecodeColorBlock(const unsigned char* block, bool opaque, unsigned char* pixels, unsigned pitch) {
+	unsigned endpoints[2] = { block[0] | (block[1] << 8u), block[2] | (block[3] << 8u) };
+
+	unsigned char palette[4][4];
+	for (unsigned i = 0u; i < 2u; ++i) {
+		palette[i][0] = (unsigned char)(((endpoints[i] >> 11u) & 0x1fu) * 255u / 31u);
+		palette[i][1] = (unsigned char)(((endpoints[i] >> 5u) & 0x3fu) * 255u / 63u);
+		palette[i][2] = (unsigned char)((endpoints[i] & 0x1fu) * 255u / 31u);
+		palette[i][3] = 255u;
+	}
+
+	// DXT1 switches to three colors and transparent black when the endpoints are in this order
+	bool fourColors = opaque || endpoints[0] > endpoints[1];
+	for (unsigned c = 0u; c < 3u; ++c) {
+		if (fourColors) {
+			palette[2][c] = (unsigned char)((2u * palette[0][c] + palette[1][c]) / 3u);
+			palette[3][c] = (unsigned char)((palette[0][c] + 2u * palette[1][c]) / 3u);
+		} else {
+			palette[2][c] = (unsigned char)((palette[0][c] + palette[1][c]) / 2u);
+			palette[3][c] = 0u;
+		}
+	}
+	palette[2][3] = 255u;
+	palette[3][3] = fourColors ? 255u : 0u;
+
+	for (unsigned y = 0u; y < DDS_BLOCK_SIZE; ++y) {
+		for (unsigned x = 0u; x < DDS_BLOCK_SIZE; ++x) {
+			memcpy(pixels + y * pitch + x * 4u, palette[(block[4u + y] >> (2u * x)) & 3u], 4u);
+		}
+	}
+}
+
+unsigned DdsFile::BlockBytes(unsigned fourCC) {
+	switch (fourCC) {
+		case DDS_FOURCC('D', 'X', 'T', '1'):
+			return 8u;
+		case DDS_FOURCC('D', 'X', 'T', '3'):
+		case DDS_FOURCC('D', 'X', 'T', '5'):
+			return 16u;
+		default:
+			return 0u;
+	}
+}
+
+unsigned DdsFile::LevelBytes(unsigned fourCC, unsigned width, unsigned height) {
+	unsigned blocksWide = MAX((width + DDS_BLOCK_SIZE - 1u) / DDS_BLOCK_SIZE, 1u);
+	unsigned blocksHigh = MAX((height + DDS_BLOCK_SIZE - 1u) / DDS_BLOCK_SIZE, 1u);
+
+	return blocksWide * blocksHigh * BlockBytes(fourCC);
+}
+
+void DdsFile::FlipBlock(unsigned fourCC, unsigned char* block, unsigned rowsNumber) {
+	unsigned char* color = block;
+
+	// Alpha of DXT3 is 16 bits per row, of DXT5 a 3 bit index per pixel after the two endpoints
+	if (fourCC == DDS_FOURCC('D', 'X', 'T', '3')) {
+		for (unsigned top = 0u, bottom = rowsNumber - 1u; top < bottom; ++top, --bottom) {
+			unsigned char low = block[top * 2u];
+			unsigned char high = block[top * 2u + 1u];
+			block[top * 2u] = block[bottom * 2u];
+			block[top * 2u + 1u] = block[bottom * 2u + 1u];
+			block[bottom * 2u] = low;
+			block[bottom * 2u + 1u] = high;
+		}
+		color += 8u;
+	} else if (fourCC == DDS_FOURCC('D', 'X', 'T', '5')) {
+		unsigned long long indices = 0u;
+		for (unsigned i = 0u; i < 6u; ++i) {
+			indices |= (unsigned long long)block[2u + i] << (8u * i);
+		}
+
+		unsigned long long flipped = indices;
+		for (unsigned i = 0u; i < rowsNumber; ++i) {
+			unsigned long long rowBits = (indices >> (12u * i)) & 0xfffu;
+			flipped &= ~(0xfffull << (12u * (rowsNumber - 1u - i)));
+			flipped |= rowBits << (12u * (rowsNumber - 1u - i));
+		}
+
+		for (unsigned i = 0u; i < 6u; ++i) {
+			block[2u + i] = (unsigned char)(flipped >> (8u * i));
+		}
+		color += 8u;
+	}
+
+	// Color indices are a byte per row after the two 16 bit endpoints
+	for (unsigned top = 0u, bottom = rowsNumber - 1u; top < bottom; ++top, --bottom) {
+		unsigned char indices = color[4u + top];
+		color[4u + top] = color[4u + bottom];
+		color[4u + bottom] = indices;
+	}
+}
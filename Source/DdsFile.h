@@ -0,0 +1,99 @@
+#ifndef __DDSFILE_H__
+#define __DDSFILE_H__
+
+#include <string>
+#include <vector>
+
+#define DDS_MAGIC 0x20534444u // "DDS "
+#define DDS_BLOCK_SIZE 4u // pixels on each side of a compressed block
+#define DDS_FOURCC(a, b, c, d) ((unsigned)(a) | ((unsigned)(b) << 8) | ((unsigned)(c) << 16) | ((unsigned)(d) << 24))
+
+#define DDSD_CAPS 0x1u
+#define DDSD_HEIGHT 0x2u
+#define DDSD_WIDTH 0x4u
+#define DDSD_PIXELFORMAT 0x1000u
+#define DDSD_MIPMAPCOUNT 0x20000u
+#define DDSD_LINEARSIZE 0x80000u
+#define DDPF_FOURCC 0x4u
+#define DDSCAPS_COMPLEX 0x8u
+#define DDSCAPS_TEXTURE 0x1000u
+#define DDSCAPS_MIPMAP 0x400000u
+
+// Set in reserved1[9] by the cooker, its levels start at the bottom row as OpenGL expects instead of at the top
+#define DDS_BOTTOM_UP DDS_FOURCC('B', 'T', 'U', 'P')
+
+// Layout of the file right after the magic, as documented for DirectDraw surfaces
+struct DdsPixelFormat {
+	unsigned	size = sizeof(DdsPixelFormat);
+	unsigned	flags = 0u;
+	unsigned	fourCC = 0u;
+	unsigned	rgbBitCount = 0u;
+	unsigned	rBitMask = 0u;
+	unsigned	gBitMask = 0u;
+	unsigned	bBitMask = 0u;
+	unsigned	aBitMask = 0u;
+};
+
+struct DdsHeader {
+	unsigned		size = sizeof(DdsHeader);
+	unsigned		flags = 0u;
+	unsigned		height = 0u;
+	unsigned		width = 0u;
+	unsigned		pitchOrLinearSize = 0u;
+	unsigned		depth = 0u;
+	unsigned		mipMapCount = 0u;
+	unsigned		reserved1[11] = {};
+	DdsPixelFormat	pixelFormat;
+	unsigned		caps = 0u;
+	unsigned		caps2 = 0u;
+	unsigned		caps3 = 0u;
+	unsigned		caps4 = 0u;
+	unsigned		reserved2 = 0u;
+};
+
+// Level of a block compressed texture, levels are stored one after the other from the biggest
+struct DdsLevel {
+	unsigned					width = 0u;
+	unsigned					height = 0u;
+	std::vector<unsigned char>	blocks;
+};
+
+struct DdsTexture {
+	unsigned				fourCC = 0u;
+	bool					bottomUp = false;
+	std::vector<DdsLevel>	levels;
+};
+
+// Block compressed DirectDraw surface files, DXT1, DXT3 and DXT5 are read, the texture cooker writes DXT5
+class DdsFile
+{
+	public:
+		// Returns the bytes written to buffer, allocated with new[]
+		static unsigned Write(unsigned fourCC, const std::vector<DdsLevel>& levels, bool bottomUp, char** buffer);
+
+		// False when the buffer is not a complete DDS in one of the read formats
+		static bool		Read(const char* buffer, unsigned size, DdsTexture& texture);
+		static bool		ReadHeader(const char* buffer, unsigned size, DdsHeader& header);
+
+		// Upside down, false when a level cannot be flipped without decompressing it
+		static bool		Flip(DdsTexture& texture);
+
+		// Reads the file, writes it back and flips it, checking every step keeps the pixels where they belong
+		static bool		Validate(const char* buffer, unsigned size, std::string* error);
+
+		// Validates a chain of every read format built from the sample blocks, cooked files are all DXT5
+		static bool		ValidateFormats(std::string* error);
+
+		// RGBA8 rows in the order they are stored, padded to whole blocks
+		static void		DecodeLevel(unsigned fourCC, const DdsLevel& level, std::vector<unsigned char>& pixels);
+
+		// Bytes of every 4x4 block, 0 for formats that are not read
+		static unsigned	BlockBytes(unsigned fourCC);
+		static unsigned	LevelBytes(unsigned fourCC, unsigned width, unsigned height);
+
+	private:
+		static void		DecodeColorBlock(const unsigned char* block, bool opaque, unsigned char* pixels, unsigned pitch);
+		static void		FlipBlock(unsigned fourCC, unsigned char* block, unsigned rowsNumber);
+};
+
+#endif
@@ -14,6 +14,14 @@ void DockAssets::Draw() {
 		return;
 	}
 
+	unsigned meshesToImport = App->library->meshesToImport;
+	unsigned importedMeshes = App->library->importedMeshes;
+	if (importedMeshes < meshesToImport) {
+		char progress[64];
+		sprintf_s(progress, 64, "Importing meshes %u / %u", importedMeshes, meshesToImport);
+		ImGui::ProgressBar((float)importedMeshes / (float)meshesToImport, ImVec2(-1.0f, 0.0f), progress);
+	}
+
 	ImGuiTreeNodeFlags node_flags = ImGuiTreeNodeFlags_OpenOnArrow | ImGuiTreeNodeFlags_OpenOnDoubleClick;
 
 	bool libraryOpen = ImGui::TreeNodeEx("Library", node_flags, "Library");
@@ -7,6 +7,8 @@
 #include "ModuleInput.h"
 #include "ModuleTime.h"
 #include "ModuleTextures.h"
+#include "ModuleProgram.h"
+#include "ModuleLibrary.h"
 
 #include "mmgr/mmgr.h"
 
@@ -91,6 +93,10 @@ void DockConfig::Draw() {
 		App->camera->DrawGUI();
 	}
 
+	if (ImGui::CollapsingHeader("Renderer")) {
+		App->renderer->DrawGUI();
+	}
+
 	if (ImGui::CollapsingHeader("Input")) {
 		App->input->DrawGUI();
 	}
@@ -99,6 +105,14 @@ void DockConfig::Draw() {
 		App->textures->DrawGUI();
 	}
 
+	if (ImGui::CollapsingHeader("Library")) {
+		App->library->DrawGUI();
+	}
+
+	if (ImGui::CollapsingHeader("Shaders")) {
+		App->program->DrawGUI();
+	}
+
 	if (ImGui::CollapsingHeader("Window")) {
 		App->window->DrawGUI();
 	}
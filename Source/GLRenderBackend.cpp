@@ -0,0 +1,95 @@
+#include "Globals.h"
+#include "GLRenderBackend.h"
+#include "GLStateCache.h"
+#include "RenderQueue.h"
+#include "glew-2.1.0\include\GL\glew.h"
+
+GLRenderBackend::GLRenderBackend(GLStateCache* state, bool multiDrawIndirect, bool baseInstance, unsigned instanceBuffer) :
+	state(state), multiDrawIndirect(multiDrawIndirect), baseInstance(baseInstance), instanceBuffer(instanceBuffer) {
+	assert(state != nullptr);
+}
+
+GLRenderBackend::~GLRenderBackend() { }
+
+const char* GLRenderBackend::GetName() const {
+	return "OpenGL";
+}
+
+void GLRenderBackend::BindFramebuffer(unsigned fbo) {
+	state->BindFramebuffer(GL_FRAMEBUFFER, fbo);
+}
+
+void GLRenderBackend::Clear(float red, float green, float blue, float alpha) {
+	glClearColor(red, green, blue, alpha);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void GLRenderBackend::PolygonMode(unsigned mode) {
+	state->PolygonMode(mode);
+}
+
+void GLRenderBackend::UpdateUniformBuffer(unsigned buffer, unsigned offset, unsigned size, const void* data) {
+	state->BindBuffer(GL_UNIFORM_BUFFER, buffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data);
+}
+
+void GLRenderBackend::UploadBuffer(unsigned target, unsigned buffer, unsigned size, const void* data) {
+	// Orphaning keeps the driver from waiting on the draws still reading last frame's data
+	state->BindBuffer(target, buffer);
+	glBufferData(target, size, data, GL_STREAM_DRAW);
+}
+
+void GLRenderBackend::UseProgram(unsigned program) {
+	state->UseProgram(program);
+}
+
+void GLRenderBackend::BindVertexArray(unsigned vao) {
+	state->BindVertexArray(vao);
+}
+
+void GLRenderBackend::BindTexture(unsigned unit, unsigned texture) {
+	state->ActiveTexture(GL_TEXTURE0 + unit);
+	state->BindTexture(GL_TEXTURE_2D, texture);
+}
+
+void GLRenderBackend::SetUniform1i(unsigned program, const char* name, int value) {
+	glUniform1i(glGetUniformLocation(program, name), value);
+}
+
+void GLRenderBackend::SetUniform1f(unsigned program, const char* name, float value) {
+	glUniform1f(glGetUniformLocation(program, name), value);
+}
+
+void GLRenderBackend::SetUniform3fv(unsigned program, const char* name, const float* values) {
+	glUniform3fv(glGetUniformLocation(program, name), 1, values);
+}
+
+void GLRenderBackend::SetUniform4fv(unsigned program, const char* name, const float* values) {
+	glUniform4fv(glGetUniformLocation(program, name), 1, values);
+}
+
+void GLRenderBackend::DrawIndirect(const DrawElementsIndirectCommand* commands, unsigned firstCommand, unsigned commandsNumber, unsigned indexSize) {
+	GLenum indexType = (indexSize == sizeof(unsigned short)) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+
+	if (multiDrawIndirect) {
+		unsigned offset = sizeof(DrawElementsIndirectCommand) * firstCommand;
+		glMultiDrawElementsIndirect(GL_TRIANGLES, indexType, (void*)offset, commandsNumber, 0);
+		return;
+	}
+
+	for (unsigned i = firstCommand; i < firstCommand + commandsNumber; ++i) {
+		const DrawElementsIndirectCommand& command = commands[i];
+		if (baseInstance) {
+			glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, command.count, indexType, (void*)(command.firstIndex * indexSize), command.instanceCount, command.baseVertex, command.baseInstance);
+			continue;
+		}
+
+		// Without base instances the instance attributes of the bound VAO start at the command's first instance instead
+		state->BindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+		for (unsigned j = 0u; j < INSTANCE_ATTRIBUTE_VECTORS; ++j) {
+			unsigned offset = sizeof(InstanceData) * command.baseInstance + sizeof(math::float4) * j;
+			glVertexAttribPointer(INSTANCE_FIRST_ATTRIBUTE + j, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)offset);
+		}
+		glDrawElementsInstancedBaseVertex(GL_TRIANGLES, command.count, indexType, (void*)(command.firstIndex * indexSize), command.instanceCount, command.baseVertex);
+	}
+}
@@ -0,0 +1,41 @@
+#ifndef __GLRENDERBACKEND_H__
+#define __GLRENDERBACKEND_H__
+
+#include "RenderBackend.h"
+
+class GLStateCache;
+
+class GLRenderBackend : public RenderBackend
+{
+	public:
+		GLRenderBackend(GLStateCache* state, bool multiDrawIndirect, bool baseInstance, unsigned instanceBuffer);
+		~GLRenderBackend();
+
+		const char*	GetName() const override;
+
+		void		BindFramebuffer(unsigned fbo) override;
+		void		Clear(float red, float green, float blue, float alpha) override;
+		void		PolygonMode(unsigned mode) override;
+
+		void		UpdateUniformBuffer(unsigned buffer, unsigned offset, unsigned size, const void* data) override;
+		void		UploadBuffer(unsigned target, unsigned buffer, unsigned size, const void* data) override;
+
+		void		UseProgram(unsigned program) override;
+		void		BindVertexArray(unsigned vao) override;
+		void		BindTexture(unsigned unit, unsigned texture) override;
+
+		void		SetUniform1i(unsigned program, const char* name, int value) override;
+		void		SetUniform1f(unsigned program, const char* name, float value) override;
+		void		SetUniform3fv(unsigned program, const char* name, const float* values) override;
+		void		SetUniform4fv(unsigned program, const char* name, const float* values) override;
+
+		void		DrawIndirect(const DrawElementsIndirectCommand* commands, unsigned firstCommand, unsigned commandsNumber, unsigned indexSize) override;
+
+	private:
+		GLStateCache*	state = nullptr;
+		bool			multiDrawIndirect = false;
+		bool			baseInstance = false;
+		unsigned		instanceBuffer = 0u;
+};
+
+#endif
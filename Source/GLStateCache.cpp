@@ -0,0 +1,265 @@
+#include "Globals.h"
+#include "GLStateCache.h"
+#include "imgui.h"
+#include "glew-2.1.0\include\GL\glew.h"
+
+// Never a valid GL name, forces the next call to reach the driver
+#define GL_STATE_UNKNOWN 0xFFFFFFFFu
+
+GLStateCache::GLStateCache() {
+	Invalidate();
+}
+
+GLStateCache::~GLStateCache() { }
+
+void GLStateCache::Invalidate() {
+	program = GL_STATE_UNKNOWN;
+	vao = GL_STATE_UNKNOWN;
+	arrayBuffer = GL_STATE_UNKNOWN;
+	uniformBuffer = GL_STATE_UNKNOWN;
+	indirectBuffer = GL_STATE_UNKNOWN;
+	copyReadBuffer = GL_STATE_UNKNOWN;
+	copyWriteBuffer = GL_STATE_UNKNOWN;
+	activeUnit = GL_STATE_UNKNOWN;
+	drawFramebuffer = GL_STATE_UNKNOWN;
+	readFramebuffer = GL_STATE_UNKNOWN;
+	polygonMode = GL_STATE_UNKNOWN;
+	blendSource = GL_STATE_UNKNOWN;
+	blendDestination = GL_STATE_UNKNOWN;
+
+	for (unsigned i = 0u; i < GL_STATE_TEXTURE_UNITS; ++i) {
+		textures[i] = GL_STATE_UNKNOWN;
+	}
+
+	capabilities.clear();
+}
+
+void GLStateCache::ResetCounters() {
+	lastIssuedCalls = issuedCalls;
+	lastFilteredCalls = filteredCalls;
+	issuedCalls = 0u;
+	filteredCalls = 0u;
+}
+
+bool GLStateCache::Filter(bool changed) {
+	if (changed) {
+		++issuedCalls;
+	} else {
+		++filteredCalls;
+	}
+
+	return changed;
+}
+
+unsigned* GLStateCache::GetBufferSlot(unsigned target) {
+	switch (target) {
+		case GL_ARRAY_BUFFER:			return &arrayBuffer;
+		case GL_UNIFORM_BUFFER:			return &uniformBuffer;
+		case GL_DRAW_INDIRECT_BUFFER:	return &indirectBuffer;
+		case GL_COPY_READ_BUFFER:		return &copyReadBuffer;
+		case GL_COPY_WRITE_BUFFER:		return &copyWriteBuffer;
+		default:						return nullptr; // GL_ELEMENT_ARRAY_BUFFER lives in the VAO, not tracked
+	}
+}
+
+void GLStateCache::UseProgram(unsigned newProgram) {
+	if (Filter(program != newProgram)) {
+		program = newProgram;
+		glUseProgram(newProgram);
+	}
+}
+
+void GLStateCache::BindVertexArray(unsigned newVao) {
+	if (Filter(vao != newVao)) {
+		vao = newVao;
+		glBindVertexArray(newVao);
+	}
+}
+
+void GLStateCache::BindBuffer(unsigned target, unsigned buffer) {
+	unsigned* slot = GetBufferSlot(target);
+
+	if (slot == nullptr) {
+		++issuedCalls;
+		glBindBuffer(target, buffer);
+		return;
+	}
+
+	if (Filter(*slot != buffer)) {
+		*slot = buffer;
+		glBindBuffer(target, buffer);
+	}
+}
+
+void GLStateCache::ActiveTexture(unsigned unit) {
+	if (Filter(activeUnit != unit)) {
+		activeUnit = unit;
+		glActiveTexture(unit);
+	}
+}
+
+void GLStateCache::BindTexture(unsigned target, unsigned texture) {
+	unsigned unitIndex = activeUnit - GL_TEXTURE0;
+
+	if (target != GL_TEXTURE_2D || activeUnit == GL_STATE_UNKNOWN || unitIndex >= GL_STATE_TEXTURE_UNITS) {
+		++issuedCalls;
+		glBindTexture(target, texture);
+		return;
+	}
+
+	if (Filter(textures[unitIndex] != texture)) {
+		textures[unitIndex] = texture;
+		glBindTexture(target, texture);
+	}
+}
+
+void GLStateCache::BindFramebuffer(unsigned target, unsigned fbo) {
+	bool changed = false;
+
+	if (target == GL_FRAMEBUFFER) {
+		changed = drawFramebuffer != fbo || readFramebuffer != fbo;
+		drawFramebuffer = readFramebuffer = fbo;
+	} else if (target == GL_DRAW_FRAMEBUFFER) {
+		changed = drawFramebuffer != fbo;
+		drawFramebuffer = fbo;
+	} else {
+		changed = readFramebuffer != fbo;
+		readFramebuffer = fbo;
+	}
+
+	if (Filter(changed)) {
+		glBindFramebuffer(target, fbo);
+	}
+}
+
+void GLStateCache::Enable(unsigned capability) {
+	SetEnabled(capability, true);
+}
+
+void GLStateCache::Disable(unsigned capability) {
+	SetEnabled(capability, false);
+}
+
+void GLStateCache::SetEnabled(unsigned capability, bool enabled) {
+	std::map<unsigned, bool>::iterator it = capabilities.find(capability);
+
+	if (Filter(it == capabilities.end() || it->second != enabled)) {
+		capabilities[capability] = enabled;
+		if (enabled) {
+			glEnable(capability);
+		} else {
+			glDisable(capability);
+		}
+	}
+}
+
+bool GLStateCache::IsEnabled(unsigned capability) {
+	std::map<unsigned, bool>::iterator it = capabilities.find(capability);
+
+	if (it != capabilities.end()) {
+		return it->second;
+	}
+
+	bool enabled = glIsEnabled(capability) == GL_TRUE;
+	capabilities[capability] = enabled;
+
+	return enabled;
+}
+
+void GLStateCache::PolygonMode(unsigned mode) {
+	if (Filter(polygonMode != mode)) {
+		polygonMode = mode;
+		glPolygonMode(GL_FRONT_AND_BACK, mode);
+	}
+}
+
+void GLStateCache::BlendFunc(unsigned source, unsigned destination) {
+	if (Filter(blendSource != source || blendDestination != destination)) {
+		blendSource = source;
+		blendDestination = destination;
+		glBlendFunc(source, destination);
+	}
+}
+
+void GLStateCache::DeleteBuffer(unsigned& buffer) {
+	if (buffer == 0u) {
+		return;
+	}
+
+	unsigned* slots[] = { &arrayBuffer, &uniformBuffer, &indirectBuffer, &copyReadBuffer, &copyWriteBuffer };
+	for (unsigned i = 0u; i < sizeof(slots) / sizeof(slots[0]); ++i) {
+		if (*slots[i] == buffer) {
+			*slots[i] = 0u;
+		}
+	}
+
+	glDeleteBuffers(1, &buffer);
+	buffer = 0u;
+}
+
+void GLStateCache::DeleteVertexArray(unsigned& deletedVao) {
+	if (deletedVao == 0u) {
+		return;
+	}
+
+	if (vao == deletedVao) {
+		vao = 0u;
+	}
+
+	glDeleteVertexArrays(1, &deletedVao);
+	deletedVao = 0u;
+}
+
+void GLStateCache::DeleteTexture(unsigned& texture) {
+	if (texture == 0u) {
+		return;
+	}
+
+	for (unsigned i = 0u; i < GL_STATE_TEXTURE_UNITS; ++i) {
+		if (textures[i] == texture) {
+			textures[i] = 0u;
+		}
+	}
+
+	glDeleteTextures(1, &texture);
+	texture = 0u;
+}
+
+void GLStateCache::DeleteFramebuffer(unsigned& fbo) {
+	if (fbo == 0u) {
+		return;
+	}
+
+	if (drawFramebuffer == fbo) {
+		drawFramebuffer = 0u;
+	}
+
+	if (readFramebuffer == fbo) {
+		readFramebuffer = 0u;
+	}
+
+	glDeleteFramebuffers(1, &fbo);
+	fbo = 0u;
+}
+
+void GLStateCache::DeleteProgram(unsigned& deletedProgram) {
+	if (deletedProgram == 0u) {
+		return;
+	}
+
+	// A program in use is only flagged for deletion and stays current, its name can not be trusted anymore
+	if (program == deletedProgram) {
+		program = GL_STATE_UNKNOWN;
+	}
+
+	glDeleteProgram(deletedProgram);
+	deletedProgram = 0u;
+}
+
+void GLStateCache::DrawGUI() {
+	unsigned total = lastIssuedCalls + lastFilteredCalls;
+	float filteredRatio = total > 0u ? 100.0f * (float)lastFilteredCalls / (float)total : 0.0f;
+
+	ImGui::Text("State calls issued: %u", lastIssuedCalls);
+	ImGui::Text("State calls filtered: %u (%.1f%%)", lastFilteredCalls, filteredRatio);
+}
@@ -0,0 +1,69 @@
+#ifndef __GLSTATECACHE_H__
+#define __GLSTATECACHE_H__
+
+#include <map>
+
+#define GL_STATE_TEXTURE_UNITS 16u
+
+// Mirrors the GL bindings we change every frame and only forwards real changes to the driver.
+// Anything touching GL behind its back (ImGui backend, external libs) has to call Invalidate().
+class GLStateCache
+{
+	public:
+		GLStateCache();
+		~GLStateCache();
+
+		void		Invalidate();
+		void		ResetCounters();
+
+		void		UseProgram(unsigned program);
+		void		BindVertexArray(unsigned vao);
+		void		BindBuffer(unsigned target, unsigned buffer);
+		void		ActiveTexture(unsigned unit);
+		void		BindTexture(unsigned target, unsigned texture);
+		void		BindFramebuffer(unsigned target, unsigned fbo);
+		void		Enable(unsigned capability);
+		void		Disable(unsigned capability);
+		void		SetEnabled(unsigned capability, bool enabled);
+		bool		IsEnabled(unsigned capability);
+		void		PolygonMode(unsigned mode);
+		void		BlendFunc(unsigned source, unsigned destination);
+
+		// Deleting a bound object resets the binding to 0 in GL, the cache has to follow
+		void		DeleteBuffer(unsigned& buffer);
+		void		DeleteVertexArray(unsigned& vao);
+		void		DeleteTexture(unsigned& texture);
+		void		DeleteFramebuffer(unsigned& fbo);
+		void		DeleteProgram(unsigned& program);
+
+		void		DrawGUI();
+
+	private:
+		bool		Filter(bool changed);
+		unsigned*	GetBufferSlot(unsigned target);
+
+	public:
+		unsigned	issuedCalls = 0u;
+		unsigned	filteredCalls = 0u;
+		unsigned	lastIssuedCalls = 0u;
+		unsigned	lastFilteredCalls = 0u;
+
+	private:
+		unsigned					program;
+		unsigned					vao;
+		unsigned					arrayBuffer;
+		unsigned					uniformBuffer;
+		unsigned					indirectBuffer;
+		unsigned					copyReadBuffer;
+		unsigned					copyWriteBuffer;
+		unsigned					activeUnit;
+		unsigned					textures[GL_STATE_TEXTURE_UNITS];
+		unsigned					drawFramebuffer;
+		unsigned					readFramebuffer;
+		unsigned					polygonMode;
+		unsigned					blendSource;
+		unsigned					blendDestination;
+		std::map<unsigned, bool>	capabilities;
+};
+
+#endif
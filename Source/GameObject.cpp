@@ -88,6 +88,8 @@ GameObject::GameObject(const GameObject& duplicateGameObject) {
 		UpdateStaticChilds(staticGo);
 	}
 	bbox = duplicateGameObject.bbox;
+	bsphere = duplicateGameObject.bsphere;
+	obb = duplicateGameObject.obb;
 
 	for (const auto &component : duplicateGameObject.components) {
 		Component* duplicatedComponent = component->Duplicate();
@@ -410,10 +412,15 @@ void GameObject::ComputeBBox() {
 		}
 	}
 
-	if (mesh != nullptr && transform != nullptr) {
-		bbox.SetNegativeInfinity();
-		bbox.Enclose(mesh->mesh.bbox);
-		bbox.TransformAsAABB(transform->GetGlobalTransform());
+	if (mesh != nullptr && mesh->resource != nullptr && transform != nullptr) {
+		math::float4x4 global = transform->GetGlobalTransform();
+		obb = mesh->GetBoundingObb();
+		obb.Transform(global);
+		bbox = obb.MinimalEnclosingAABB();
+
+		bsphere = mesh->GetBoundingSphere();
+		bsphere.pos = global.TransformPos(bsphere.pos);
+		bsphere.r *= global.GetScale().MaxElement();
 	}
 
 }
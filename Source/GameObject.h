@@ -11,6 +11,8 @@
 
 #include "MathGeoLib\include\Math\float4x4.h"
 #include "MathGeoLib\include\Geometry\AABB.h"
+#include "Geometry/OBB.h"
+#include "Geometry/Sphere.h"
 
 #include "rapidjson-1.1.0\include\rapidjson\document.h"
 #include "rapidjson-1.1.0\include\rapidjson\prettywriter.h"
@@ -65,7 +67,10 @@ class GameObject
 		GameObject*						parent = nullptr;
 
 
+		// World space, the box encloses the obb so it stays tight on rotated objects
 		math::AABB						bbox;
+		math::Sphere					bsphere;
+		math::OBB						obb;
 
 		ComponentTransform*				transform = nullptr;
 		ComponentMesh*					mesh = nullptr;
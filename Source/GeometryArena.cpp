@@ -0,0 +1,382 @@
+#include "Globals.h"
+#include "GeometryArena.h"
+#include "Application.h"
+#include "ModuleRender.h"
+#include "ModuleTextures.h"
+#include "GLStateCache.h"
+#include "imgui.h"
+#include "glew-2.1.0\include\GL\glew.h"
+#include "Math/float4x4.h"
+#include <limits.h>
+
+#define ARENA_VERTEX_CAPACITY	(8u * 1024u * 1024u)
+#define ARENA_INDEX_CAPACITY	(4u * 1024u * 1024u)
+#define ARENA_DEFRAG_THRESHOLD	0.5f
+#define ARENA_DEFRAG_MIN_BLOCKS	16u
+
+/* GeometryArena */
+GeometryArena::GeometryArena() { }
+
+GeometryArena::~GeometryArena() {
+	CleanUp();
+}
+
+void GeometryArena::Init(bool gpuBuffers) {
+	this->gpuBuffers = gpuBuffers;
+	indexAllocator.Grow(ARENA_INDEX_CAPACITY);
+
+	if (!gpuBuffers) {
+		return;
+	}
+
+	glGenBuffers(1, &ibo);
+	App->renderer->glState->BindBuffer(GL_COPY_WRITE_BUFFER, ibo);
+	glBufferData(GL_COPY_WRITE_BUFFER, ARENA_INDEX_CAPACITY, nullptr, GL_STATIC_DRAW);
+
+	glGenBuffers(1, &instanceVbo);
+}
+
+void GeometryArena::CleanUp() {
+	for (std::vector<VertexPool*>::iterator it = pools.begin(); it != pools.end(); ++it) {
+		App->renderer->glState->DeleteVertexArray((*it)->vao);
+		App->renderer->glState->DeleteBuffer((*it)->vbo);
+		delete *it;
+	}
+	pools.clear();
+
+	App->renderer->glState->DeleteBuffer(ibo);
+	App->renderer->glState->DeleteBuffer(instanceVbo);
+
+	allocations.clear();
+	freeHandles.clear();
+	contentHandles.clear();
+}
+
+unsigned GeometryArena::Allocate(const Mesh& mesh) {
+	if (mesh.vertexData == nullptr || mesh.indices == nullptr || mesh.verticesNumber == 0u || mesh.indicesNumber == 0u) {
+		return 0u;
+	}
+
+	if (mesh.contentHash != 0u) {
+		std::map<unsigned long long, unsigned>::const_iterator shared = contentHandles.find(mesh.contentHash);
+		if (shared != contentHandles.end()) {
+			++allocations[shared->second - 1].references;
+			return shared->second;
+		}
+	}
+
+	ArenaAllocation allocation;
+	allocation.used = true;
+	allocation.references = 1u;
+	allocation.contentHash = mesh.contentHash;
+	allocation.vertexFormat = mesh.format.Key();
+	allocation.indicesNumber = mesh.indicesNumber;
+	allocation.indexSize = mesh.indexSize;
+
+	VertexPool* pool = GetPool(allocation.vertexFormat);
+	unsigned vertexBytes = pool->stride * mesh.verticesNumber;
+	unsigned indexBytes = mesh.indexSize * mesh.indicesNumber;
+
+	if (!pool->allocator.Allocate(vertexBytes, pool->stride, allocation.vertexBlock)) {
+		if (!GrowVertexPool(pool, vertexBytes) || !pool->allocator.Allocate(vertexBytes, pool->stride, allocation.vertexBlock)) {
+			LOG("Error: Vertex pool 0x%06X has no room for %u KB", allocation.vertexFormat, vertexBytes / 1024u);
+			return 0u;
+		}
+	}
+
+	if (!indexAllocator.Allocate(indexBytes, mesh.indexSize, allocation.indexBlock)) {
+		if (!GrowIndexBuffer(indexBytes) || !indexAllocator.Allocate(indexBytes, mesh.indexSize, allocation.indexBlock)) {
+			LOG("Error: Index buffer has no room for %u KB", indexBytes / 1024u);
+			pool->allocator.Free(allocation.vertexBlock);
+			return 0u;
+		}
+	}
+
+	allocation.baseVertex = allocation.vertexBlock.offset / pool->stride;
+	allocation.firstIndex = allocation.indexBlock.offset / mesh.indexSize;
+
+	// Vertices were cooked interleaved at import, they go up in a single copy
+	if (gpuBuffers) {
+		App->renderer->glState->BindBuffer(GL_COPY_WRITE_BUFFER, pool->vbo);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, allocation.vertexBlock.offset, vertexBytes, mesh.vertexData);
+		App->renderer->glState->BindBuffer(GL_COPY_WRITE_BUFFER, ibo);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, allocation.indexBlock.offset, indexBytes, mesh.indices);
+	}
+
+	unsigned handle = 0u;
+	if (freeHandles.size() > 0) {
+		handle = freeHandles.back();
+		freeHandles.pop_back();
+		allocations[handle - 1] = allocation;
+	} else {
+		allocations.push_back(allocation);
+		handle = allocations.size();
+	}
+
+	if (mesh.contentHash != 0u) {
+		contentHandles[mesh.contentHash] = handle;
+	}
+
+	return handle;
+}
+
+void GeometryArena::Free(unsigned handle) {
+	if (handle == 0u || handle > allocations.size() || !allocations[handle - 1].used) {
+		return;
+	}
+
+	ArenaAllocation& allocation = allocations[handle - 1];
+	if (--allocation.references > 0u) {
+		return;
+	}
+
+	if (allocation.contentHash != 0u) {
+		contentHandles.erase(allocation.contentHash);
+	}
+
+	GetPool(allocation.vertexFormat)->allocator.Free(allocation.vertexBlock);
+	indexAllocator.Free(allocation.indexBlock);
+
+	allocation = ArenaAllocation();
+	freeHandles.push_back(handle);
+}
+
+const ArenaAllocation* GeometryArena::GetAllocation(unsigned handle) const {
+	if (handle == 0u || handle > allocations.size() || !allocations[handle - 1].used) {
+		return nullptr;
+	}
+
+	return &allocations[handle - 1];
+}
+
+unsigned GeometryArena::GetVao(unsigned vertexFormat) const {
+	for (std::vector<VertexPool*>::const_iterator it = pools.begin(); it != pools.end(); ++it) {
+		if ((*it)->vertexFormat == vertexFormat) {
+			return (*it)->vao;
+		}
+	}
+
+	return 0u;
+}
+
+bool GeometryArena::NeedsDefragment() const {
+	if (indexAllocator.Fragmentation() > ARENA_DEFRAG_THRESHOLD && indexAllocator.FreeBlocksNumber() > ARENA_DEFRAG_MIN_BLOCKS) {
+		return true;
+	}
+
+	for (std::vector<VertexPool*>::const_iterator it = pools.begin(); it != pools.end(); ++it) {
+		if ((*it)->allocator.Fragmentation() > ARENA_DEFRAG_THRESHOLD && (*it)->allocator.FreeBlocksNumber() > ARENA_DEFRAG_MIN_BLOCKS) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void GeometryArena::Defragment() {
+	for (std::vector<VertexPool*>::iterator it = pools.begin(); it != pools.end(); ++it) {
+		DefragmentVertexPool(*it);
+	}
+
+	DefragmentIndexBuffer();
+}
+
+void GeometryArena::DrawGUI() {
+	ImGui::Text("Index buffer: %u / %u KB (fragmentation %.2f)", indexAllocator.Used() / 1024u, indexAllocator.Capacity() / 1024u, indexAllocator.Fragmentation());
+
+	unsigned sharedReferences = 0u;
+	for (std::vector<ArenaAllocation>::const_iterator it = allocations.begin(); it != allocations.end(); ++it) {
+		sharedReferences += (it->used && it->references > 1u) ? it->references - 1u : 0u;
+	}
+	ImGui::Text("Meshes sharing an allocation with the same content: %u", sharedReferences);
+
+	for (std::vector<VertexPool*>::const_iterator it = pools.begin(); it != pools.end(); ++it) {
+		ImGui::Text("Vertex pool 0x%06X (stride %u): %u / %u KB (fragmentation %.2f)", (*it)->vertexFormat, (*it)->stride, (*it)->allocator.Used() / 1024u, (*it)->allocator.Capacity() / 1024u, (*it)->allocator.Fragmentation());
+	}
+
+	if (ImGui::Button("Defragment geometry")) {
+		Defragment();
+	}
+}
+
+VertexPool* GeometryArena::GetPool(unsigned vertexFormat) {
+	for (std::vector<VertexPool*>::iterator it = pools.begin(); it != pools.end(); ++it) {
+		if ((*it)->vertexFormat == vertexFormat) {
+			return *it;
+		}
+	}
+
+	VertexPool* pool = new VertexPool();
+	pool->vertexFormat = vertexFormat;
+	pool->format.FromKey(vertexFormat);
+	pool->stride = pool->format.stride;
+	pool->allocator.Grow(ARENA_VERTEX_CAPACITY);
+
+	if (gpuBuffers) {
+		glGenBuffers(1, &pool->vbo);
+		App->renderer->glState->BindBuffer(GL_COPY_WRITE_BUFFER, pool->vbo);
+		glBufferData(GL_COPY_WRITE_BUFFER, ARENA_VERTEX_CAPACITY, nullptr, GL_STATIC_DRAW);
+
+		glGenVertexArrays(1, &pool->vao);
+		SetupVao(pool);
+	}
+
+	pools.push_back(pool);
+
+	return pool;
+}
+
+// Doubles the capacity or adds what is needed, false when the result does not fit 32 bit offsets
+static bool GrownCapacity(unsigned oldCapacity, unsigned long long neededSize, unsigned& newCapacity) {
+	if (oldCapacity + neededSize > UINT_MAX) {
+		return false;
+	}
+
+	unsigned long long grown = MAX((unsigned long long)oldCapacity * 2u, oldCapacity + neededSize);
+	newCapacity = (unsigned)MIN(grown, (unsigned long long)UINT_MAX);
+	return true;
+}
+
+bool GeometryArena::GrowVertexPool(VertexPool* pool, unsigned neededSize) {
+	unsigned oldCapacity = pool->allocator.Capacity();
+	unsigned newCapacity = 0u;
+	if (!GrownCapacity(oldCapacity, (unsigned long long)neededSize + pool->stride, newCapacity)) {
+		return false;
+	}
+
+	pool->allocator.Grow(newCapacity);
+
+	if (gpuBuffers) {
+		unsigned newVbo = 0u;
+		glGenBuffers(1, &newVbo);
+		App->renderer->glState->BindBuffer(GL_COPY_WRITE_BUFFER, newVbo);
+		glBufferData(GL_COPY_WRITE_BUFFER, newCapacity, nullptr, GL_STATIC_DRAW);
+		App->renderer->glState->BindBuffer(GL_COPY_READ_BUFFER, pool->vbo);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldCapacity);
+
+		App->renderer->glState->DeleteBuffer(pool->vbo);
+		pool->vbo = newVbo;
+		SetupVao(pool);
+	}
+
+	LOG("Vertex pool 0x%06X grown to %u KB", pool->vertexFormat, newCapacity / 1024u);
+	return true;
+}
+
+bool GeometryArena::GrowIndexBuffer(unsigned neededSize) {
+	unsigned oldCapacity = indexAllocator.Capacity();
+	unsigned newCapacity = 0u;
+	if (!GrownCapacity(oldCapacity, (unsigned long long)neededSize + sizeof(unsigned), newCapacity)) {
+		return false;
+	}
+
+	indexAllocator.Grow(newCapacity);
+
+	if (gpuBuffers) {
+		unsigned newIbo = 0u;
+		glGenBuffers(1, &newIbo);
+		App->renderer->glState->BindBuffer(GL_COPY_WRITE_BUFFER, newIbo);
+		glBufferData(GL_COPY_WRITE_BUFFER, newCapacity, nullptr, GL_STATIC_DRAW);
+		App->renderer->glState->BindBuffer(GL_COPY_READ_BUFFER, ibo);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldCapacity);
+
+		App->renderer->glState->DeleteBuffer(ibo);
+		ibo = newIbo;
+
+		// Every VAO keeps a reference to the element buffer
+		for (std::vector<VertexPool*>::iterator it = pools.begin(); it != pools.end(); ++it) {
+			SetupVao(*it);
+		}
+	}
+
+	LOG("Index buffer grown to %u KB", newCapacity / 1024u);
+	return true;
+}
+
+void GeometryArena::SetupVao(VertexPool* pool) const {
+	App->renderer->glState->BindVertexArray(pool->vao);
+	App->renderer->glState->BindBuffer(GL_ARRAY_BUFFER, pool->vbo);
+	App->renderer->glState->BindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+
+	pool->format.SetupAttributes();
+
+	// Model matrix and position dequantization per draw, indexed through the baseInstance of each indirect command
+	App->renderer->glState->BindBuffer(GL_ARRAY_BUFFER, instanceVbo);
+	for (unsigned i = 0u; i < INSTANCE_ATTRIBUTE_VECTORS; ++i) {
+		glEnableVertexAttribArray(INSTANCE_FIRST_ATTRIBUTE + i);
+		glVertexAttribPointer(INSTANCE_FIRST_ATTRIBUTE + i, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(sizeof(math::float4) * i));
+		glVertexAttribDivisor(INSTANCE_FIRST_ATTRIBUTE + i, 1);
+	}
+
+	// Unbind so later element buffer binds do not land in this VAO
+	App->renderer->glState->BindVertexArray(0);
+}
+
+void GeometryArena::DefragmentVertexPool(VertexPool* pool) {
+	std::vector<ArenaMove> moves;
+	pool->allocator.Defragment(moves);
+
+	std::map<unsigned, unsigned> relocations;
+	for (std::vector<ArenaMove>::const_iterator it = moves.begin(); it != moves.end(); ++it) {
+		relocations[it->from] = it->to;
+	}
+
+	if (gpuBuffers) {
+		unsigned newVbo = 0u;
+		glGenBuffers(1, &newVbo);
+		App->renderer->glState->BindBuffer(GL_COPY_WRITE_BUFFER, newVbo);
+		glBufferData(GL_COPY_WRITE_BUFFER, pool->allocator.Capacity(), nullptr, GL_STATIC_DRAW);
+		App->renderer->glState->BindBuffer(GL_COPY_READ_BUFFER, pool->vbo);
+
+		for (std::vector<ArenaMove>::const_iterator it = moves.begin(); it != moves.end(); ++it) {
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, it->from, it->to, it->size);
+		}
+
+		App->renderer->glState->DeleteBuffer(pool->vbo);
+		pool->vbo = newVbo;
+		SetupVao(pool);
+	}
+
+	for (std::vector<ArenaAllocation>::iterator it = allocations.begin(); it != allocations.end(); ++it) {
+		if (it->used && it->vertexFormat == pool->vertexFormat) {
+			it->vertexBlock.offset = relocations[it->vertexBlock.offset];
+			it->baseVertex = it->vertexBlock.offset / pool->stride;
+		}
+	}
+}
+
+void GeometryArena::DefragmentIndexBuffer() {
+	std::vector<ArenaMove> moves;
+	indexAllocator.Defragment(moves);
+
+	std::map<unsigned, unsigned> relocations;
+	for (std::vector<ArenaMove>::const_iterator it = moves.begin(); it != moves.end(); ++it) {
+		relocations[it->from] = it->to;
+	}
+
+	if (gpuBuffers) {
+		unsigned newIbo = 0u;
+		glGenBuffers(1, &newIbo);
+		App->renderer->glState->BindBuffer(GL_COPY_WRITE_BUFFER, newIbo);
+		glBufferData(GL_COPY_WRITE_BUFFER, indexAllocator.Capacity(), nullptr, GL_STATIC_DRAW);
+		App->renderer->glState->BindBuffer(GL_COPY_READ_BUFFER, ibo);
+
+		for (std::vector<ArenaMove>::const_iterator it = moves.begin(); it != moves.end(); ++it) {
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, it->from, it->to, it->size);
+		}
+
+		App->renderer->glState->DeleteBuffer(ibo);
+		ibo = newIbo;
+
+		for (std::vector<VertexPool*>::iterator it = pools.begin(); it != pools.end(); ++it) {
+			SetupVao(*it);
+		}
+	}
+
+	for (std::vector<ArenaAllocation>::iterator it = allocations.begin(); it != allocations.end(); ++it) {
+		if (it->used) {
+			it->indexBlock.offset = relocations[it->indexBlock.offset];
+			it->firstIndex = it->indexBlock.offset / it->indexSize;
+		}
+	}
+}
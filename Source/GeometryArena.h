@@ -0,0 +1,74 @@
+#ifndef __GEOMETRYARENA_H__
+#define __GEOMETRYARENA_H__
+
+#include <map>
+#include <vector>
+#include "VertexFormat.h"
+#include "ArenaAllocator.h"
+
+struct Mesh;
+
+struct ArenaAllocation {
+	bool		used = false;
+	unsigned	references = 0u; // meshes loaded from the same content share the allocation
+	unsigned long long	contentHash = 0u;
+	unsigned	vertexFormat = 0u; // VertexFormat::Key()
+	ArenaBlock	vertexBlock;
+	ArenaBlock	indexBlock;
+	int			baseVertex = 0;
+	unsigned	indexSize = sizeof(unsigned);
+	unsigned	firstIndex = 0u; // in indices of indexSize bytes
+	unsigned	indicesNumber = 0u;
+};
+
+struct VertexPool {
+	unsigned		vertexFormat = 0u;
+	VertexFormat	format;
+	unsigned		stride = 0u;
+	unsigned		vbo = 0u;
+	unsigned		vao = 0u;
+	ArenaAllocator	allocator;
+};
+
+// Large shared vertex/index buffers, meshes are suballocated and every vertex format owns one VAO.
+// 16 and 32 bit indices share the index buffer, each allocation is aligned to its own index size.
+class GeometryArena
+{
+	public:
+		GeometryArena();
+		~GeometryArena();
+
+		void					Init(bool gpuBuffers);
+		void					CleanUp();
+
+		unsigned				Allocate(const Mesh& mesh);
+		void					Free(unsigned handle);
+		const ArenaAllocation*	GetAllocation(unsigned handle) const;
+		unsigned				GetVao(unsigned vertexFormat) const;
+		bool					NeedsDefragment() const;
+		void					Defragment();
+		void					DrawGUI();
+
+	public:
+		unsigned				instanceVbo = 0u;
+		unsigned				ibo = 0u;
+
+	private:
+		VertexPool*				GetPool(unsigned vertexFormat);
+		// False when the buffer cannot grow any more, the allocator is left as it was
+		bool					GrowVertexPool(VertexPool* pool, unsigned neededSize);
+		bool					GrowIndexBuffer(unsigned neededSize);
+		void					SetupVao(VertexPool* pool) const;
+		void					DefragmentVertexPool(VertexPool* pool);
+		void					DefragmentIndexBuffer();
+
+	private:
+		std::vector<VertexPool*>		pools;
+		std::vector<ArenaAllocation>	allocations;
+		std::vector<unsigned>			freeHandles;
+		std::map<unsigned long long, unsigned>	contentHandles; // content hash -> handle
+		ArenaAllocator					indexAllocator;
+		bool							gpuBuffers = true; // false keeps only the CPU bookkeeping, for headless runs
+};
+
+#endif
@@ -0,0 +1,137 @@
+#include "Globals.h"
+#include "JobSystem.h"
+
+JobSystem::JobSystem() { }
+
+JobSystem::~JobSystem() {
+	CleanUp();
+}
+
+void JobSystem::Init(unsigned workersNumber) {
+	if (workersNumber == 0u) {
+		// Main thread also runs jobs while it waits, keep one core for it
+		unsigned cores = std::thread::hardware_concurrency();
+		workersNumber = cores > 1u ? cores - 1u : 1u;
+	}
+
+	// One worker is always left for the frame, even while imports are running
+	backgroundLimit = workersNumber > 1u ? workersNumber - 1u : 1u;
+
+	running = true;
+	for (unsigned i = 0u; i < workersNumber; ++i) {
+		workers.push_back(std::thread(&JobSystem::WorkerLoop, this));
+	}
+
+	LOG("Job system started with %u workers", workersNumber);
+}
+
+void JobSystem::CleanUp() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		running = false;
+	}
+	condition.notify_all();
+
+	for (std::vector<std::thread>::iterator it = workers.begin(); it != workers.end(); ++it) {
+		if (it->joinable()) {
+			it->join();
+		}
+	}
+	workers.clear();
+}
+
+void JobSystem::Submit(const std::function<void()>& function, JobCounter& counter, JobPriority priority) {
+	Job job;
+	job.function = function;
+	job.counter = &counter;
+
+	++counter.pending;
+
+	if (workers.empty()) {
+		Run(job);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (priority == JobPriority::BACKGROUND) {
+			backgroundJobs.push_back(job);
+		} else {
+			jobs.push_back(job);
+		}
+	}
+	condition.notify_one();
+}
+
+void JobSystem::Wait(JobCounter& counter, JobPriority priority) {
+	while (counter.pending > 0u) {
+		if (!RunPendingJob(priority == JobPriority::BACKGROUND)) {
+			std::this_thread::yield();
+		}
+	}
+}
+
+unsigned JobSystem::WorkersNumber() const {
+	return workers.size();
+}
+
+void JobSystem::WorkerLoop() {
+	while (true) {
+		Job job;
+		bool background = false;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			condition.wait(lock, [this]() {
+				return !running || !jobs.empty() || (!backgroundJobs.empty() && runningBackground < backgroundLimit);
+			});
+
+			if (!jobs.empty()) {
+				job = jobs.front();
+				jobs.pop_front();
+			} else if (!backgroundJobs.empty()) {
+				// Past the limit only while stopping, the queue is drained before the workers leave
+				job = backgroundJobs.front();
+				backgroundJobs.pop_front();
+				background = true;
+				++runningBackground;
+			} else {
+				return;
+			}
+		}
+
+		Run(job);
+
+		if (background) {
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				--runningBackground;
+			}
+			condition.notify_one();
+		}
+	}
+}
+
+bool JobSystem::RunPendingJob(bool background) {
+	Job job;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!jobs.empty()) {
+			job = jobs.front();
+			jobs.pop_front();
+		} else if (background && !backgroundJobs.empty()) {
+			job = backgroundJobs.front();
+			backgroundJobs.pop_front();
+		} else {
+			return false;
+		}
+	}
+
+	Run(job);
+
+	return true;
+}
+
+void JobSystem::Run(Job& job) {
+	job.function();
+	--job.counter->pending;
+}
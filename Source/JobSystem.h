@@ -0,0 +1,60 @@
+#ifndef __JOBSYSTEM_H__
+#define __JOBSYSTEM_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Counts the jobs of a batch still running, Wait() on it to join them
+struct JobCounter {
+	std::atomic<unsigned> pending;
+
+	JobCounter() : pending(0u) { }
+};
+
+// Frame jobs are always taken first, background jobs (imports, streaming) never hold every worker
+enum class JobPriority { FRAME, BACKGROUND };
+
+// Fixed pool of worker threads shared by the whole engine, so the workers never outnumber the cores
+class JobSystem
+{
+	public:
+		JobSystem();
+		~JobSystem();
+
+		void		Init(unsigned workersNumber = 0u);
+		void		CleanUp();
+
+		void		Submit(const std::function<void()>& function, JobCounter& counter, JobPriority priority = JobPriority::FRAME);
+
+		// Runs pending frame jobs while it waits, background waiters also run background jobs
+		void		Wait(JobCounter& counter, JobPriority priority = JobPriority::FRAME);
+
+		unsigned	WorkersNumber() const;
+
+	private:
+		struct Job {
+			std::function<void()>	function;
+			JobCounter*				counter = nullptr;
+		};
+
+		void		WorkerLoop();
+		bool		RunPendingJob(bool background);
+		void		Run(Job& job);
+
+	private:
+		std::vector<std::thread>	workers;
+		std::deque<Job>				jobs;
+		std::deque<Job>				backgroundJobs;
+		unsigned					runningBackground = 0u;
+		unsigned					backgroundLimit = 0u;
+		std::mutex					mutex;
+		std::condition_variable		condition;
+		bool						running = false;
+};
+
+#endif
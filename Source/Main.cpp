@@ -1,8 +1,14 @@
 #include <stdlib.h>
+#include <string.h>
 #include "Application.h"
 #include "ModuleRender.h"
+#include "ModuleFileSystem.h"
 #include "Timer.h"
 #include "Globals.h"
+#include "MappedFile.h"
+#include "MeshFile.h"
+#include "ContentStore.h"
+#include "DdsFile.h"
 
 #include "SDL.h"
 #pragma comment( lib, "./Source/SDL/libx86/SDL2.lib" )
@@ -18,7 +24,118 @@ enum main_states {
 
 Application* App = NULL;
 
+// Engine.exe -validatemesh file.head ... checks cooked meshes without starting the engine
+static int ValidateMeshFiles(int argc, char** argv, int first) {
+	int result = EXIT_SUCCESS;
+
+	for (int i = first; i < argc; ++i) {
+		MappedFile file;
+		MeshFile meshFile;
+		std::string error;
+
+		// Library entries only point to the content store, validate what they point to
+		unsigned long long contentHash = 0u;
+		if (file.Open(argv[i]) && ContentStore::ReadReference(file.data, file.size, contentHash)) {
+			std::string contentPath(argv[i]);
+			size_t folderEnd = contentPath.find_last_of("/\\");
+			contentPath.erase(folderEnd == std::string::npos ? 0u : folderEnd + 1u);
+
+			char contentName[32];
+			sprintf_s(contentName, 32, "%016llx", contentHash);
+			contentPath.append("../Content/");
+			contentPath.append(contentName);
+			contentPath.append(MESH_CONTENT_EXTENSION);
+
+			printf("     %s points to %s\n", argv[i], contentPath.c_str());
+			file.Close();
+			file.Open(contentPath.c_str());
+		}
+
+		if (file.data == nullptr) {
+			error = "cannot be mapped";
+		} else if (!meshFile.Parse(file.data, file.size)) {
+			error = "not a mesh container of this version, legacy files are converted on load";
+		} else if (meshFile.Validate(true, &error)) {
+			printf("OK   %s: version %u, %u bytes\n", argv[i], meshFile.header.version, file.size);
+			for (unsigned j = 0u; j < meshFile.sections.size(); ++j) {
+				const MeshFileSection& section = meshFile.sections[j];
+				printf("     %-9s #%u offset %u size %u elements %u\n", MeshFile::SectionTypeName(section.type), section.index, section.offset, section.size, section.elementsNumber);
+			}
+		}
+
+		if (!error.empty()) {
+			printf("FAIL %s: %s\n", argv[i], error.c_str());
+			result = EXIT_FAILURE;
+		}
+	}
+
+	return result;
+}
+
+// Engine.exe -validatetextures checks every cooked texture of the library without starting the engine
+static int ValidateTextureFiles() {
+	std::string error;
+	if (!DdsFile::ValidateFormats(&error)) {
+		printf("FAIL %s\n", error.c_str());
+		return EXIT_FAILURE;
+	}
+
+	ModuleFileSystem fileSystem;
+	fileSystem.Init();
+
+	std::vector<std::string> files;
+	fileSystem.GetFilesFromDirectory("/Library/Textures/", files);
+
+	if (files.empty()) {
+		printf("FAIL /Library/Textures/: no textures found\n");
+		fileSystem.CleanUp();
+		return EXIT_FAILURE;
+	}
+
+	int result = EXIT_SUCCESS;
+	for (std::vector<std::string>::const_iterator it = files.begin(); it != files.end(); ++it) {
+		std::string path("/Library/Textures/");
+		path.append(*it);
+
+		char* buffer = nullptr;
+		unsigned size = fileSystem.Load(path.c_str(), &buffer);
+
+		// Library entries only point to the content store, validate what they point to
+		unsigned long long contentHash = 0u;
+		if (ContentStore::ReadReference(buffer, size, contentHash)) {
+			std::string contentPath = ContentStore::GetPath(contentHash, ".dds");
+			printf("     %s points to %s\n", path.c_str(), contentPath.c_str());
+
+			delete[] buffer;
+			buffer = nullptr;
+			size = fileSystem.Load(contentPath.c_str(), &buffer);
+		}
+
+		if (DdsFile::Validate(buffer, size, &error)) {
+			printf("OK   %s: %u bytes\n", path.c_str(), size);
+		} else {
+			printf("FAIL %s: %s\n", path.c_str(), error.c_str());
+			result = EXIT_FAILURE;
+		}
+
+		delete[] buffer;
+	}
+
+	printf("%u textures checked\n", files.size());
+	fileSystem.CleanUp();
+
+	return result;
+}
+
 int main(int argc, char** argv){
+	if (argc > 2 && strcmp(argv[1], "-validatemesh") == 0) {
+		return ValidateMeshFiles(argc, argv, 2);
+	}
+
+	if (argc > 1 && strcmp(argv[1], "-validatetextures") == 0) {
+		return ValidateTextureFiles();
+	}
+
 	int main_return = EXIT_FAILURE;
 	main_states state = MAIN_CREATION;
 
@@ -30,6 +147,15 @@ int main(int argc, char** argv){
 			{
 				LOG("Application Creation --------------");
 				App = new Application();
+
+				for (int i = 1; i < argc; ++i) {
+					if (strcmp(argv[i], "-headless") == 0) {
+						App->headless = true;
+					} else if (strcmp(argv[i], "-frames") == 0 && i + 1 < argc) {
+						App->benchmarkFrames = atoi(argv[++i]);
+					}
+				}
+
 				state = MAIN_START;
 				break;
 			}
@@ -0,0 +1,100 @@
+#include "Globals.h"
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile() { }
+
+MappedFile::~MappedFile() {
+	Close();
+}
+
+bool MappedFile::Open(const char* realPath) {
+	Close();
+
+#ifdef _WIN32
+	file = CreateFileA(realPath, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		file = nullptr;
+		LOG("Error: File %s cannot be opened for mapping", realPath);
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0 || fileSize.HighPart != 0) {
+		Close();
+		return false;
+	}
+
+	mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr) {
+		LOG("Error: File %s cannot be mapped", realPath);
+		Close();
+		return false;
+	}
+
+	data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	size = fileSize.LowPart;
+#else
+	descriptor = open(realPath, O_RDONLY);
+	if (descriptor < 0) {
+		LOG("Error: File %s cannot be opened for mapping", realPath);
+		return false;
+	}
+
+	struct stat fileStat;
+	if (fstat(descriptor, &fileStat) != 0 || fileStat.st_size == 0) {
+		Close();
+		return false;
+	}
+
+	void* view = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+	data = (view != MAP_FAILED) ? (const char*)view : nullptr;
+	size = (unsigned)fileStat.st_size;
+#endif
+
+	if (data == nullptr) {
+		LOG("Error: File %s cannot be mapped", realPath);
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void MappedFile::Close() {
+#ifdef _WIN32
+	if (data != nullptr) {
+		UnmapViewOfFile(data);
+	}
+
+	if (mapping != nullptr) {
+		CloseHandle(mapping);
+		mapping = nullptr;
+	}
+
+	if (file != nullptr) {
+		CloseHandle(file);
+		file = nullptr;
+	}
+#else
+	if (data != nullptr) {
+		munmap((void*)data, size);
+	}
+
+	if (descriptor >= 0) {
+		close(descriptor);
+		descriptor = -1;
+	}
+#endif
+
+	data = nullptr;
+	size = 0u;
+}
@@ -0,0 +1,27 @@
+#ifndef __MAPPEDFILE_H__
+#define __MAPPEDFILE_H__
+
+// Read only view of a whole file through the OS page cache, nothing is copied until touched
+class MappedFile
+{
+	public:
+		MappedFile();
+		~MappedFile();
+
+		bool		Open(const char* realPath);
+		void		Close();
+
+	public:
+		const char*	data = nullptr;
+		unsigned	size = 0u;
+
+	private:
+#ifdef _WIN32
+		void*		file = nullptr;
+		void*		mapping = nullptr;
+#else
+		int			descriptor = -1;
+#endif
+};
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef __MATERIAL_H__
+#define __MATERIAL_H__
+
+#include "Math/float4.h"
+
+// Plain values, so sorting and merging render queues needs no GL or image library
+struct Material {
+	unsigned		occlusionMap = 0u;
+	float			ambientK = 0.5f;
+	int				ambientWidth = 0;
+	int				ambientHeight = 0;
+
+	unsigned		diffuseMap = 0u;
+	math::float4	diffuseColor = math::float4(1.0f, 1.0f, 1.0f, 1.0f);
+	float			diffuseK = 1.0f;
+	int				diffuseWidth = 0;
+	int				diffuseHeight = 0;
+
+	unsigned		specularMap = 0u;
+	math::float4	specularColor = math::float4(1.0f, 1.0f, 1.0f, 1.0f);
+	float			specularK = 0.6f;
+	float			shininess = 64.0f;
+	int				specularWidth = 0;
+	int				specularHeight = 0;
+
+	unsigned		emissiveMap = 0u;
+	math::float4	emissiveColor = math::float4(0.0f, 0.0f, 0.0f, 0.0f);
+	int				emissiveWidth = 0;
+	int				emissiveHeight = 0;
+
+	math::float4	color = math::float4::one;
+};
+
+#endif
@@ -3,9 +3,9 @@
 #include "Globals.h"
 #include "Application.h"
 #include "ModuleFileSystem.h"
-
-#include "DevIL/include/IL/il.h"
-#include "DevIL/include/IL/ilut.h"	
+#include "ContentStore.h"
+#include "TextureCooker.h"
+#include "DdsFile.h"
 
 bool MaterialImporter::Import(const char* path)
 {
@@ -14,40 +14,44 @@ bool MaterialImporter::Import(const char* path)
 	char* fileBuffer = nullptr;
 	unsigned lenghBuffer = App->fileSystem->Load(path, &fileBuffer);
 
-	if (fileBuffer) {
-		ILuint ImageName;
-		ilGenImages(1, &ImageName);
-		ilBindImage(ImageName);
-
-		if (ilLoadL(IL_TYPE_UNKNOWN, (const void*)fileBuffer, lenghBuffer)) {
-
-			ilEnable(IL_FILE_OVERWRITE);
-			ILuint   size;
-			ILubyte *data;
-			ilSetInteger(IL_DXTC_FORMAT, IL_DXT5);
-			size = ilSaveL(IL_DDS, NULL, 0);
-
-			if (size > 0) {
-				data = new ILubyte[size];
-				if (ilSaveL(IL_DDS, data, size) > 0) {
-					std::string fileName;
-					std::string fileExtension;
-					App->fileSystem->SplitFilePath(path, nullptr, &fileName, &fileExtension);
-
-					fileName.insert(0, "/Library/Textures/");
-					fileName.append(".dds");
-
-					result = App->fileSystem->Save(fileName.c_str(), data, size, false);
-				}
+	std::string fileName;
+	std::string fileExtension;
+	App->fileSystem->SplitFilePath(path, nullptr, &fileName, &fileExtension);
+
+	// Decoded, resized and compressed on the calling thread, import jobs cook several textures at once
+	TextureImage image;
+	if (fileBuffer && TextureCooker::Decode(fileBuffer, lenghBuffer, fileExtension.c_str(), image)) {
+		TextureCooker::FitToMaxSize(image, TEXTURE_MAX_SIZE);
+
+		// The whole chain is cooked here, loading a texture never generates mips
+		std::vector<TextureImage> mips;
+		TextureCooker::GenerateMips(image, mips);
+
+		// Stored bottom up so every level uploads as it is, blocks of odd sized levels could not be flipped when loading
+		std::vector<DdsLevel> levels(mips.size() + 1u);
+		TextureCooker::FlipVertical(image);
+		TextureCooker::CompressBC3(image, levels[0]);
+		for (unsigned i = 0u; i < mips.size(); ++i) {
+			TextureCooker::FlipVertical(mips[i]);
+			TextureCooker::CompressBC3(mips[i], levels[i + 1u]);
+		}
 
-				delete[] data;
-				data = nullptr;
-			}
+		char* data = nullptr;
+		unsigned size = DdsFile::Write(DDS_FOURCC('D', 'X', 'T', '5'), levels, true, &data);
+		if (size > 0u) {
+			fileName.insert(0, "/Library/Textures/");
+			fileName.append(".dds");
 
-			ilDeleteImages(1, &ImageName);
+			result = ContentStore::Store(fileName.c_str(), data, size, ".dds");
 		}
+
+		delete[] data;
+		data = nullptr;
 	}
 
+	delete[] fileBuffer;
+	fileBuffer = nullptr;
+
 	if (result == false) {
 		LOG("Error: Cannot load texture from buffer %s", path);
 	}
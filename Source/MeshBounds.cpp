@@ -0,0 +1,142 @@
+#include "Globals.h"
+#include "MeshBounds.h"
+#include <math.h>
+
+#define SPHERE_REFINE_ITERATIONS 8u
+#define SPHERE_REFINE_SHRINK 0.95f
+#define SPHERE_REFINE_STRIDE 7919u // prime, visits the points in a different order than the first pass
+#define EIGEN_JACOBI_SWEEPS 16u
+
+math::Sphere MeshBounds::EnclosingSphere(const math::float3* positions, unsigned positionsNumber) {
+	if (positionsNumber == 0u) {
+		return math::Sphere(math::float3::zero, 0.0f);
+	}
+
+	math::Sphere sphere = math::Sphere::FastEnclosingSphere(positions, positionsNumber);
+
+	// Every shrunk sphere grows back to hold all the points, the smallest one wins
+	math::Sphere candidate = sphere;
+	unsigned stride = (positionsNumber % SPHERE_REFINE_STRIDE != 0u) ? SPHERE_REFINE_STRIDE : 1u;
+	for (unsigned i = 0u; i < SPHERE_REFINE_ITERATIONS; ++i) {
+		candidate.r *= SPHERE_REFINE_SHRINK;
+
+		unsigned point = i;
+		for (unsigned j = 0u; j < positionsNumber; ++j) {
+			point = (point + stride) % positionsNumber;
+			candidate.Enclose(positions[point]);
+		}
+
+		if (candidate.r < sphere.r) {
+			sphere = candidate;
+		}
+	}
+
+	return sphere;
+}
+
+math::OBB MeshBounds::EnclosingObb(const math::float3* positions, unsigned positionsNumber, const math::AABB& bbox) {
+	math::OBB aligned(bbox);
+	if (positionsNumber < 3u) {
+		return aligned;
+	}
+
+	math::float3 mean = math::float3::zero;
+	for (unsigned i = 0u; i < positionsNumber; ++i) {
+		mean += positions[i];
+	}
+	mean /= (float)positionsNumber;
+
+	float covariance[3][3] = {};
+	for (unsigned i = 0u; i < positionsNumber; ++i) {
+		math::float3 offset = positions[i] - mean;
+		for (unsigned row = 0u; row < 3u; ++row) {
+			for (unsigned column = row; column < 3u; ++column) {
+				covariance[row][column] += offset[row] * offset[column];
+			}
+		}
+	}
+	covariance[1][0] = covariance[0][1];
+	covariance[2][0] = covariance[0][2];
+	covariance[2][1] = covariance[1][2];
+
+	math::float3 axes[3];
+	Eigenvectors(covariance, axes);
+
+	math::float3 minimum = math::float3::inf;
+	math::float3 maximum = -math::float3::inf;
+	for (unsigned i = 0u; i < positionsNumber; ++i) {
+		math::float3 projected(positions[i].Dot(axes[0]), positions[i].Dot(axes[1]), positions[i].Dot(axes[2]));
+		minimum = minimum.Min(projected);
+		maximum = maximum.Max(projected);
+	}
+
+	math::OBB obb;
+	obb.r = (maximum - minimum) * 0.5f;
+	math::float3 center = (minimum + maximum) * 0.5f;
+	obb.pos = axes[0] * center.x + axes[1] * center.y + axes[2] * center.z;
+	for (unsigned i = 0u; i < 3u; ++i) {
+		obb.axis[i] = axes[i];
+	}
+
+	// Boxy meshes already aligned to the axes are tighter as they are
+	return (obb.Volume() < aligned.Volume()) ? obb : aligned;
+}
+
+void MeshBounds::Eigenvectors(float matrix[3][3], math::float3 axes[3]) {
+	axes[0] = math::float3::unitX;
+	axes[1] = math::float3::unitY;
+	axes[2] = math::float3::unitZ;
+
+	// Cyclic Jacobi rotations, each one zeroes an off diagonal element and the rotations accumulate in the axes
+	for (unsigned sweep = 0u; sweep < EIGEN_JACOBI_SWEEPS; ++sweep) {
+		float offDiagonal = fabsf(matrix[0][1]) + fabsf(matrix[0][2]) + fabsf(matrix[1][2]);
+		if (offDiagonal <= 1e-9f * (fabsf(matrix[0][0]) + fabsf(matrix[1][1]) + fabsf(matrix[2][2]))) {
+			break;
+		}
+
+		for (unsigned p = 0u; p < 2u; ++p) {
+			for (unsigned q = p + 1u; q < 3u; ++q) {
+				if (matrix[p][q] == 0.0f) {
+					continue;
+				}
+
+				float theta = (matrix[q][q] - matrix[p][p]) / (2.0f * matrix[p][q]);
+				float t = ((theta >= 0.0f) ? 1.0f : -1.0f) / (fabsf(theta) + sqrtf(theta * theta + 1.0f));
+				float c = 1.0f / sqrtf(t * t + 1.0f);
+				float s = t * c;
+
+				for (unsigned k = 0u; k < 3u; ++k) {
+					float kp = matrix[k][p];
+					float kq = matrix[k][q];
+					matrix[k][p] = c * kp - s * kq;
+					matrix[k][q] = s * kp + c * kq;
+				}
+				for (unsigned k = 0u; k < 3u; ++k) {
+					float pk = matrix[p][k];
+					float qk = matrix[q][k];
+					matrix[p][k] = c * pk - s * qk;
+					matrix[q][k] = s * pk + c * qk;
+				}
+				for (unsigned k = 0u; k < 3u; ++k) {
+					float axisP = axes[k][p];
+					float axisQ = axes[k][q];
+					axes[k][p] = c * axisP - s * axisQ;
+					axes[k][q] = s * axisP + c * axisQ;
+				}
+			}
+		}
+	}
+
+	// Rows were rotated as a matrix, the eigenvectors are its columns
+	math::float3 columns[3];
+	for (unsigned i = 0u; i < 3u; ++i) {
+		columns[i] = math::float3(axes[0][i], axes[1][i], axes[2][i]).Normalized();
+	}
+
+	// Right handed, an OBB with a mirrored basis still encloses but keeps the transforms simple
+	columns[2] = columns[0].Cross(columns[1]).Normalized();
+	columns[1] = columns[2].Cross(columns[0]);
+	for (unsigned i = 0u; i < 3u; ++i) {
+		axes[i] = columns[i];
+	}
+}
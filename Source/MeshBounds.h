@@ -0,0 +1,24 @@
+#ifndef __MESHBOUNDS_H__
+#define __MESHBOUNDS_H__
+
+#include "Math/float3.h"
+#include "Geometry/AABB.h"
+#include "Geometry/OBB.h"
+#include "Geometry/Sphere.h"
+
+// Bounding volumes cooked with a mesh, so loading never scans its vertices
+class MeshBounds
+{
+	public:
+		// Ritter's sphere shrunk and grown again a few times, close to the minimal one
+		static math::Sphere	EnclosingSphere(const math::float3* positions, unsigned positionsNumber);
+
+		// Box along the principal axes of the vertices, or the axis aligned one when that is smaller
+		static math::OBB	EnclosingObb(const math::float3* positions, unsigned positionsNumber, const math::AABB& bbox);
+
+	private:
+		// Columns of axes receive the eigenvectors of the symmetric matrix
+		static void			Eigenvectors(float matrix[3][3], math::float3 axes[3]);
+};
+
+#endif
@@ -0,0 +1,346 @@
+#include "Globals.h"
+#include "MeshBvh.h"
+#include "ModuleTextures.h"
+#include <algorithm>
+#include <assert.h>
+#include <float.h>
+#include <math.h>
+
+#define MESH_BVH_BINS 16u
+
+// Binary levels, the deepest MESH_BVH_MEDIAN_DEPTH of them split at the median so 4 << 24 triangles still end in small leaves
+#define MESH_BVH_MAX_DEPTH 64u
+#define MESH_BVH_MEDIAN_DEPTH 24u
+
+// A wide node is never deeper than the binary node it comes from, and each one leaves at most three siblings on the stack
+#define MESH_BVH_STACK_SIZE (MESH_BVH_MAX_DEPTH * (MESH_BVH_WIDTH - 1u) + 1u)
+
+struct BinaryNode {
+	math::AABB	box;
+	unsigned	left = 0u;
+	unsigned	right = 0u;
+	unsigned	first = 0u;
+	unsigned	count = 0u; // triangles of a leaf, 0 for inner nodes
+	unsigned	depth = 0u;
+};
+
+struct BvhBin {
+	math::AABB	box;
+	unsigned	count = 0u;
+};
+
+static float SurfaceArea(const math::AABB& box) {
+	math::float3 size = box.Size();
+	return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+static void Grow(math::AABB& box, const math::AABB& added) {
+	box.minPoint = box.minPoint.Min(added.minPoint);
+	box.maxPoint = box.maxPoint.Max(added.maxPoint);
+}
+
+// Collapses the binary subtree under binaryIndex in a wide node, returns its index
+static unsigned Collapse(const std::vector<BinaryNode>& binary, unsigned binaryIndex, std::vector<MeshBvhNode>& nodes) {
+	unsigned nodeIndex = nodes.size();
+	nodes.push_back(MeshBvhNode());
+
+	std::vector<unsigned> children;
+	const BinaryNode& root = binary[binaryIndex];
+	if (root.count > 0u) {
+		children.push_back(binaryIndex);
+	} else {
+		children.push_back(root.left);
+		children.push_back(root.right);
+	}
+
+	// The biggest inner child opens first, it is the one most rays would enter
+	while (children.size() < MESH_BVH_WIDTH) {
+		unsigned opened = MESH_BVH_EMPTY;
+		float openedArea = -1.0f;
+		for (unsigned i = 0u; i < children.size(); ++i) {
+			const BinaryNode& child = binary[children[i]];
+			if (child.count == 0u && SurfaceArea(child.box) > openedArea) {
+				opened = i;
+				openedArea = SurfaceArea(child.box);
+			}
+		}
+
+		if (opened == MESH_BVH_EMPTY) {
+			break;
+		}
+
+		unsigned inner = children[opened];
+		children[opened] = binary[inner].left;
+		children.push_back(binary[inner].right);
+	}
+
+	unsigned childNodes[MESH_BVH_WIDTH];
+	for (unsigned i = 0u; i < MESH_BVH_WIDTH; ++i) {
+		childNodes[i] = MESH_BVH_EMPTY;
+		if (i < children.size() && binary[children[i]].count == 0u) {
+			childNodes[i] = Collapse(binary, children[i], nodes);
+		}
+	}
+
+	// Filled last, the recursion may have moved the nodes
+	MeshBvhNode& node = nodes[nodeIndex];
+	for (unsigned i = 0u; i < MESH_BVH_WIDTH; ++i) {
+		if (i >= children.size()) {
+			node.minX[i] = node.minY[i] = node.minZ[i] = FLT_MAX;
+			node.maxX[i] = node.maxY[i] = node.maxZ[i] = -FLT_MAX;
+			node.children[i] = MESH_BVH_EMPTY;
+			node.trianglesNumber[i] = 0u;
+			continue;
+		}
+
+		const BinaryNode& child = binary[children[i]];
+		node.minX[i] = child.box.minPoint.x;
+		node.minY[i] = child.box.minPoint.y;
+		node.minZ[i] = child.box.minPoint.z;
+		node.maxX[i] = child.box.maxPoint.x;
+		node.maxY[i] = child.box.maxPoint.y;
+		node.maxZ[i] = child.box.maxPoint.z;
+		node.children[i] = (child.count > 0u) ? child.first : childNodes[i];
+		node.trianglesNumber[i] = child.count;
+	}
+
+	return nodeIndex;
+}
+
+void MeshBvh::Build(const Mesh& mesh, const unsigned* indices, unsigned indicesNumber, std::vector<MeshBvhNode>& nodes, std::vector<unsigned>& triangles) {
+	nodes.clear();
+	triangles.clear();
+
+	unsigned trianglesNumber = indicesNumber / 3u;
+	if (trianglesNumber == 0u) {
+		return;
+	}
+
+	std::vector<math::AABB> boxes(trianglesNumber);
+	std::vector<math::float3> centroids(trianglesNumber);
+	triangles.resize(trianglesNumber);
+	for (unsigned i = 0u; i < trianglesNumber; ++i) {
+		boxes[i].SetNegativeInfinity();
+		boxes[i].Enclose(mesh.GetPosition(indices[i * 3u]));
+		boxes[i].Enclose(mesh.GetPosition(indices[i * 3u + 1u]));
+		boxes[i].Enclose(mesh.GetPosition(indices[i * 3u + 2u]));
+		centroids[i] = boxes[i].CenterPoint();
+		triangles[i] = i;
+	}
+
+	std::vector<BinaryNode> binary;
+	binary.reserve(trianglesNumber * 2u);
+	binary.push_back(BinaryNode());
+	binary[0].count = trianglesNumber;
+
+	std::vector<unsigned> pending(1u, 0u);
+	while (!pending.empty()) {
+		unsigned nodeIndex = pending.back();
+		pending.pop_back();
+
+		BinaryNode node = binary[nodeIndex];
+		node.box.SetNegativeInfinity();
+		math::AABB centroidBox;
+		centroidBox.SetNegativeInfinity();
+		for (unsigned i = node.first; i < node.first + node.count; ++i) {
+			Grow(node.box, boxes[triangles[i]]);
+			centroidBox.Enclose(centroids[triangles[i]]);
+		}
+		binary[nodeIndex].box = node.box;
+
+		// Only more than 4 << 24 triangles fill the last level, such leaves are slow but still correct
+		if (node.count <= MESH_BVH_LEAF_TRIANGLES || node.depth == MESH_BVH_MAX_DEPTH) {
+			continue;
+		}
+
+		// Binned SAH over the centroids on every axis, the cost of a split is area times triangles of both sides
+		math::float3 extent = centroidBox.Size();
+		bool median = node.depth >= MESH_BVH_MAX_DEPTH - MESH_BVH_MEDIAN_DEPTH;
+		unsigned bestAxis = 0u;
+		unsigned bestBin = 0u;
+		float bestCost = FLT_MAX;
+		for (unsigned axis = 0u; axis < 3u && !median; ++axis) {
+			if (extent[axis] <= 0.0f) {
+				continue;
+			}
+
+			BvhBin bins[MESH_BVH_BINS];
+			for (unsigned i = 0u; i < MESH_BVH_BINS; ++i) {
+				bins[i].box.SetNegativeInfinity();
+			}
+
+			float binScale = (float)MESH_BVH_BINS / extent[axis];
+			for (unsigned i = node.first; i < node.first + node.count; ++i) {
+				unsigned bin = MIN((unsigned)((centroids[triangles[i]][axis] - centroidBox.minPoint[axis]) * binScale), MESH_BVH_BINS - 1u);
+				++bins[bin].count;
+				Grow(bins[bin].box, boxes[triangles[i]]);
+			}
+
+			float rightCosts[MESH_BVH_BINS];
+			math::AABB rightBox;
+			rightBox.SetNegativeInfinity();
+			unsigned rightCount = 0u;
+			for (unsigned i = MESH_BVH_BINS - 1u; i > 0u; --i) {
+				Grow(rightBox, bins[i].box);
+				rightCount += bins[i].count;
+				rightCosts[i] = rightCount > 0u ? SurfaceArea(rightBox) * rightCount : 0.0f;
+			}
+
+			math::AABB leftBox;
+			leftBox.SetNegativeInfinity();
+			unsigned leftCount = 0u;
+			for (unsigned i = 1u; i < MESH_BVH_BINS; ++i) {
+				Grow(leftBox, bins[i - 1u].box);
+				leftCount += bins[i - 1u].count;
+				float cost = (leftCount > 0u ? SurfaceArea(leftBox) * leftCount : 0.0f) + rightCosts[i];
+				if (leftCount > 0u && leftCount < node.count && cost < bestCost) {
+					bestCost = cost;
+					bestAxis = axis;
+					bestBin = i;
+				}
+			}
+		}
+
+		unsigned* first = &triangles[node.first];
+		unsigned* last = first + node.count;
+		unsigned* middle = nullptr;
+		if (median) {
+			// Halves the triangles along the longest axis, the depth left is enough for any mesh that fits the limit
+			unsigned axis = (extent.x >= extent.y && extent.x >= extent.z) ? 0u : (extent.y >= extent.z ? 1u : 2u);
+			middle = first + node.count / 2u;
+			std::nth_element(first, middle, last, [&](unsigned a, unsigned b) { return centroids[a][axis] < centroids[b][axis]; });
+		} else if (bestCost < FLT_MAX) {
+			float binScale = (float)MESH_BVH_BINS / extent[bestAxis];
+			float minimum = centroidBox.minPoint[bestAxis];
+			middle = std::partition(first, last, [&](unsigned triangle) {
+				return MIN((unsigned)((centroids[triangle][bestAxis] - minimum) * binScale), MESH_BVH_BINS - 1u) < bestBin;
+			});
+		} else {
+			// Every centroid in the same spot, any half is as good
+			middle = first + node.count / 2u;
+		}
+
+		BinaryNode left;
+		left.first = node.first;
+		left.count = middle - first;
+		left.depth = node.depth + 1u;
+		BinaryNode right;
+		right.first = node.first + left.count;
+		right.count = node.count - left.count;
+		right.depth = node.depth + 1u;
+
+		binary[nodeIndex].count = 0u;
+		binary[nodeIndex].left = binary.size();
+		binary.push_back(left);
+		binary[nodeIndex].right = binary.size();
+		binary.push_back(right);
+
+		pending.push_back(binary[nodeIndex].left);
+		pending.push_back(binary[nodeIndex].right);
+	}
+
+	Collapse(binary, 0u, nodes);
+}
+
+// Möller-Trumbore, two sided like the picking always was
+static bool IntersectTriangle(const math::float3& origin, const math::float3& direction, const math::float3& a, const math::float3& b, const math::float3& c, float& t) {
+	math::float3 edge1 = b - a;
+	math::float3 edge2 = c - a;
+	math::float3 p = direction.Cross(edge2);
+	float determinant = edge1.Dot(p);
+	if (determinant == 0.0f) {
+		return false;
+	}
+
+	float inverse = 1.0f / determinant;
+	math::float3 s = origin - a;
+	float u = s.Dot(p) * inverse;
+	if (u < 0.0f || u > 1.0f) {
+		return false;
+	}
+
+	math::float3 q = s.Cross(edge1);
+	float v = direction.Dot(q) * inverse;
+	if (v < 0.0f || u + v > 1.0f) {
+		return false;
+	}
+
+	t = edge2.Dot(q) * inverse;
+	return true;
+}
+
+// Zero components become a tiny value of the same sign, an infinite inverse gives NaN slabs when the ray starts on a box plane
+static float SafeInverse(float value) {
+	return 1.0f / ((fabsf(value) > 1e-20f) ? value : copysignf(1e-20f, value));
+}
+
+bool MeshBvh::Intersect(const Mesh& mesh, const math::float3& origin, const math::float3& direction, float& distance) {
+	if (mesh.bvhNodesNumber == 0u) {
+		return false;
+	}
+
+	math::float3 inverseDirection(SafeInverse(direction.x), SafeInverse(direction.y), SafeInverse(direction.z));
+	unsigned firstIndex = mesh.GetLod(0u).firstIndex;
+	bool hit = false;
+
+	unsigned stack[MESH_BVH_STACK_SIZE];
+	unsigned stackSize = 0u;
+	stack[stackSize++] = 0u;
+
+	while (stackSize > 0u) {
+		const MeshBvhNode& node = mesh.bvhNodes[stack[--stackSize]];
+
+		// Slab test of the four boxes, the entered ones are sorted near to far
+		unsigned entered[MESH_BVH_WIDTH];
+		float entries[MESH_BVH_WIDTH];
+		unsigned enteredNumber = 0u;
+		for (unsigned i = 0u; i < MESH_BVH_WIDTH; ++i) {
+			float x0 = (node.minX[i] - origin.x) * inverseDirection.x, x1 = (node.maxX[i] - origin.x) * inverseDirection.x;
+			float y0 = (node.minY[i] - origin.y) * inverseDirection.y, y1 = (node.maxY[i] - origin.y) * inverseDirection.y;
+			float z0 = (node.minZ[i] - origin.z) * inverseDirection.z, z1 = (node.maxZ[i] - origin.z) * inverseDirection.z;
+			float entry = MAX(MAX(MIN(x0, x1), MIN(y0, y1)), MAX(MIN(z0, z1), 0.0f));
+			float exit = MIN(MIN(MAX(x0, x1), MAX(y0, y1)), MIN(MAX(z0, z1), distance));
+			if (node.children[i] == MESH_BVH_EMPTY || entry > exit) {
+				continue;
+			}
+
+			unsigned slot = enteredNumber++;
+			while (slot > 0u && entries[slot - 1u] > entry) {
+				entered[slot] = entered[slot - 1u];
+				entries[slot] = entries[slot - 1u];
+				--slot;
+			}
+			entered[slot] = i;
+			entries[slot] = entry;
+		}
+
+		// Inner children are pushed far first so the nearest is popped next
+		for (unsigned j = enteredNumber; j > 0u; --j) {
+			unsigned i = entered[j - 1u];
+			if (node.trianglesNumber[i] == 0u) {
+				// Cooked trees are depth limited, only a file cooked before the limit can get here full
+				assert(stackSize < MESH_BVH_STACK_SIZE);
+				if (stackSize < MESH_BVH_STACK_SIZE) {
+					stack[stackSize++] = node.children[i];
+				}
+				continue;
+			}
+
+			for (unsigned k = node.children[i]; k < node.children[i] + node.trianglesNumber[i]; ++k) {
+				unsigned index = firstIndex + mesh.bvhTriangles[k] * 3u;
+				unsigned baseVertex = mesh.GetBaseVertex(index);
+
+				float t = 0.0f;
+				math::float3 a = mesh.GetPosition(baseVertex + mesh.GetIndex(index));
+				math::float3 b = mesh.GetPosition(baseVertex + mesh.GetIndex(index + 1u));
+				math::float3 c = mesh.GetPosition(baseVertex + mesh.GetIndex(index + 2u));
+				if (IntersectTriangle(origin, direction, a, b, c, t) && t >= 0.0f && t < distance) {
+					distance = t;
+					hit = true;
+				}
+			}
+		}
+	}
+
+	return hit;
+}
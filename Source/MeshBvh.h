@@ -0,0 +1,38 @@
+#ifndef __MESHBVH_H__
+#define __MESHBVH_H__
+
+#include <vector>
+#include "Math/float3.h"
+
+struct Mesh;
+
+#define MESH_BVH_WIDTH 4u
+#define MESH_BVH_LEAF_TRIANGLES 4u
+#define MESH_BVH_EMPTY 0xFFFFFFFFu
+
+// Four child boxes side by side so a ray tests them together. A child with a triangles count is a leaf
+// holding that many entries of the triangle list from children[i], otherwise children[i] is a node or empty.
+struct MeshBvhNode {
+	float		minX[MESH_BVH_WIDTH];
+	float		minY[MESH_BVH_WIDTH];
+	float		minZ[MESH_BVH_WIDTH];
+	float		maxX[MESH_BVH_WIDTH];
+	float		maxY[MESH_BVH_WIDTH];
+	float		maxZ[MESH_BVH_WIDTH];
+	unsigned	children[MESH_BVH_WIDTH];
+	unsigned	trianglesNumber[MESH_BVH_WIDTH];
+};
+
+// Bounding volume hierarchy over the triangles of the full level, in mesh space, for picking.
+// Built as a binary tree splitting on the binned surface area heuristic, then collapsed to four wide nodes.
+class MeshBvh
+{
+	public:
+		// triangles receives, for every leaf entry, the triangle number relative to indices
+		static void	Build(const Mesh& mesh, const unsigned* indices, unsigned indicesNumber, std::vector<MeshBvhNode>& nodes, std::vector<unsigned>& triangles);
+
+		// Closest hit of origin + t * direction with t in [0, distance), distance is updated to it
+		static bool	Intersect(const Mesh& mesh, const math::float3& origin, const math::float3& direction, float& distance);
+};
+
+#endif
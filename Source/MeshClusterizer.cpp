@@ -0,0 +1,209 @@
+#include "Globals.h"
+#include "MeshClusterizer.h"
+#include "ModuleTextures.h"
+#include <limits.h>
+#include <math.h>
+
+void MeshClusterizer::Build(const Mesh& mesh, unsigned* indices, unsigned indicesNumber, std::vector<MeshCluster>& clusters) {
+	clusters.clear();
+
+	unsigned trianglesNumber = indicesNumber / 3u;
+	unsigned verticesNumber = mesh.verticesNumber;
+	if (trianglesNumber == 0u) {
+		return;
+	}
+
+	// Vertex -> triangles adjacency packed in a single array
+	std::vector<unsigned> adjacencyOffsets(verticesNumber + 1u, 0u);
+	for (unsigned i = 0u; i < trianglesNumber * 3u; ++i) {
+		++adjacencyOffsets[indices[i] + 1u];
+	}
+	for (unsigned i = 0u; i < verticesNumber; ++i) {
+		adjacencyOffsets[i + 1u] += adjacencyOffsets[i];
+	}
+
+	std::vector<unsigned> adjacency(trianglesNumber * 3u);
+	std::vector<unsigned> cursor(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (unsigned i = 0u; i < trianglesNumber * 3u; ++i) {
+		adjacency[cursor[indices[i]]++] = i / 3u;
+	}
+
+	std::vector<math::float3> centroids(trianglesNumber);
+	for (unsigned i = 0u; i < trianglesNumber; ++i) {
+		centroids[i] = (mesh.GetPosition(indices[i * 3u]) + mesh.GetPosition(indices[i * 3u + 1u]) + mesh.GetPosition(indices[i * 3u + 2u])) / 3.0f;
+	}
+
+	// Unused triangles around every vertex, low counts are on the border of what is left
+	std::vector<unsigned> liveTriangles(verticesNumber);
+	for (unsigned i = 0u; i < verticesNumber; ++i) {
+		liveTriangles[i] = adjacencyOffsets[i + 1u] - adjacencyOffsets[i];
+	}
+
+	std::vector<unsigned> order;
+	order.reserve(trianglesNumber);
+	std::vector<bool> used(trianglesNumber, false);
+	std::vector<bool> candidate(trianglesNumber, false);
+	std::vector<unsigned> vertexCluster(verticesNumber, UINT_MAX);
+	std::vector<unsigned> candidates;
+
+	unsigned firstUnused = 0u;
+	unsigned seed = UINT_MAX;
+	while (order.size() < trianglesNumber) {
+		if (seed == UINT_MAX) {
+			while (used[firstUnused]) {
+				++firstUnused;
+			}
+			seed = firstUnused;
+		}
+
+		MeshCluster cluster;
+		cluster.firstIndex = order.size() * 3u;
+		unsigned clusterId = clusters.size();
+		unsigned clusterVertices = 0u;
+		unsigned clusterTriangles = 0u;
+		math::float3 centroidSum = math::float3::zero;
+		unsigned next = seed;
+
+		while (next != UINT_MAX) {
+			used[next] = true;
+			order.push_back(next);
+			++clusterTriangles;
+			centroidSum += centroids[next];
+
+			for (unsigned j = 0u; j < 3u; ++j) {
+				unsigned vertex = indices[next * 3u + j];
+				--liveTriangles[vertex];
+				if (vertexCluster[vertex] != clusterId) {
+					vertexCluster[vertex] = clusterId;
+					++clusterVertices;
+				}
+
+				for (unsigned k = adjacencyOffsets[vertex]; k < adjacencyOffsets[vertex + 1u]; ++k) {
+					unsigned neighbour = adjacency[k];
+					if (!used[neighbour] && !candidate[neighbour]) {
+						candidate[neighbour] = true;
+						candidates.push_back(neighbour);
+					}
+				}
+			}
+
+			next = UINT_MAX;
+			if (clusterTriangles == MESH_CLUSTER_MAX_TRIANGLES) {
+				break;
+			}
+
+			math::float3 center = centroidSum / (float)clusterTriangles;
+			unsigned bestNewVertices = 4u;
+			unsigned bestLive = UINT_MAX;
+			float bestDistance = 0.0f;
+			unsigned kept = 0u;
+			for (unsigned i = 0u; i < candidates.size(); ++i) {
+				unsigned triangle = candidates[i];
+				if (used[triangle]) {
+					candidate[triangle] = false;
+					continue;
+				}
+				candidates[kept++] = triangle;
+
+				unsigned newVertices = 0u;
+				for (unsigned j = 0u; j < 3u; ++j) {
+					newVertices += (vertexCluster[indices[triangle * 3u + j]] != clusterId) ? 1u : 0u;
+				}
+
+				if (clusterVertices + newVertices > MESH_CLUSTER_MAX_VERTICES) {
+					continue;
+				}
+
+				// Grown from the least connected triangles first, the border of the cluster stays compact
+				const unsigned* corners = &indices[triangle * 3u];
+				unsigned live = liveTriangles[corners[0]] + liveTriangles[corners[1]] + liveTriangles[corners[2]];
+				float distance = centroids[triangle].DistanceSq(center);
+				if (newVertices < bestNewVertices || (newVertices == bestNewVertices && (live < bestLive || (live == bestLive && distance < bestDistance)))) {
+					next = triangle;
+					bestNewVertices = newVertices;
+					bestLive = live;
+					bestDistance = distance;
+				}
+			}
+			candidates.resize(kept);
+		}
+
+		// The next cluster starts on the border of this one from its most enclosed triangle,
+		// so the unused triangles do not end up in scattered holes
+		unsigned seedLive = UINT_MAX;
+		seed = UINT_MAX;
+		for (unsigned i = 0u; i < candidates.size(); ++i) {
+			unsigned triangle = candidates[i];
+			candidate[triangle] = false;
+
+			const unsigned* corners = &indices[triangle * 3u];
+			unsigned live = liveTriangles[corners[0]] + liveTriangles[corners[1]] + liveTriangles[corners[2]];
+			if (!used[triangle] && live < seedLive) {
+				seed = triangle;
+				seedLive = live;
+			}
+		}
+		candidates.clear();
+
+		cluster.indicesNumber = clusterTriangles * 3u;
+		clusters.push_back(cluster);
+	}
+
+	std::vector<unsigned> reordered(trianglesNumber * 3u);
+	for (unsigned i = 0u; i < trianglesNumber; ++i) {
+		reordered[i * 3u] = indices[order[i] * 3u];
+		reordered[i * 3u + 1u] = indices[order[i] * 3u + 1u];
+		reordered[i * 3u + 2u] = indices[order[i] * 3u + 2u];
+	}
+	memcpy(indices, &reordered[0], sizeof(unsigned) * reordered.size());
+
+	for (std::vector<MeshCluster>::iterator it = clusters.begin(); it != clusters.end(); ++it) {
+		ComputeBounds(mesh, indices, *it);
+	}
+}
+
+void MeshClusterizer::ComputeBounds(const Mesh& mesh, const unsigned* indices, MeshCluster& cluster) {
+	math::AABB box;
+	box.SetNegativeInfinity();
+	math::float3 normalSum = math::float3::zero;
+
+	for (unsigned i = cluster.firstIndex; i < cluster.firstIndex + cluster.indicesNumber; i += 3u) {
+		math::float3 a = mesh.GetPosition(indices[i]);
+		math::float3 b = mesh.GetPosition(indices[i + 1u]);
+		math::float3 c = mesh.GetPosition(indices[i + 2u]);
+		box.Enclose(a);
+		box.Enclose(b);
+		box.Enclose(c);
+
+		math::float3 normal = (b - a).Cross(c - a);
+		if (normal.Normalize() > 0.0f) {
+			normalSum += normal;
+		}
+	}
+
+	cluster.center = box.CenterPoint();
+	cluster.radius = 0.0f;
+	for (unsigned i = cluster.firstIndex; i < cluster.firstIndex + cluster.indicesNumber; ++i) {
+		cluster.radius = MAX(cluster.radius, mesh.GetPosition(indices[i]).Distance(cluster.center));
+	}
+
+	// Normals spread over a half space or more can face the camera from anywhere
+	cluster.coneAxis = normalSum;
+	cluster.coneCutoff = 1.0f;
+	if (cluster.coneAxis.Normalize() <= 0.0f) {
+		return;
+	}
+
+	float minDot = 1.0f;
+	for (unsigned i = cluster.firstIndex; i < cluster.firstIndex + cluster.indicesNumber; i += 3u) {
+		math::float3 a = mesh.GetPosition(indices[i]);
+		math::float3 normal = (mesh.GetPosition(indices[i + 1u]) - a).Cross(mesh.GetPosition(indices[i + 2u]) - a);
+		if (normal.Normalize() > 0.0f) {
+			minDot = MIN(minDot, normal.Dot(cluster.coneAxis));
+		}
+	}
+
+	if (minDot > 0.0f) {
+		cluster.coneCutoff = sqrtf(1.0f - minDot * minDot);
+	}
+}
@@ -0,0 +1,26 @@
+#ifndef __MESHCLUSTERIZER_H__
+#define __MESHCLUSTERIZER_H__
+
+#include <vector>
+
+struct Mesh;
+struct MeshCluster;
+
+#define MESH_CLUSTER_MAX_TRIANGLES 128u
+#define MESH_CLUSTER_MAX_VERTICES 64u
+
+// Splits a triangle list in clusters of neighbouring triangles the renderer culls on their own.
+// A cluster grows from its first triangle through the ones sharing its vertices, preferring the triangles
+// that add the fewest new vertices, then the ones with the fewest unused neighbours and then the closest ones.
+class MeshClusterizer
+{
+	public:
+		// Reorders the triangles so every cluster is a contiguous range, cluster first indices are relative to indices
+		static void	Build(const Mesh& mesh, unsigned* indices, unsigned indicesNumber, std::vector<MeshCluster>& clusters);
+
+	private:
+		// Bounding sphere of the vertices and the cone holding every triangle normal
+		static void	ComputeBounds(const Mesh& mesh, const unsigned* indices, MeshCluster& cluster);
+};
+
+#endif
@@ -0,0 +1,319 @@
+#include "MeshFile.h"
+#include "VertexFormat.h"
+#include "MeshBvh.h"
+#include <algorithm>
+#include <string.h>
+
+static unsigned AlignUp(unsigned value, unsigned alignment) {
+	return ((value + alignment - 1u) / alignment) * alignment;
+}
+
+static unsigned long long HashBytes(unsigned long long hash, const void* bytes, unsigned size) {
+	const unsigned char* cursor = (const unsigned char*)bytes;
+	for (unsigned i = 0u; i < size; ++i) {
+		hash ^= cursor[i];
+		hash *= 1099511628211ull;
+	}
+
+	return hash;
+}
+
+static bool Fail(std::string* error, const char* reason) {
+	if (error != nullptr) {
+		*error = reason;
+	}
+
+	return false;
+}
+
+MeshFile::MeshFile() { }
+
+MeshFile::~MeshFile() { }
+
+void MeshFile::AddSection(MeshSectionType type, unsigned index, const void* payload, unsigned size, unsigned elementsNumber, unsigned elementSize, unsigned format) {
+	MeshFileSection section;
+	section.type = type;
+	section.index = index;
+	section.size = size;
+	section.elementsNumber = elementsNumber;
+	section.elementSize = elementSize;
+	section.format = format;
+
+	sections.push_back(section);
+	payloads.push_back(payload);
+}
+
+unsigned MeshFile::Serialize(char** buffer) {
+	header = MeshFileHeader();
+	header.sectionsNumber = sections.size();
+
+	unsigned cursor = AlignUp(sizeof(MeshFileHeader) + sizeof(MeshFileSection) * sections.size(), MESH_SECTION_ALIGNMENT);
+	for (unsigned i = 0u; i < sections.size(); ++i) {
+		sections[i].offset = cursor;
+		cursor = AlignUp(cursor + sections[i].size, MESH_SECTION_ALIGNMENT);
+	}
+
+	header.contentHash = HashPayloads();
+
+	// Zeroed so the alignment padding is deterministic
+	*buffer = new char[cursor];
+	memset(*buffer, 0, cursor);
+
+	memcpy(*buffer, &header, sizeof(MeshFileHeader));
+	if (!sections.empty()) {
+		memcpy(*buffer + sizeof(MeshFileHeader), &sections[0], sizeof(MeshFileSection) * sections.size());
+	}
+
+	for (unsigned i = 0u; i < sections.size(); ++i) {
+		if (sections[i].size > 0u) {
+			memcpy(*buffer + sections[i].offset, payloads[i], sections[i].size);
+		}
+	}
+
+	payloads.clear();
+	data = *buffer;
+	size = cursor;
+
+	return cursor;
+}
+
+bool MeshFile::Parse(const char* buffer, unsigned bufferSize) {
+	data = nullptr;
+	size = 0u;
+	sections.clear();
+	payloads.clear();
+
+	if (buffer == nullptr || bufferSize < sizeof(MeshFileHeader)) {
+		return false;
+	}
+
+	memcpy(&header, buffer, sizeof(MeshFileHeader));
+	if (header.magic != MESH_FILE_MAGIC || header.version != MESH_FILE_VERSION) {
+		return false;
+	}
+
+	unsigned long long tableEnd = sizeof(MeshFileHeader) + (unsigned long long)sizeof(MeshFileSection) * header.sectionsNumber;
+	if (tableEnd > bufferSize) {
+		return false;
+	}
+
+	sections.resize(header.sectionsNumber);
+	if (header.sectionsNumber > 0u) {
+		memcpy(&sections[0], buffer + sizeof(MeshFileHeader), sizeof(MeshFileSection) * header.sectionsNumber);
+	}
+
+	data = buffer;
+	size = bufferSize;
+
+	return true;
+}
+
+bool MeshFile::Validate(bool checkHash, std::string* error) const {
+	if (data == nullptr) {
+		return Fail(error, "bad header or section table");
+	}
+
+	unsigned tableEnd = sizeof(MeshFileHeader) + sizeof(MeshFileSection) * sections.size();
+
+	std::vector<const MeshFileSection*> sorted;
+	for (unsigned i = 0u; i < sections.size(); ++i) {
+		const MeshFileSection& section = sections[i];
+
+		if (section.type == 0u || section.type >= SECTION_TYPE_COUNT) {
+			return Fail(error, "unknown section type");
+		}
+
+		if (section.offset % MESH_SECTION_ALIGNMENT != 0u || section.offset < tableEnd || (unsigned long long)section.offset + section.size > size) {
+			return Fail(error, "section out of the file or misaligned");
+		}
+
+		if (section.elementSize > 0u && (unsigned long long)section.elementsNumber * section.elementSize != section.size) {
+			return Fail(error, "section size does not match its elements");
+		}
+
+		sorted.push_back(&section);
+	}
+
+	std::sort(sorted.begin(), sorted.end(), [](const MeshFileSection* a, const MeshFileSection* b) { return a->offset < b->offset; });
+	for (unsigned i = 1u; i < sorted.size(); ++i) {
+		if (sorted[i - 1]->offset + sorted[i - 1]->size > sorted[i]->offset) {
+			return Fail(error, "sections overlap");
+		}
+	}
+
+	const MeshFileSection* vertices = FindSection(SECTION_VERTICES);
+	const MeshFileSection* indices = FindSection(SECTION_INDICES);
+	const MeshFileSection* bounds = FindSection(SECTION_BOUNDS);
+	const MeshFileSection* lods = FindSection(SECTION_LOD);
+	const MeshFileSection* submeshes = FindSection(SECTION_SUBMESH);
+	const MeshFileSection* clusters = FindSection(SECTION_CLUSTER);
+	const MeshFileSection* bvhNodes = FindSection(SECTION_BVH, 0u);
+	const MeshFileSection* bvhTriangles = FindSection(SECTION_BVH, 1u);
+	const MeshFileSection* volumes = FindSection(SECTION_VOLUMES);
+
+	if (vertices == nullptr || indices == nullptr) {
+		return Fail(error, "missing vertices or indices");
+	}
+
+	VertexFormat format;
+	if (!format.FromKey(vertices->format) || !format.Has(ATTRIBUTE_POSITION) || format.stride != vertices->elementSize) {
+		return Fail(error, "vertex format does not match the stride");
+	}
+
+	if ((indices->elementSize != sizeof(unsigned) && indices->elementSize != sizeof(unsigned short)) || indices->elementsNumber % 3u != 0u) {
+		return Fail(error, "indices are not whole triangles");
+	}
+
+	if (bounds != nullptr && bounds->size != sizeof(float) * 6u) {
+		return Fail(error, "bounds section has a wrong size");
+	}
+
+	if (volumes != nullptr && volumes->size != sizeof(float) * MESH_VOLUMES_FLOATS) {
+		return Fail(error, "volumes section has a wrong size");
+	}
+
+	if (bounds == nullptr && format.attributes[ATTRIBUTE_POSITION].normalized) {
+		return Fail(error, "quantized positions without bounds to dequantize them");
+	}
+
+	if (lods != nullptr) {
+		if (lods->elementSize != sizeof(unsigned) * 2u) {
+			return Fail(error, "lod table has a wrong element size");
+		}
+
+		const unsigned* levels = (const unsigned*)GetSectionData(*lods);
+		for (unsigned i = 0u; i < lods->elementsNumber; ++i) {
+			unsigned firstIndex = levels[i * 2u];
+			unsigned indicesNumber = levels[i * 2u + 1u];
+			if (firstIndex % 3u != 0u || indicesNumber % 3u != 0u || (unsigned long long)firstIndex + indicesNumber > indices->elementsNumber) {
+				return Fail(error, "lod range out of the indices");
+			}
+		}
+	}
+
+	if (submeshes != nullptr) {
+		if (submeshes->elementSize != sizeof(unsigned) * 3u) {
+			return Fail(error, "submesh table has a wrong element size");
+		}
+
+		const unsigned* ranges = (const unsigned*)GetSectionData(*submeshes);
+		for (unsigned i = 0u; i < submeshes->elementsNumber; ++i) {
+			unsigned firstIndex = ranges[i * 3u];
+			unsigned indicesNumber = ranges[i * 3u + 1u];
+			if (firstIndex % 3u != 0u || indicesNumber % 3u != 0u || (unsigned long long)firstIndex + indicesNumber > indices->elementsNumber) {
+				return Fail(error, "submesh range out of the indices");
+			}
+
+			if (ranges[i * 3u + 2u] >= vertices->elementsNumber) {
+				return Fail(error, "submesh base vertex out of the vertices");
+			}
+		}
+	} else if (indices->elementSize == sizeof(unsigned short) && vertices->elementsNumber > MESH_MAX_SHORT_VERTICES) {
+		return Fail(error, "16 bit indices cannot address every vertex");
+	}
+
+	if (clusters != nullptr) {
+		// Index range, then center, radius, cone axis and cone cutoff as floats
+		if (clusters->elementSize != sizeof(unsigned) * 2u + sizeof(float) * 8u) {
+			return Fail(error, "cluster table has a wrong element size");
+		}
+
+		const unsigned* levels = (lods != nullptr) ? (const unsigned*)GetSectionData(*lods) : nullptr;
+		unsigned fullIndices = (levels != nullptr && lods->elementsNumber > 0u) ? levels[0] + levels[1] : indices->elementsNumber;
+		const char* table = GetSectionData(*clusters);
+		for (unsigned i = 0u; i < clusters->elementsNumber; ++i) {
+			const unsigned* range = (const unsigned*)(table + i * clusters->elementSize);
+			if (range[0] % 3u != 0u || range[1] % 3u != 0u || (unsigned long long)range[0] + range[1] > fullIndices) {
+				return Fail(error, "cluster range out of the first level");
+			}
+		}
+	}
+
+	if (bvhNodes != nullptr || bvhTriangles != nullptr) {
+		if (bvhNodes == nullptr || bvhTriangles == nullptr || bvhNodes->elementsNumber == 0u) {
+			return Fail(error, "bvh without nodes or triangles");
+		}
+
+		if (bvhNodes->elementSize != sizeof(MeshBvhNode) || bvhTriangles->elementSize != sizeof(unsigned)) {
+			return Fail(error, "bvh has a wrong element size");
+		}
+
+		// Children always come after their parent, so traversal cannot loop
+		const MeshBvhNode* nodes = (const MeshBvhNode*)GetSectionData(*bvhNodes);
+		for (unsigned i = 0u; i < bvhNodes->elementsNumber; ++i) {
+			for (unsigned j = 0u; j < MESH_BVH_WIDTH; ++j) {
+				unsigned child = nodes[i].children[j];
+				unsigned trianglesNumber = nodes[i].trianglesNumber[j];
+				if (trianglesNumber > 0u && (unsigned long long)child + trianglesNumber > bvhTriangles->elementsNumber) {
+					return Fail(error, "bvh leaf out of the triangle list");
+				}
+
+				if (trianglesNumber == 0u && child != MESH_BVH_EMPTY && (child <= i || child >= bvhNodes->elementsNumber)) {
+					return Fail(error, "bvh child out of the nodes");
+				}
+			}
+		}
+
+		const unsigned* levels = (lods != nullptr) ? (const unsigned*)GetSectionData(*lods) : nullptr;
+		unsigned fullTriangles = ((levels != nullptr && lods->elementsNumber > 0u) ? levels[1] : indices->elementsNumber) / 3u;
+		const unsigned* triangles = (const unsigned*)GetSectionData(*bvhTriangles);
+		for (unsigned i = 0u; i < bvhTriangles->elementsNumber; ++i) {
+			if (triangles[i] >= fullTriangles) {
+				return Fail(error, "bvh triangle out of the first level");
+			}
+		}
+	}
+
+	// Every index is read by the renderer and by picking, a corrupted one must never reach them
+	const char* indexData = GetSectionData(*indices);
+	const unsigned* ranges = (submeshes != nullptr) ? (const unsigned*)GetSectionData(*submeshes) : nullptr;
+	unsigned submeshesNumber = (submeshes != nullptr) ? submeshes->elementsNumber : 1u;
+	for (unsigned i = 0u; i < submeshesNumber; ++i) {
+		unsigned firstIndex = (ranges != nullptr) ? ranges[i * 3u] : 0u;
+		unsigned indicesNumber = (ranges != nullptr) ? ranges[i * 3u + 1u] : indices->elementsNumber;
+		unsigned baseVertex = (ranges != nullptr) ? ranges[i * 3u + 2u] : 0u;
+
+		for (unsigned j = firstIndex; j < firstIndex + indicesNumber; ++j) {
+			unsigned index = (indices->elementSize == sizeof(unsigned short)) ? ((const unsigned short*)indexData)[j] : ((const unsigned*)indexData)[j];
+			if ((unsigned long long)baseVertex + index >= vertices->elementsNumber) {
+				return Fail(error, "index out of the vertex range");
+			}
+		}
+	}
+
+	if (checkHash && HashPayloads() != header.contentHash) {
+		return Fail(error, "content hash mismatch");
+	}
+
+	return true;
+}
+
+const MeshFileSection* MeshFile::FindSection(MeshSectionType type, unsigned index) const {
+	for (unsigned i = 0u; i < sections.size(); ++i) {
+		if (sections[i].type == type && sections[i].index == index) {
+			return &sections[i];
+		}
+	}
+
+	return nullptr;
+}
+
+const char* MeshFile::GetSectionData(const MeshFileSection& section) const {
+	return (data != nullptr) ? data + section.offset : nullptr;
+}
+
+const char* MeshFile::SectionTypeName(unsigned type) {
+	static const char* names[SECTION_TYPE_COUNT] = { "unknown", "vertices", "indices", "bounds", "lod", "bvh", "submesh", "cluster", "volumes" };
+	return (type < SECTION_TYPE_COUNT) ? names[type] : names[0];
+}
+
+unsigned long long MeshFile::HashPayloads() const {
+	unsigned long long hash = 14695981039346656037ull;
+
+	for (unsigned i = 0u; i < sections.size(); ++i) {
+		const void* payload = (i < payloads.size()) ? payloads[i] : GetSectionData(sections[i]);
+		hash = HashBytes(hash, payload, sections[i].size);
+	}
+
+	return hash;
+}
@@ -0,0 +1,82 @@
+#ifndef __MESHFILE_H__
+#define __MESHFILE_H__
+
+#include <string>
+#include <vector>
+
+#define MESH_FILE_MAGIC 0x4853454Du // "MESH"
+#define MESH_FILE_VERSION 3u
+#define MESH_SECTION_ALIGNMENT 16u
+#define MESH_VOLUMES_FLOATS 19u
+#define MESH_MAX_SHORT_VERTICES 65536u // addressable with 16 bit indices
+#define MESH_CONTENT_EXTENSION ".mesh" // cooked files in the content store
+
+// Types are stored in files, append new ones at the end
+enum MeshSectionType {
+	SECTION_VERTICES = 1,	// elements = vertices, elementSize = stride, format = VertexFormat::Key()
+	SECTION_INDICES,		// elements = indices, elementSize = bytes per index, 2 or 4
+	SECTION_BOUNDS,			// AABB as min and max float3
+	SECTION_LOD,			// elements = levels, each a first index and an indices number into the index section
+	SECTION_BVH,			// index 0 elements = MeshBvhNode of the first level, index 1 elements = triangle list of the leaves
+	SECTION_SUBMESH,		// elements = submeshes, each a first index, an indices number and a base vertex
+	SECTION_CLUSTER,		// elements = clusters of the first level, each an index range, a bounding sphere and a normal cone
+	SECTION_VOLUMES,		// bounding sphere center and radius, then OBB center, half sizes and three axes, all floats
+	SECTION_TYPE_COUNT
+};
+
+struct MeshFileHeader {
+	unsigned			magic = MESH_FILE_MAGIC;
+	unsigned			version = MESH_FILE_VERSION;
+	unsigned			flags = 0u;
+	unsigned			sectionsNumber = 0u;
+	unsigned long long	contentHash = 0u; // FNV-1a of the section payloads in table order
+	unsigned			reserved[2] = { 0u, 0u };
+};
+
+struct MeshFileSection {
+	unsigned	type = 0u;
+	unsigned	index = 0u;
+	unsigned	offset = 0u;
+	unsigned	size = 0u;
+	unsigned	elementsNumber = 0u;
+	unsigned	elementSize = 0u;
+	unsigned	format = 0u;
+	unsigned	reserved = 0u;
+};
+
+// Cooked mesh container: header, section table and 16 byte aligned payloads.
+// Parsing only reads the header and the table, so over a mapped file every section can be used
+// in place and the pages of the sections nobody asks for are never touched.
+class MeshFile
+{
+	public:
+		MeshFile();
+		~MeshFile();
+
+		// Writing, payloads are referenced until Serialize
+		void					AddSection(MeshSectionType type, unsigned index, const void* payload, unsigned size, unsigned elementsNumber = 0u, unsigned elementSize = 0u, unsigned format = 0u);
+		unsigned				Serialize(char** buffer);
+
+		// Reading
+		bool					Parse(const char* buffer, unsigned bufferSize);
+		// Range checks always run, checkHash also hashes every payload, which reads the whole file
+		bool					Validate(bool checkHash, std::string* error) const;
+		const MeshFileSection*	FindSection(MeshSectionType type, unsigned index = 0u) const;
+		const char*				GetSectionData(const MeshFileSection& section) const;
+
+		static const char*		SectionTypeName(unsigned type);
+
+	public:
+		MeshFileHeader					header;
+		std::vector<MeshFileSection>	sections;
+
+	private:
+		unsigned long long		HashPayloads() const;
+
+	private:
+		std::vector<const void*>	payloads;
+		const char*					data = nullptr;
+		unsigned					size = 0u;
+};
+
+#endif
@@ -2,30 +2,71 @@
 #include "Application.h"
 #include "ModuleTextures.h"
 #include "ModuleFileSystem.h"
-
-void MeshImporter::ImportFBX(const char* filePath) {
-	bool result = false;
-
-	char* fileBuffer;
+#include "ModuleLibrary.h"
+#include "JobSystem.h"
+#include "MappedFile.h"
+#include "MeshFile.h"
+#include "ContentStore.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "MeshClusterizer.h"
+#include "MeshBvh.h"
+#include "MeshBounds.h"
+#include "Math/MathFunc.h"
+#include "rapidjson-1.1.0\include\rapidjson\document.h"
+#include <assert.h>
+#include <atomic>
+#include <limits.h>
+#include <math.h>
+
+#define MESH_LOD_MIN_TRIANGLES 64u
+
+unsigned MeshImporter::ImportFBX(const char* filePath) {
+	char* fileBuffer = nullptr;
 	unsigned lenghBuffer = App->fileSystem->Load(filePath, &fileBuffer);
+	if (fileBuffer == nullptr || lenghBuffer == 0u) {
+		LOG("Error: FBX %s cannot be read", filePath);
+		delete[] fileBuffer;
+		return 0u;
+	}
+
 	const aiScene* scene = aiImportFileFromMemory(fileBuffer, lenghBuffer, aiProcessPreset_TargetRealtime_MaxQuality, "");
 
+	delete[] fileBuffer;
+	fileBuffer = nullptr;
+
 	std::string fileName;
 	App->fileSystem->SplitFilePath(filePath, nullptr, &fileName, nullptr);
 
+	MeshImportOptions options = LoadImportOptions(filePath);
+	std::atomic<unsigned> savedMeshes(0u);
+
 	if (scene != nullptr && scene->mMeshes != nullptr) {
-		for (int i = 0; i < scene->mNumMeshes; i++) {
+		App->library->meshesToImport += scene->mNumMeshes;
+
+		// The scene is only read by the jobs, each one writes its own mesh file
+		JobCounter counter;
+		for (unsigned i = 0u; i < scene->mNumMeshes; ++i) {
 			std::string meshName = fileName;
 			meshName.append("_" + std::to_string(i));
-			Import(scene->mMeshes[i], meshName.c_str());
+
+			const aiMesh* sceneMesh = scene->mMeshes[i];
+			App->jobs->Submit([sceneMesh, meshName, &options, &savedMeshes]() {
+				if (Import(sceneMesh, meshName.c_str(), options)) {
+					++savedMeshes;
+				}
+				++App->library->importedMeshes;
+			}, counter, JobPriority::BACKGROUND);
 		}
+		App->jobs->Wait(counter, JobPriority::BACKGROUND);
 	}
 
-	delete[] fileBuffer;
-	fileBuffer = nullptr;
+	aiReleaseImport(scene);
+
+	return savedMeshes;
 }
 
-bool MeshImporter::Import(const aiMesh* aiMesh, const char* meshName) {
+bool MeshImporter::Import(const aiMesh* aiMesh, const char* meshName, const MeshImportOptions& options) {
 	bool result = false;
 
 	if (aiMesh == nullptr) {
@@ -35,43 +76,102 @@ bool MeshImporter::Import(const aiMesh* aiMesh, const char* meshName) {
 
 	Mesh meshStruct;
 
-	meshStruct.verticesNumber = aiMesh->mNumVertices;
-	meshStruct.vertices = new float[meshStruct.verticesNumber * 3];
-	memcpy(meshStruct.vertices, aiMesh->mVertices, sizeof(float) * meshStruct.verticesNumber * 3);
+	float* uvs = nullptr;
+	if (aiMesh->HasTextureCoords(0)) {
+		uvs = new float[aiMesh->mNumVertices * 2];
+		for (unsigned i = 0u; i < aiMesh->mNumVertices; i++) {
+			uvs[i * 2] = aiMesh->mTextureCoords[0][i].x;
+			uvs[i * 2 + 1] = aiMesh->mTextureCoords[0][i].y;
+		}
+	}
+
+	const float* normals = aiMesh->HasNormals() ? (const float*)aiMesh->mNormals : nullptr;
+	Cook(&meshStruct, aiMesh->mNumVertices, (const float*)aiMesh->mVertices, normals, uvs, options);
+
+	if (options.quantize) {
+		LogQuantizationError(meshStruct, meshName, (const float*)aiMesh->mVertices, normals, uvs);
+	}
+
+	delete[] uvs;
+	uvs = nullptr;
 
 	if (aiMesh->HasFaces()) {
 		meshStruct.indicesNumber = aiMesh->mNumFaces * 3;
-		meshStruct.indices = new unsigned[meshStruct.indicesNumber];
+		unsigned* indices = new unsigned[meshStruct.indicesNumber];
 		for (unsigned i = 0u; i < aiMesh->mNumFaces; ++i) {
-			memcpy(&meshStruct.indices[i * 3], aiMesh->mFaces[i].mIndices, 3 * sizeof(unsigned));
+			memcpy(&indices[i * 3], aiMesh->mFaces[i].mIndices, 3 * sizeof(unsigned));
 		}
+		meshStruct.indices = indices;
 	}
 
-	if (aiMesh->HasTextureCoords(0)) {
-		meshStruct.uvs = new float[meshStruct.verticesNumber * 2];
-		int uvsCount = 0;
-		for (unsigned i = 0u; i < meshStruct.verticesNumber; i++) {
-			meshStruct.uvs[uvsCount] = aiMesh->mTextureCoords[0][i].x;
-			uvsCount++;
-			meshStruct.uvs[uvsCount] = aiMesh->mTextureCoords[0][i].y;
-			uvsCount++;
-		}
+	VertexCacheStatistics before;
+	if (options.optimize) {
+		before = Optimize(&meshStruct, options);
+	}
+
+	GenerateLods(&meshStruct, meshName, options);
+	BuildClusters(&meshStruct, meshName, options);
+
+	if (options.optimize) {
+		LogOptimization(meshStruct, meshName, before);
 	}
+	BuildBvh(&meshStruct, meshName, options);
 
-	if (aiMesh->HasNormals()) {
-		meshStruct.normals = new float[meshStruct.verticesNumber * 3];
-		memcpy(meshStruct.normals, aiMesh->mNormals, sizeof(float) * meshStruct.verticesNumber * 3);
+	if (options.splitLargeMeshes) {
+		SplitSubmeshes(&meshStruct, meshName);
 	}
 
-	if (aiMesh->HasVertexColors(0)) {
-		meshStruct.colors = new float[meshStruct.verticesNumber * 3];
-		memcpy(meshStruct.colors, aiMesh->mColors, sizeof(float) * meshStruct.verticesNumber * 3);
+	CompactIndices(&meshStruct);
+
+	result = Save(meshStruct, meshName);
+	CleanUpStructMesh(&meshStruct);
+
+	return result;
+}
+
+void MeshImporter::Cook(Mesh* mesh, unsigned verticesNumber, const float* positions, const float* normals, const float* uvs, const MeshImportOptions& options) {
+	assert(mesh != nullptr && positions != nullptr);
+
+	mesh->format.Clear();
+	if (options.quantize) {
+		mesh->format.AddAttribute(ATTRIBUTE_POSITION, 3, COMPONENT_UNSIGNED_SHORT, true);
+		if (normals != nullptr) {
+			mesh->format.AddAttribute(ATTRIBUTE_NORMAL, 2, (options.normalBits <= 8u) ? COMPONENT_BYTE : COMPONENT_SHORT, true);
+		}
+		if (uvs != nullptr) {
+			mesh->format.AddAttribute(ATTRIBUTE_UV, 2, COMPONENT_HALF);
+		}
+	} else {
+		mesh->format.AddAttribute(ATTRIBUTE_POSITION, 3);
+		if (normals != nullptr) {
+			mesh->format.AddAttribute(ATTRIBUTE_NORMAL, 3);
+		}
+		if (uvs != nullptr) {
+			mesh->format.AddAttribute(ATTRIBUTE_UV, 2);
+		}
 	}
 
-	meshStruct.bbox.SetNegativeInfinity();
-	meshStruct.bbox.Enclose((math::float3*)aiMesh->mVertices, aiMesh->mNumVertices);
+	mesh->verticesNumber = verticesNumber;
+	mesh->bbox.SetNegativeInfinity();
+	mesh->bbox.Enclose((const math::float3*)positions, verticesNumber);
+	mesh->bsphere = MeshBounds::EnclosingSphere((const math::float3*)positions, verticesNumber);
+	mesh->obb = MeshBounds::EnclosingObb((const math::float3*)positions, verticesNumber, mesh->bbox);
+	SetPositionDequantize(mesh);
+
+	mesh->vertexData = new char[mesh->format.stride * verticesNumber];
+	for (unsigned i = 0u; i < verticesNumber; ++i) {
+		char* vertex = mesh->vertexData + i * mesh->format.stride;
+		math::float3 position = (math::float3(&positions[i * 3]) - mesh->positionOffset).Div(mesh->positionScale);
+		mesh->format.WriteAttribute(vertex, ATTRIBUTE_POSITION, position.ptr());
+
+		if (normals != nullptr) {
+			mesh->format.WriteAttribute(vertex, ATTRIBUTE_NORMAL, &normals[i * 3]);
+		}
 
-	return Save(meshStruct, meshName);
+		if (uvs != nullptr) {
+			mesh->format.WriteAttribute(vertex, ATTRIBUTE_UV, &uvs[i * 2]);
+		}
+	}
 }
 
 bool MeshImporter::Load(Mesh* meshStruct, const char* meshName) {
@@ -82,134 +182,238 @@ bool MeshImporter::Load(Mesh* meshStruct, const char* meshName) {
 		return result;
 	}
 
-	char* buffer;
 	std::string meshPath("/Library/Meshes/");
 	meshPath.append(meshName);
-	unsigned size = 0u;
-	size = App->fileSystem->Load(meshPath.c_str(), &buffer);
-
-	if (buffer != nullptr && size > 0) {
-		char* cursor = buffer;
-
-		// indices / vertices / uvs / normals/ colors / 
-		unsigned ranges[5];
-		unsigned bytes = sizeof(ranges);
-		memcpy(ranges, cursor, bytes);
-		cursor += bytes;
-
-		meshStruct->indicesNumber = ranges[0];
-		meshStruct->verticesNumber = ranges[1];
-
-		// indices
-		bytes = sizeof(unsigned) * meshStruct->indicesNumber;
-		meshStruct->indices = new unsigned[meshStruct->indicesNumber];
-		memcpy(meshStruct->indices, cursor, bytes);
-		cursor += bytes;
-
-		// vertices
-		bytes = sizeof(float) * meshStruct->verticesNumber * 3;
-		meshStruct->vertices = new float[meshStruct->verticesNumber * 3];
-		memcpy(meshStruct->vertices, cursor, bytes);
-		cursor += bytes;
-
-		if (ranges[2] > 0) {
-			bytes = sizeof(float)* meshStruct->verticesNumber * 2;
-			meshStruct->uvs = new float[meshStruct->verticesNumber * 2];
-			memcpy(meshStruct->uvs, cursor, bytes);
-			cursor += bytes;
-		}
 
-		if (ranges[3] > 0) {
-			bytes = sizeof(float)* meshStruct->verticesNumber * 3;
-			meshStruct->normals = new float[meshStruct->verticesNumber * 3];
-			memcpy(meshStruct->normals, cursor, bytes);
-			cursor += bytes;
-		}
+	std::string realPath;
+	MappedFile* file = new MappedFile();
+	if (!App->fileSystem->GetRealPath(meshPath.c_str(), realPath) || !file->Open(realPath.c_str())) {
+		LOG("Error: Mesh %s cannot be opened", meshName);
+		delete file;
+		return result;
+	}
 
-		if (ranges[4] > 0) {
-			bytes = sizeof(float)* meshStruct->verticesNumber * 3;
-			meshStruct->colors = new float[meshStruct->verticesNumber * 3];
-			memcpy(meshStruct->colors, cursor, bytes);
-			cursor += bytes;
+	// Cooked meshes live in the content store, the name only points to them
+	unsigned long long contentHash = 0u;
+	if (ContentStore::ReadReference(file->data, file->size, contentHash)) {
+		delete file;
+		file = new MappedFile();
+
+		std::string contentPath = ContentStore::GetPath(contentHash, MESH_CONTENT_EXTENSION);
+		if (!App->fileSystem->GetRealPath(contentPath.c_str(), realPath) || !file->Open(realPath.c_str())) {
+			LOG("Error: Mesh %s points to missing content %s", meshName, contentPath.c_str());
+			delete file;
+			return result;
 		}
+	}
 
-		delete[] cursor;
-		cursor = nullptr;
-
+	if (file->size >= sizeof(unsigned) && *(const unsigned*)file->data == MESH_FILE_MAGIC) {
+		// The mesh keeps the mapping, its data is never copied
+		result = LoadMapped(meshStruct, file);
+		meshStruct->contentHash = result ? contentHash : 0u;
+		file = result ? nullptr : file;
+	} else if (LoadLegacy(meshStruct, file->data, file->size)) {
+		// Unmapped before rewriting it cooked, next loads skip the conversion
+		delete file;
+		file = nullptr;
+
+		std::string stem(meshName);
+		stem = stem.substr(0, stem.find_last_of('.'));
+		LOG("Converting legacy mesh %s to the interleaved format", meshName);
+		MeshImportOptions options;
+		VertexCacheStatistics before = Optimize(meshStruct, options);
+		GenerateLods(meshStruct, meshName, options);
+		BuildClusters(meshStruct, meshName, options);
+		LogOptimization(*meshStruct, meshName, before);
+		BuildBvh(meshStruct, meshName, options);
+		CompactIndices(meshStruct);
+		Save(*meshStruct, stem.c_str());
 		result = true;
 	}
 
-	delete[] buffer;
-	buffer = nullptr;
+	if (!result) {
+		LOG("Error: Mesh %s is corrupted", meshName);
+		CleanUpStructMesh(meshStruct);
+	}
+
+	delete file;
+	file = nullptr;
 
 	return result;
 }
 
+bool MeshImporter::LoadMapped(Mesh* meshStruct, MappedFile* file) {
+	// Only the header and the table are read here, the sections stay in the mapping
+	MeshFile meshFile;
+	std::string error;
+	if (!meshFile.Parse(file->data, file->size) || !meshFile.Validate(false, &error)) {
+		LOG("Error: Mesh file rejected: %s", error.c_str());
+		return false;
+	}
+
+	const MeshFileSection* vertices = meshFile.FindSection(SECTION_VERTICES);
+	const MeshFileSection* indices = meshFile.FindSection(SECTION_INDICES);
+	const MeshFileSection* bounds = meshFile.FindSection(SECTION_BOUNDS);
+	const MeshFileSection* lods = meshFile.FindSection(SECTION_LOD);
+	const MeshFileSection* submeshes = meshFile.FindSection(SECTION_SUBMESH);
+	const MeshFileSection* clusters = meshFile.FindSection(SECTION_CLUSTER);
+	const MeshFileSection* bvhNodes = meshFile.FindSection(SECTION_BVH, 0u);
+	const MeshFileSection* bvhTriangles = meshFile.FindSection(SECTION_BVH, 1u);
+	const MeshFileSection* volumes = meshFile.FindSection(SECTION_VOLUMES);
+
+	meshStruct->format.FromKey(vertices->format);
+
+	// Read only pages, nothing may write through these pointers
+	meshStruct->mapping = file;
+	meshStruct->indicesNumber = indices->elementsNumber;
+	meshStruct->indexSize = indices->elementSize;
+	meshStruct->indices = (void*)meshFile.GetSectionData(*indices);
+	meshStruct->verticesNumber = vertices->elementsNumber;
+	meshStruct->vertexData = (char*)meshFile.GetSectionData(*vertices);
+
+	if (lods != nullptr) {
+		meshStruct->lodsNumber = MIN(lods->elementsNumber, MESH_MAX_LODS);
+		memcpy(meshStruct->lods, meshFile.GetSectionData(*lods), sizeof(MeshLod) * meshStruct->lodsNumber);
+	}
 
-bool MeshImporter::Save(const Mesh& mesh, const char* meshName) {
-	bool result = false;
+	if (submeshes != nullptr) {
+		meshStruct->submeshesNumber = submeshes->elementsNumber;
+		meshStruct->submeshes = (MeshSubmesh*)meshFile.GetSectionData(*submeshes);
+	}
 
-	// indices / vertices / uvs / normals/ colors / 
-	unsigned ranges[5] = {
-		mesh.indicesNumber,
-		mesh.verticesNumber,
-		(mesh.uvs) ? mesh.verticesNumber : 0u,
-		(mesh.normals) ? mesh.verticesNumber : 0u,
-		(mesh.colors) ? mesh.verticesNumber : 0u
-	};
+	if (clusters != nullptr) {
+		meshStruct->clustersNumber = clusters->elementsNumber;
+		meshStruct->clusters = (MeshCluster*)meshFile.GetSectionData(*clusters);
+	}
+
+	if (bvhNodes != nullptr && bvhTriangles != nullptr) {
+		meshStruct->bvhNodesNumber = bvhNodes->elementsNumber;
+		meshStruct->bvhNodes = (MeshBvhNode*)meshFile.GetSectionData(*bvhNodes);
+		meshStruct->bvhTrianglesNumber = bvhTriangles->elementsNumber;
+		meshStruct->bvhTriangles = (unsigned*)meshFile.GetSectionData(*bvhTriangles);
+	}
+
+	if (bounds != nullptr) {
+		const float* bbox = (const float*)meshFile.GetSectionData(*bounds);
+		meshStruct->bbox.minPoint = math::float3(bbox);
+		meshStruct->bbox.maxPoint = math::float3(bbox + 3);
+		SetPositionDequantize(meshStruct);
+	} else {
+		meshStruct->bbox.SetNegativeInfinity();
+		for (unsigned i = 0u; i < meshStruct->verticesNumber; ++i) {
+			meshStruct->bbox.Enclose(meshStruct->GetPosition(i));
+		}
+	}
 
-	unsigned size = sizeof(ranges);
-	size += sizeof(unsigned) * mesh.indicesNumber;
-	size += sizeof(float) * mesh.verticesNumber * 3;
-	if (mesh.uvs) {
-		size += sizeof(float) * mesh.verticesNumber * 2;
+	// Files cooked before the volumes get them from the box, as loose as it is
+	if (volumes != nullptr) {
+		const float* volume = (const float*)meshFile.GetSectionData(*volumes);
+		meshStruct->bsphere = math::Sphere(math::float3(volume), volume[3]);
+		meshStruct->obb.pos = math::float3(volume + 4);
+		meshStruct->obb.r = math::float3(volume + 7);
+		meshStruct->obb.axis[0] = math::float3(volume + 10);
+		meshStruct->obb.axis[1] = math::float3(volume + 13);
+		meshStruct->obb.axis[2] = math::float3(volume + 16);
+	} else {
+		meshStruct->bsphere = math::Sphere(meshStruct->bbox.CenterPoint(), meshStruct->bbox.HalfDiagonal().Length());
+		meshStruct->obb = math::OBB(meshStruct->bbox);
 	}
-	if (mesh.normals) {
-		size += sizeof(float) * mesh.verticesNumber * 3;
+
+	return true;
+}
+
+bool MeshImporter::LoadLegacy(Mesh* meshStruct, const char* buffer, unsigned size) {
+	// indices / vertices / uvs / normals/ colors / 
+	unsigned ranges[5];
+	if (size < sizeof(ranges)) {
+		return false;
 	}
-	if (mesh.colors) {
-		size += sizeof(float) * mesh.verticesNumber * 3;
+
+	memcpy(ranges, buffer, sizeof(ranges));
+	unsigned indicesNumber = ranges[0];
+	unsigned verticesNumber = ranges[1];
+
+	unsigned expected = sizeof(ranges) + sizeof(unsigned) * indicesNumber + sizeof(float) * verticesNumber * 3;
+	expected += (ranges[2] > 0) ? sizeof(float) * verticesNumber * 2 : 0u;
+	expected += (ranges[3] > 0) ? sizeof(float) * verticesNumber * 3 : 0u;
+	expected += (ranges[4] > 0) ? sizeof(float) * verticesNumber * 3 : 0u;
+	if (expected > size) {
+		return false;
 	}
 
-	char* data = new char[size];
-	char* cursor = data;
+	const char* cursor = buffer + sizeof(ranges);
 
-	unsigned bytes = sizeof(ranges);
-	memcpy(cursor, ranges, bytes);
-	cursor += bytes;
+	meshStruct->indicesNumber = indicesNumber;
+	meshStruct->indices = new unsigned[indicesNumber];
+	memcpy(meshStruct->indices, cursor, sizeof(unsigned) * indicesNumber);
+	cursor += sizeof(unsigned) * indicesNumber;
 
-	bytes = sizeof(unsigned) * mesh.indicesNumber;
-	memcpy(cursor, mesh.indices, bytes);
-	cursor += bytes;
+	const float* positions = (const float*)cursor;
+	cursor += sizeof(float) * verticesNumber * 3;
 
-	bytes = sizeof(float) * mesh.verticesNumber * 3;
-	memcpy(cursor, mesh.vertices, bytes);
-	cursor += bytes;
+	const float* uvs = nullptr;
+	if (ranges[2] > 0) {
+		uvs = (const float*)cursor;
+		cursor += sizeof(float) * verticesNumber * 2;
+	}
 
-	if (mesh.uvs != nullptr) {
-		bytes = sizeof(float)* mesh.verticesNumber * 2;
-		memcpy(cursor, mesh.uvs, bytes);
-		cursor += bytes;
+	const float* normals = nullptr;
+	if (ranges[3] > 0) {
+		normals = (const float*)cursor;
+		cursor += sizeof(float) * verticesNumber * 3;
 	}
 
-	if (mesh.normals != nullptr) {
-		bytes = sizeof(float)* mesh.verticesNumber * 3;
-		memcpy(cursor, mesh.normals, bytes);
-		cursor += bytes;
+	// Vertex colors were never fed to any shader, they are dropped
+
+	Cook(meshStruct, verticesNumber, positions, normals, uvs);
+
+	return true;
+}
+
+bool MeshImporter::Save(const Mesh& mesh, const char* meshName) {
+	bool result = false;
+
+	float bbox[6];
+	memcpy(bbox, mesh.bbox.minPoint.ptr(), sizeof(float) * 3);
+	memcpy(bbox + 3, mesh.bbox.maxPoint.ptr(), sizeof(float) * 3);
+
+	float volumes[MESH_VOLUMES_FLOATS];
+	memcpy(volumes, mesh.bsphere.pos.ptr(), sizeof(float) * 3);
+	volumes[3] = mesh.bsphere.r;
+	memcpy(volumes + 4, mesh.obb.pos.ptr(), sizeof(float) * 3);
+	memcpy(volumes + 7, mesh.obb.r.ptr(), sizeof(float) * 3);
+	for (unsigned i = 0u; i < 3u; ++i) {
+		memcpy(volumes + 10 + i * 3, mesh.obb.axis[i].ptr(), sizeof(float) * 3);
 	}
 
-	if (mesh.colors != nullptr) {
-		bytes = sizeof(float)* mesh.verticesNumber * 3;
-		memcpy(cursor, mesh.colors, bytes);
-		cursor += bytes;
+	MeshFile meshFile;
+	meshFile.AddSection(SECTION_VERTICES, 0u, mesh.vertexData, mesh.format.stride * mesh.verticesNumber, mesh.verticesNumber, mesh.format.stride, mesh.format.Key());
+	meshFile.AddSection(SECTION_INDICES, 0u, mesh.indices, mesh.indexSize * mesh.indicesNumber, mesh.indicesNumber, mesh.indexSize);
+	meshFile.AddSection(SECTION_BOUNDS, 0u, bbox, sizeof(bbox));
+	meshFile.AddSection(SECTION_VOLUMES, 0u, volumes, sizeof(volumes));
+	if (mesh.lodsNumber > 1u) {
+		meshFile.AddSection(SECTION_LOD, 0u, mesh.lods, sizeof(MeshLod) * mesh.lodsNumber, mesh.lodsNumber, sizeof(MeshLod));
+	}
+	if (mesh.submeshesNumber > 0u) {
+		meshFile.AddSection(SECTION_SUBMESH, 0u, mesh.submeshes, sizeof(MeshSubmesh) * mesh.submeshesNumber, mesh.submeshesNumber, sizeof(MeshSubmesh));
 	}
+	if (mesh.clustersNumber > 0u) {
+		meshFile.AddSection(SECTION_CLUSTER, 0u, mesh.clusters, sizeof(MeshCluster) * mesh.clustersNumber, mesh.clustersNumber, sizeof(MeshCluster));
+	}
+	if (mesh.bvhNodesNumber > 0u) {
+		meshFile.AddSection(SECTION_BVH, 0u, mesh.bvhNodes, sizeof(MeshBvhNode) * mesh.bvhNodesNumber, mesh.bvhNodesNumber, sizeof(MeshBvhNode));
+		meshFile.AddSection(SECTION_BVH, 1u, mesh.bvhTriangles, sizeof(unsigned) * mesh.bvhTrianglesNumber, mesh.bvhTrianglesNumber, sizeof(unsigned));
+	}
+
+	char* data = nullptr;
+	unsigned size = meshFile.Serialize(&data);
 
 	std::string fileToSave("/Library/Meshes/");
 
 	fileToSave.append(meshName);
 	fileToSave.append(".head");
 
-	result = App->fileSystem->Save(fileToSave.c_str(), data, size, false);
+	result = ContentStore::Store(fileToSave.c_str(), data, size, MESH_CONTENT_EXTENSION);
 
 	delete[] data;
 	data = nullptr;
@@ -219,42 +423,450 @@ bool MeshImporter::Save(const Mesh& mesh, const char* meshName) {
 
 void MeshImporter::CleanUpStructMesh(Mesh* mesh) {
 	if (mesh != nullptr) {
-		if (mesh->indices != nullptr) {
-			delete[] mesh->indices;
-			mesh->indices = nullptr;
+		if (mesh->mapping != nullptr) {
+			// Every array lives in the mapped file
+			delete mesh->mapping;
+			mesh->mapping = nullptr;
+		} else {
+			if (mesh->indexSize == sizeof(unsigned short)) {
+				delete[] (unsigned short*)mesh->indices;
+			} else {
+				delete[] (unsigned*)mesh->indices;
+			}
+			delete[] mesh->vertexData;
+			delete[] mesh->submeshes;
+			delete[] mesh->clusters;
+			delete[] mesh->bvhNodes;
+			delete[] mesh->bvhTriangles;
+		}
+
+		mesh->indices = nullptr;
+		mesh->vertexData = nullptr;
+		mesh->submeshes = nullptr;
+		mesh->clusters = nullptr;
+		mesh->bvhNodes = nullptr;
+		mesh->bvhTriangles = nullptr;
+
+		mesh->format.Clear();
+
+		mesh->arenaHandle = 0u;
+		mesh->contentHash = 0u;
+		mesh->verticesNumber = 0u;
+		mesh->indicesNumber = 0u;
+		mesh->indexSize = sizeof(unsigned);
+		mesh->lodsNumber = 0u;
+		mesh->submeshesNumber = 0u;
+		mesh->clustersNumber = 0u;
+		mesh->bvhNodesNumber = 0u;
+		mesh->bvhTrianglesNumber = 0u;
+		mesh->bbox = math::AABB();
+		mesh->bsphere = math::Sphere();
+		mesh->obb = math::OBB();
+		mesh->positionOffset = math::float3::zero;
+		mesh->positionScale = math::float3::one;
+	}
+}
+
+MeshImportOptions MeshImporter::LoadImportOptions(const char* assetPath) {
+	MeshImportOptions options;
+
+	std::string optionsPath(assetPath);
+	optionsPath.append(MESH_IMPORT_OPTIONS_EXTENSION);
+	if (!App->fileSystem->Exists(optionsPath.c_str())) {
+		return options;
+	}
+
+	char* fileBuffer = nullptr;
+	unsigned size = App->fileSystem->Load(optionsPath.c_str(), &fileBuffer);
+	std::string json(fileBuffer != nullptr ? fileBuffer : "", size);
+	delete[] fileBuffer;
+	fileBuffer = nullptr;
+
+	rapidjson::Document document;
+	if (document.Parse(json.c_str()).HasParseError() || !document.IsObject()) {
+		LOG("Error: Import options %s cannot be parsed, using the defaults", optionsPath.c_str());
+		return options;
+	}
+
+	if (document.HasMember("quantize") && document["quantize"].IsBool()) {
+		options.quantize = document["quantize"].GetBool();
+	}
+
+	if (document.HasMember("normalBits") && document["normalBits"].IsUint()) {
+		options.normalBits = document["normalBits"].GetUint();
+	}
+
+	if (document.HasMember("optimize") && document["optimize"].IsBool()) {
+		options.optimize = document["optimize"].GetBool();
+	}
+
+	if (document.HasMember("optimizeOverdraw") && document["optimizeOverdraw"].IsBool()) {
+		options.optimizeOverdraw = document["optimizeOverdraw"].GetBool();
+	}
+
+	if (document.HasMember("overdrawThreshold") && document["overdrawThreshold"].IsNumber()) {
+		options.overdrawThreshold = document["overdrawThreshold"].GetFloat();
+	}
+
+	if (document.HasMember("lodLevels") && document["lodLevels"].IsUint()) {
+		options.lodLevels = document["lodLevels"].GetUint();
+	}
+
+	if (document.HasMember("splitLargeMeshes") && document["splitLargeMeshes"].IsBool()) {
+		options.splitLargeMeshes = document["splitLargeMeshes"].GetBool();
+	}
+
+	if (document.HasMember("clusters") && document["clusters"].IsBool()) {
+		options.clusters = document["clusters"].GetBool();
+	}
+
+	if (document.HasMember("bvh") && document["bvh"].IsBool()) {
+		options.bvh = document["bvh"].GetBool();
+	}
+
+	return options;
+}
+
+VertexCacheStatistics MeshImporter::Optimize(Mesh* mesh, const MeshImportOptions& options) {
+	if (mesh->indicesNumber == 0u) {
+		return VertexCacheStatistics();
+	}
+
+	assert(mesh->indexSize == sizeof(unsigned));
+	unsigned* indices = (unsigned*)mesh->indices;
+
+	VertexCacheStatistics before = MeshOptimizer::AnalyzeVertexCache(indices, mesh->indicesNumber, mesh->verticesNumber);
+
+	std::vector<unsigned> clusters;
+	if (options.optimizeOverdraw) {
+		MeshOptimizer::OptimizeVertexCache(indices, mesh->indicesNumber, mesh->verticesNumber, &clusters);
+		MeshOptimizer::OptimizeOverdraw(*mesh, clusters, options.overdrawThreshold);
+	} else {
+		MeshOptimizer::OptimizeVertexCache(indices, mesh->indicesNumber, mesh->verticesNumber);
+	}
+
+	// Last, it renumbers the vertices the other passes refer to
+	MeshOptimizer::OptimizeVertexFetch(*mesh);
+
+	return before;
+}
+
+void MeshImporter::LogOptimization(const Mesh& mesh, const char* meshName, const VertexCacheStatistics& before) {
+	// Only the full level, the lower ones are appended after it
+	MeshLod full = mesh.GetLod(0u);
+	VertexCacheStatistics after = MeshOptimizer::AnalyzeVertexCache((const unsigned*)mesh.indices + full.firstIndex, full.indicesNumber, mesh.verticesNumber);
+	LOG("Mesh %s optimized: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f", meshName, before.acmr, after.acmr, before.atvr, after.atvr);
+}
+
+void MeshImporter::GenerateLods(Mesh* mesh, const char* meshName, const MeshImportOptions& options) {
+	unsigned levels = MIN(options.lodLevels, MESH_MAX_LODS);
+	if (levels <= 1u || mesh->indicesNumber < MESH_LOD_MIN_TRIANGLES * 3u) {
+		return;
+	}
+
+	assert(mesh->indexSize == sizeof(unsigned));
+	const unsigned* meshIndices = (const unsigned*)mesh->indices;
+	std::vector<unsigned> indices(meshIndices, meshIndices + mesh->indicesNumber);
+	std::vector<unsigned> previous(indices);
+	std::vector<unsigned> simplified;
+
+	mesh->lods[0].firstIndex = 0u;
+	mesh->lods[0].indicesNumber = mesh->indicesNumber;
+	mesh->lodsNumber = 1u;
+
+	std::string report(std::to_string(mesh->indicesNumber / 3u));
+	for (unsigned level = 1u; level < levels && previous.size() >= MESH_LOD_MIN_TRIANGLES * 3u; ++level) {
+		unsigned target = (previous.size() / 6u) * 3u;
+		float error = MeshSimplifier::Simplify(*mesh, &previous[0], previous.size(), target, simplified);
+
+		// Seams and borders are locked, a level that barely shrinks is not worth its memory
+		if (simplified.empty() || simplified.size() > previous.size() * 4u / 5u) {
+			break;
+		}
+
+		MeshOptimizer::OptimizeVertexCache(&simplified[0], simplified.size(), mesh->verticesNumber);
+
+		mesh->lods[level].firstIndex = indices.size();
+		mesh->lods[level].indicesNumber = simplified.size();
+		mesh->lodsNumber = level + 1u;
+		indices.insert(indices.end(), simplified.begin(), simplified.end());
+		previous.swap(simplified);
+
+		char levelReport[64];
+		sprintf_s(levelReport, 64, " / %u (error %.4f)", mesh->lods[level].indicesNumber / 3u, error);
+		report.append(levelReport);
+	}
+
+	if (mesh->lodsNumber > 1u) {
+		delete[] meshIndices;
+		mesh->indicesNumber = indices.size();
+		mesh->indices = new unsigned[indices.size()];
+		memcpy(mesh->indices, &indices[0], sizeof(unsigned) * indices.size());
+	}
+
+	LOG("Mesh %s levels of detail: %s triangles", meshName, report.c_str());
+}
+
+void MeshImporter::BuildClusters(Mesh* mesh, const char* meshName, const MeshImportOptions& options) {
+	// A mesh that fits in a couple of clusters is not worth culling in pieces
+	MeshLod full = mesh->GetLod(0u);
+	if (!options.clusters || full.indicesNumber <= MESH_CLUSTER_MAX_TRIANGLES * 3u * 2u) {
+		return;
+	}
+
+	static_assert(sizeof(MeshCluster) == sizeof(unsigned) * 2u + sizeof(float) * 8u, "MeshCluster is mapped from the cluster section");
+	assert(mesh->indexSize == sizeof(unsigned) && mesh->mapping == nullptr);
+
+	std::vector<MeshCluster> clusters;
+	unsigned* fullIndices = (unsigned*)mesh->indices + full.firstIndex;
+	MeshClusterizer::Build(*mesh, fullIndices, full.indicesNumber, clusters);
+
+	// Clustering throws away the optimized triangle order, it is restored inside every cluster
+	if (options.optimize) {
+		MeshOptimizer::OptimizeClusters(*mesh, fullIndices, clusters, options.optimizeOverdraw);
+		MeshOptimizer::OptimizeVertexFetch(*mesh);
+	}
+
+	unsigned coneCulled = 0u;
+	for (std::vector<MeshCluster>::iterator it = clusters.begin(); it != clusters.end(); ++it) {
+		it->firstIndex += full.firstIndex;
+		coneCulled += (it->coneCutoff < 1.0f) ? 1u : 0u;
+	}
+
+	delete[] mesh->clusters;
+	mesh->clustersNumber = clusters.size();
+	mesh->clusters = new MeshCluster[clusters.size()];
+	memcpy(mesh->clusters, &clusters[0], sizeof(MeshCluster) * clusters.size());
+
+	LOG("Mesh %s split in %u clusters of %.1f triangles, %u can be backface culled", meshName, clusters.size(), (float)full.indicesNumber / (3.0f * clusters.size()), coneCulled);
+}
+
+void MeshImporter::BuildBvh(Mesh* mesh, const char* meshName, const MeshImportOptions& options) {
+	// Submeshes keep the triangle order, so the triangle numbers stay valid after the split
+	MeshLod full = mesh->GetLod(0u);
+	if (!options.bvh || full.indicesNumber == 0u) {
+		return;
+	}
+
+	static_assert(sizeof(MeshBvhNode) == sizeof(float) * 6u * MESH_BVH_WIDTH + sizeof(unsigned) * 2u * MESH_BVH_WIDTH, "MeshBvhNode is mapped from the bvh section");
+	assert(mesh->indexSize == sizeof(unsigned) && mesh->mapping == nullptr && mesh->submeshesNumber == 0u);
+
+	std::vector<MeshBvhNode> nodes;
+	std::vector<unsigned> triangles;
+	MeshBvh::Build(*mesh, (unsigned*)mesh->indices + full.firstIndex, full.indicesNumber, nodes, triangles);
+
+	delete[] mesh->bvhNodes;
+	mesh->bvhNodesNumber = nodes.size();
+	mesh->bvhNodes = new MeshBvhNode[nodes.size()];
+	memcpy(mesh->bvhNodes, &nodes[0], sizeof(MeshBvhNode) * nodes.size());
+
+	delete[] mesh->bvhTriangles;
+	mesh->bvhTrianglesNumber = triangles.size();
+	mesh->bvhTriangles = new unsigned[triangles.size()];
+	memcpy(mesh->bvhTriangles, &triangles[0], sizeof(unsigned) * triangles.size());
+
+	LOG("Mesh %s bvh built with %u nodes over %u triangles", meshName, nodes.size(), triangles.size());
+}
+
+// Triangles keep their order, a submesh is closed when the next one would reference one vertex too many.
+// Vertices used by several submeshes are copied into each of them. When home is given, every vertex records
+// the submesh it was first copied into and its index there.
+static void CopyTriangles(const Mesh& mesh, unsigned* indices, unsigned firstIndex, unsigned lastIndex, std::vector<char>& vertexData,
+	std::vector<MeshSubmesh>& submeshes, std::vector<unsigned>& remap, std::vector<unsigned>* homeSubmesh, std::vector<unsigned>* homeIndex) {
+	unsigned stride = mesh.format.stride;
+	std::vector<unsigned> submeshVertices;
+
+	MeshSubmesh submesh;
+	submesh.firstIndex = firstIndex;
+	submesh.baseVertex = vertexData.size() / stride;
+
+	for (unsigned i = firstIndex; i <= lastIndex; i += 3u) {
+		unsigned newVertices = 0u;
+		for (unsigned j = 0u; i < lastIndex && j < 3u; ++j) {
+			unsigned vertex = indices[i + j];
+			bool repeated = (j > 0u && vertex == indices[i]) || (j > 1u && vertex == indices[i + 1u]);
+			newVertices += (remap[vertex] == UINT_MAX && !repeated) ? 1u : 0u;
 		}
 
-		if (mesh->vertices != nullptr) {
-			delete[] mesh->vertices;
-			mesh->vertices = nullptr;
+		// Closes the submesh at the end of the range too
+		if (i == lastIndex || submeshVertices.size() + newVertices > MESH_MAX_SHORT_VERTICES) {
+			submesh.indicesNumber = i - submesh.firstIndex;
+			if (submesh.indicesNumber > 0u) {
+				submeshes.push_back(submesh);
+			}
+
+			for (std::vector<unsigned>::const_iterator it = submeshVertices.begin(); it != submeshVertices.end(); ++it) {
+				if (homeSubmesh != nullptr && (*homeSubmesh)[*it] == UINT_MAX) {
+					(*homeSubmesh)[*it] = submeshes.size() - 1u;
+					(*homeIndex)[*it] = remap[*it];
+				}
+				remap[*it] = UINT_MAX;
+			}
+			submeshVertices.clear();
+
+			submesh.firstIndex = i;
+			submesh.baseVertex = vertexData.size() / stride;
+
+			if (i == lastIndex) {
+				break;
+			}
 		}
 
-		if (mesh->uvs != nullptr) {
-			delete[] mesh->uvs;
-			mesh->uvs = nullptr;
+		for (unsigned j = 0u; j < 3u; ++j) {
+			unsigned& remapped = remap[indices[i + j]];
+			if (remapped == UINT_MAX) {
+				remapped = submeshVertices.size();
+				submeshVertices.push_back(indices[i + j]);
+				vertexData.insert(vertexData.end(), mesh.vertexData + indices[i + j] * stride, mesh.vertexData + (indices[i + j] + 1u) * stride);
+			}
+			indices[i + j] = remapped;
 		}
+	}
+}
+
+void MeshImporter::SplitSubmeshes(Mesh* mesh, const char* meshName) {
+	assert(mesh->indexSize == sizeof(unsigned) && mesh->mapping == nullptr);
+
+	if (mesh->verticesNumber <= MESH_MAX_SHORT_VERTICES) {
+		return;
+	}
 
-		if (mesh->normals != nullptr) {
-			delete[] mesh->normals;
-			mesh->normals = nullptr;
+	unsigned* indices = (unsigned*)mesh->indices;
+	unsigned stride = mesh->format.stride;
+	std::vector<char> vertexData;
+	std::vector<MeshSubmesh> submeshes;
+	std::vector<unsigned> remap(mesh->verticesNumber, UINT_MAX);
+	std::vector<unsigned> homeSubmesh(mesh->verticesNumber, UINT_MAX);
+	std::vector<unsigned> homeIndex(mesh->verticesNumber, 0u);
+
+	MeshLod full = mesh->GetLod(0u);
+	CopyTriangles(*mesh, indices, full.firstIndex, full.firstIndex + full.indicesNumber, vertexData, submeshes, remap, &homeSubmesh, &homeIndex);
+	unsigned fullSubmeshes = submeshes.size();
+
+	// Lower levels draw from the copies of the full level. Their triangles are grouped by the submesh holding all
+	// three vertices, in their original order, only the ones across submeshes get copies of their own.
+	std::vector<unsigned> levelIndices;
+	std::vector<std::vector<unsigned> > homeTriangles(fullSubmeshes);
+	std::vector<unsigned> crossingTriangles;
+	for (unsigned level = 1u; level < mesh->LodsNumber(); ++level) {
+		MeshLod lod = mesh->GetLod(level);
+		levelIndices.assign(indices + lod.firstIndex, indices + lod.firstIndex + lod.indicesNumber);
+
+		for (unsigned i = 0u; i < levelIndices.size(); i += 3u) {
+			unsigned home = homeSubmesh[levelIndices[i]];
+			if (home != UINT_MAX && homeSubmesh[levelIndices[i + 1u]] == home && homeSubmesh[levelIndices[i + 2u]] == home) {
+				homeTriangles[home].push_back(i);
+			} else {
+				crossingTriangles.push_back(i);
+			}
 		}
 
-		if (mesh->colors != nullptr) {
-			delete[] mesh->colors;
-			mesh->colors = nullptr;
+		unsigned cursor = lod.firstIndex;
+		for (unsigned home = 0u; home < fullSubmeshes; ++home) {
+			if (homeTriangles[home].empty()) {
+				continue;
+			}
+
+			MeshSubmesh submesh;
+			submesh.firstIndex = cursor;
+			submesh.baseVertex = submeshes[home].baseVertex;
+			for (std::vector<unsigned>::const_iterator it = homeTriangles[home].begin(); it != homeTriangles[home].end(); ++it) {
+				for (unsigned j = 0u; j < 3u; ++j) {
+					indices[cursor++] = homeIndex[levelIndices[*it + j]];
+				}
+			}
+			submesh.indicesNumber = cursor - submesh.firstIndex;
+			submeshes.push_back(submesh);
+			homeTriangles[home].clear();
 		}
 
-		mesh->vao = 0u;
-		mesh->vbo = 0u;
-		mesh->ibo = 0u;
-		mesh->verticesNumber = 0u;
-		mesh->indicesNumber = 0u;
-		mesh->normalsOffset = 0u;
-		mesh->texturesOffset = 0u;
-		mesh->vertexSize = 0u;
-		mesh->bbox = math::AABB();
+		unsigned firstCrossing = cursor;
+		for (std::vector<unsigned>::const_iterator it = crossingTriangles.begin(); it != crossingTriangles.end(); ++it) {
+			for (unsigned j = 0u; j < 3u; ++j) {
+				indices[cursor++] = levelIndices[*it + j];
+			}
+		}
+		crossingTriangles.clear();
+		CopyTriangles(*mesh, indices, firstCrossing, cursor, vertexData, submeshes, remap, nullptr, nullptr);
+	}
+
+	unsigned splitVertices = vertexData.size() / stride;
+	if (splitVertices > mesh->verticesNumber + mesh->verticesNumber / 4u) {
+		LOG("Warning: Mesh %s split in %u submeshes for 16 bit indices grew from %u to %u vertices", meshName, submeshes.size(), mesh->verticesNumber, splitVertices);
+	} else {
+		LOG("Mesh %s split in %u submeshes for 16 bit indices, %u -> %u vertices", meshName, submeshes.size(), mesh->verticesNumber, splitVertices);
+	}
+
+	delete[] mesh->vertexData;
+	mesh->verticesNumber = splitVertices;
+	mesh->vertexData = new char[vertexData.size()];
+	memcpy(mesh->vertexData, &vertexData[0], vertexData.size());
+
+	mesh->submeshesNumber = submeshes.size();
+	mesh->submeshes = new MeshSubmesh[submeshes.size()];
+	memcpy(mesh->submeshes, &submeshes[0], sizeof(MeshSubmesh) * submeshes.size());
+}
+
+void MeshImporter::CompactIndices(Mesh* mesh) {
+	if (mesh->indexSize != sizeof(unsigned) || mesh->mapping != nullptr || mesh->indices == nullptr) {
+		return;
+	}
+
+	// Split meshes address every submesh from its base vertex, which always fits
+	if (mesh->submeshesNumber == 0u && mesh->verticesNumber > MESH_MAX_SHORT_VERTICES) {
+		return;
+	}
 
-		delete mesh;
-		mesh = nullptr;
+	const unsigned* indices = (const unsigned*)mesh->indices;
+	unsigned short* shortIndices = new unsigned short[mesh->indicesNumber];
+	for (unsigned i = 0u; i < mesh->indicesNumber; ++i) {
+		assert(indices[i] < MESH_MAX_SHORT_VERTICES);
+		shortIndices[i] = (unsigned short)indices[i];
 	}
+
+	delete[] indices;
+	mesh->indices = shortIndices;
+	mesh->indexSize = sizeof(unsigned short);
+}
+
+void MeshImporter::SetPositionDequantize(Mesh* mesh) {
+	mesh->positionOffset = math::float3::zero;
+	mesh->positionScale = math::float3::one;
+
+	if (mesh->format.attributes[ATTRIBUTE_POSITION].normalized) {
+		// A flat axis keeps scale one, every stored value is zero there anyway
+		math::float3 size = mesh->bbox.Size();
+		mesh->positionOffset = mesh->bbox.minPoint;
+		mesh->positionScale = math::float3(size.x > 0.0f ? size.x : 1.0f, size.y > 0.0f ? size.y : 1.0f, size.z > 0.0f ? size.z : 1.0f);
+	}
+}
+
+void MeshImporter::LogQuantizationError(const Mesh& mesh, const char* meshName, const float* positions, const float* normals, const float* uvs) {
+	float positionError = 0.0f;
+	float normalError = 0.0f;
+	float uvError = 0.0f;
+
+	for (unsigned i = 0u; i < mesh.verticesNumber; ++i) {
+		const char* vertex = mesh.vertexData + i * mesh.format.stride;
+		positionError = MAX(positionError, mesh.GetPosition(i).Distance(math::float3(&positions[i * 3])));
+
+		if (normals != nullptr) {
+			math::float3 normal;
+			mesh.format.ReadAttribute(vertex, ATTRIBUTE_NORMAL, normal.ptr());
+			math::float3 original(&normals[i * 3]);
+			if (original.Normalize() > 0.0f) {
+				normalError = MAX(normalError, math::RadToDeg(acosf(math::Clamp(normal.Dot(original), -1.0f, 1.0f))));
+			}
+		}
+
+		if (uvs != nullptr) {
+			float uv[2];
+			mesh.format.ReadAttribute(vertex, ATTRIBUTE_UV, uv);
+			uvError = MAX(uvError, MAX(fabsf(uv[0] - uvs[i * 2]), fabsf(uv[1] - uvs[i * 2 + 1])));
+		}
+	}
+
+	// The position bound is half a step of the 16 bit grid over the longest axis
+	float positionBound = 0.5f * mesh.positionScale.MaxElement() / 65535.0f;
+	LOG("Mesh %s quantized to %u bytes per vertex: max position error %f (bound %f), normal %.3f deg, uv %f", meshName, mesh.format.stride, positionError, positionBound, normalError, uvError);
 }
\ No newline at end of file
@@ -8,15 +8,54 @@
 #include <vector>
 
 struct Mesh;
+struct VertexCacheStatistics;
+class MappedFile;
+
+#define MESH_IMPORT_OPTIONS_EXTENSION ".meta"
+
+// Per asset cooking options, read from an optional json "<asset>.meta" next to the source file:
+// { "quantize": true, "normalBits": 8, "optimize": true, "optimizeOverdraw": true, "overdrawThreshold": 1.05, "lodLevels": 4, "splitLargeMeshes": true, "clusters": true, "bvh": true }
+struct MeshImportOptions {
+	bool		quantize = false;			// 16 bit positions over the bounds, octahedral normals and half float uvs
+	unsigned	normalBits = 16u;			// 8 or 16 per octahedral component
+	bool		optimize = true;			// vertex cache order for triangles, first use order for vertices
+	bool		optimizeOverdraw = false;	// also sorts triangle clusters front to back from the outside
+	float		overdrawThreshold = 1.05f;	// how much the cache miss ratio may grow to get smaller clusters
+	unsigned	lodLevels = 4u;				// including the full one, each level halves the triangles of the previous
+	bool		splitLargeMeshes = false;	// splits meshes over 65536 vertices in submeshes so they can use 16 bit indices too
+	bool		clusters = true;			// splits the full level in clusters culled on their own, big meshes only draw what is visible
+	bool		bvh = true;					// triangle hierarchy of the full level so picking does not test every triangle
+};
 
 class MeshImporter
 {
 	public:
-		static void ImportFBX(const char* filePath);
-		static bool Import(const aiMesh* aiMesh, const char* meshName);
+		// Every mesh of the file is cooked and saved in its own import job, returns the meshes saved
+		static unsigned ImportFBX(const char* filePath);
+		static bool Import(const aiMesh* aiMesh, const char* meshName, const MeshImportOptions& options = MeshImportOptions());
 		static bool Load(Mesh* mesh, const char* meshName);
 		static bool Save(const Mesh& mesh, const char* meshName);
 		static void CleanUpStructMesh(Mesh* mesh);
+
+		// Builds the interleaved vertices from planar arrays, normals and uvs are optional
+		static void Cook(Mesh* mesh, unsigned verticesNumber, const float* positions, const float* normals, const float* uvs, const MeshImportOptions& options = MeshImportOptions());
+		static MeshImportOptions LoadImportOptions(const char* assetPath);
+
+		// Last cooking step, narrows the indices to 16 bits when every submesh can address its vertices with them
+		static void CompactIndices(Mesh* mesh);
+
+	private:
+		static bool LoadMapped(Mesh* mesh, MappedFile* file);
+		static bool LoadLegacy(Mesh* mesh, const char* buffer, unsigned size);
+		static void SetPositionDequantize(Mesh* mesh);
+		// Returns the statistics of the order it started from, clustering reorders again before they are logged
+		static VertexCacheStatistics Optimize(Mesh* mesh, const MeshImportOptions& options);
+		static void LogOptimization(const Mesh& mesh, const char* meshName, const VertexCacheStatistics& before);
+		static void GenerateLods(Mesh* mesh, const char* meshName, const MeshImportOptions& options);
+		static void BuildClusters(Mesh* mesh, const char* meshName, const MeshImportOptions& options);
+		static void BuildBvh(Mesh* mesh, const char* meshName, const MeshImportOptions& options);
+		static void SplitSubmeshes(Mesh* mesh, const char* meshName);
+		static void LogQuantizationError(const Mesh& mesh, const char* meshName, const float* positions, const float* normals, const float* uvs);
 };
 
 #endif
@@ -0,0 +1,366 @@
+#include "Globals.h"
+#include "MeshOptimizer.h"
+#include "ModuleTextures.h"
+#include <algorithm>
+#include <assert.h>
+#include <limits.h>
+#include <string.h>
+
+struct OverdrawCluster {
+	unsigned	firstTriangle = 0u;
+	unsigned	trianglesNumber = 0u;
+	float		sortKey = 0.0f;
+};
+
+// Distance of every cluster to the mesh centroid along its average normal, the biggest ones face away from the rest
+static bool ComputeSortKeys(const Mesh& mesh, const unsigned* indices, std::vector<OverdrawCluster>& clusters) {
+	std::vector<math::float3> centroids(clusters.size(), math::float3::zero);
+	std::vector<math::float3> normals(clusters.size(), math::float3::zero);
+	std::vector<float> areas(clusters.size(), 0.0f);
+
+	math::float3 meshCentroid = math::float3::zero;
+	float meshArea = 0.0f;
+
+	for (unsigned i = 0u; i < clusters.size(); ++i) {
+		for (unsigned j = clusters[i].firstTriangle; j < clusters[i].firstTriangle + clusters[i].trianglesNumber; ++j) {
+			math::float3 a = mesh.GetPosition(indices[j * 3u]);
+			math::float3 b = mesh.GetPosition(indices[j * 3u + 1u]);
+			math::float3 c = mesh.GetPosition(indices[j * 3u + 2u]);
+
+			// Twice the area, the factor cancels out
+			math::float3 normal = (b - a).Cross(c - a);
+			float area = normal.Length();
+
+			centroids[i] += (a + b + c) * (area / 3.0f);
+			normals[i] += normal;
+			areas[i] += area;
+		}
+
+		meshCentroid += centroids[i];
+		meshArea += areas[i];
+	}
+
+	if (meshArea <= 0.0f) {
+		return false;
+	}
+
+	meshCentroid /= meshArea;
+
+	for (unsigned i = 0u; i < clusters.size(); ++i) {
+		if (areas[i] > 0.0f) {
+			math::float3 centroid = centroids[i] / areas[i];
+			math::float3 normal = normals[i];
+			normal.Normalize();
+			clusters[i].sortKey = (centroid - meshCentroid).Dot(normal);
+		}
+	}
+
+	return true;
+}
+
+void MeshOptimizer::OptimizeVertexCache(unsigned* indices, unsigned indicesNumber, unsigned verticesNumber, std::vector<unsigned>* clusters) {
+	unsigned trianglesNumber = indicesNumber / 3u;
+	if (clusters != nullptr) {
+		clusters->clear();
+	}
+
+	if (trianglesNumber == 0u || verticesNumber == 0u) {
+		return;
+	}
+
+	// Vertex -> triangles adjacency packed in a single array
+	std::vector<unsigned> liveTriangles(verticesNumber, 0u);
+	for (unsigned i = 0u; i < trianglesNumber * 3u; ++i) {
+		++liveTriangles[indices[i]];
+	}
+
+	std::vector<unsigned> adjacencyOffsets(verticesNumber + 1u, 0u);
+	for (unsigned i = 0u; i < verticesNumber; ++i) {
+		adjacencyOffsets[i + 1u] = adjacencyOffsets[i] + liveTriangles[i];
+	}
+
+	std::vector<unsigned> adjacency(trianglesNumber * 3u);
+	std::vector<unsigned> adjacencyCursor(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (unsigned i = 0u; i < trianglesNumber * 3u; ++i) {
+		adjacency[adjacencyCursor[indices[i]]++] = i / 3u;
+	}
+
+	std::vector<unsigned> cacheTime(verticesNumber, 0u);
+	std::vector<bool> emitted(trianglesNumber, false);
+	std::vector<unsigned> deadEnd;
+	std::vector<unsigned> candidates;
+	std::vector<unsigned> output;
+	deadEnd.reserve(trianglesNumber * 3u);
+	output.reserve(trianglesNumber * 3u);
+
+	unsigned timeStamp = MESH_OPTIMIZER_CACHE_SIZE + 1u;
+	unsigned scanCursor = 0u;
+	unsigned misses = 0u;
+	unsigned clusterStart = 0u;
+	unsigned clusterMisses = 0u;
+	int fanning = 0;
+
+	while (fanning >= 0) {
+		candidates.clear();
+
+		// Emit the whole fan around the current vertex
+		for (unsigned i = adjacencyOffsets[fanning]; i < adjacencyOffsets[fanning + 1]; ++i) {
+			unsigned triangle = adjacency[i];
+			if (emitted[triangle]) {
+				continue;
+			}
+
+			for (unsigned j = 0u; j < 3u; ++j) {
+				unsigned vertex = indices[triangle * 3u + j];
+				output.push_back(vertex);
+				deadEnd.push_back(vertex);
+				candidates.push_back(vertex);
+				--liveTriangles[vertex];
+
+				if (timeStamp - cacheTime[vertex] > MESH_OPTIMIZER_CACHE_SIZE) {
+					cacheTime[vertex] = timeStamp++;
+					++misses;
+					++clusterMisses;
+				}
+			}
+
+			emitted[triangle] = true;
+		}
+
+		// Next fan: the candidate that stays longest in cache and will still be there after its own fan
+		int next = -1;
+		int bestPriority = -1;
+		for (std::vector<unsigned>::const_iterator it = candidates.begin(); it != candidates.end(); ++it) {
+			if (liveTriangles[*it] == 0u) {
+				continue;
+			}
+
+			int priority = 0;
+			if (timeStamp - cacheTime[*it] + 2u * liveTriangles[*it] <= MESH_OPTIMIZER_CACHE_SIZE) {
+				priority = timeStamp - cacheTime[*it];
+			}
+
+			if (priority > bestPriority) {
+				bestPriority = priority;
+				next = *it;
+			}
+		}
+
+		bool deadEndReached = (next < 0);
+		while (next < 0 && !deadEnd.empty()) {
+			unsigned vertex = deadEnd.back();
+			deadEnd.pop_back();
+			if (liveTriangles[vertex] > 0u) {
+				next = vertex;
+			}
+		}
+
+		while (next < 0 && scanCursor < verticesNumber) {
+			if (liveTriangles[scanCursor] > 0u) {
+				next = scanCursor;
+			}
+			++scanCursor;
+		}
+
+		if (clusters != nullptr) {
+			unsigned emittedTriangles = output.size() / 3u;
+			unsigned clusterTriangles = emittedTriangles - clusterStart;
+			bool softBoundary = clusterMisses * emittedTriangles <= misses * clusterTriangles;
+
+			if (clusterTriangles > 0u && (deadEndReached || softBoundary || next < 0)) {
+				clusters->push_back(clusterStart);
+				clusterStart = emittedTriangles;
+				clusterMisses = 0u;
+			}
+		}
+
+		fanning = next;
+	}
+
+	assert(output.size() == trianglesNumber * 3u);
+	memcpy(indices, &output[0], sizeof(unsigned) * output.size());
+}
+
+void MeshOptimizer::OptimizeOverdraw(Mesh& mesh, const std::vector<unsigned>& clusters, float threshold) {
+	assert(mesh.indexSize == sizeof(unsigned));
+	unsigned* indices = (unsigned*)mesh.indices;
+	unsigned trianglesNumber = mesh.indicesNumber / 3u;
+	float maxAcmr = threshold * AnalyzeVertexCache(indices, mesh.indicesNumber, mesh.verticesNumber).acmr;
+
+	std::vector<unsigned> original(indices, indices + mesh.indicesNumber);
+	std::vector<unsigned> boundaries(clusters);
+
+	// Every merge halves the clusters, so only a logarithmic number of sorts is tried
+	while (boundaries.size() >= 2u && trianglesNumber > 0u) {
+		memcpy(indices, &original[0], sizeof(unsigned) * original.size());
+		SortClusters(mesh, boundaries);
+
+		if (AnalyzeVertexCache(indices, mesh.indicesNumber, mesh.verticesNumber).acmr <= maxAcmr) {
+			return;
+		}
+
+		std::vector<unsigned> merged;
+		for (unsigned i = 0u; i < boundaries.size(); i += 2u) {
+			merged.push_back(boundaries[i]);
+		}
+		boundaries.swap(merged);
+	}
+
+	memcpy(indices, &original[0], sizeof(unsigned) * original.size());
+}
+
+void MeshOptimizer::SortClusters(Mesh& mesh, const std::vector<unsigned>& clusters) {
+	unsigned* indices = (unsigned*)mesh.indices;
+	unsigned trianglesNumber = mesh.indicesNumber / 3u;
+
+	std::vector<OverdrawCluster> sorted(clusters.size());
+	for (unsigned i = 0u; i < clusters.size(); ++i) {
+		sorted[i].firstTriangle = clusters[i];
+		sorted[i].trianglesNumber = ((i + 1u < clusters.size()) ? clusters[i + 1u] : trianglesNumber) - clusters[i];
+	}
+
+	if (!ComputeSortKeys(mesh, indices, sorted)) {
+		return;
+	}
+
+	std::stable_sort(sorted.begin(), sorted.end(), [](const OverdrawCluster& first, const OverdrawCluster& second) { return first.sortKey > second.sortKey; });
+
+	std::vector<unsigned> output;
+	output.reserve(trianglesNumber * 3u);
+	for (std::vector<OverdrawCluster>::const_iterator it = sorted.begin(); it != sorted.end(); ++it) {
+		output.insert(output.end(), indices + it->firstTriangle * 3u, indices + (it->firstTriangle + it->trianglesNumber) * 3u);
+	}
+
+	memcpy(indices, &output[0], sizeof(unsigned) * output.size());
+}
+
+void MeshOptimizer::OptimizeClusters(const Mesh& mesh, unsigned* indices, std::vector<MeshCluster>& clusters, bool sortOverdraw) {
+	std::vector<unsigned> localVertices(mesh.verticesNumber, UINT_MAX);
+	std::vector<unsigned> meshVertices;
+	std::vector<unsigned> localIndices;
+
+	for (std::vector<MeshCluster>::const_iterator it = clusters.begin(); it != clusters.end(); ++it) {
+		unsigned* clusterIndices = indices + it->firstIndex;
+		localIndices.resize(it->indicesNumber);
+		for (unsigned i = 0u; i < it->indicesNumber; ++i) {
+			unsigned& local = localVertices[clusterIndices[i]];
+			if (local == UINT_MAX) {
+				local = meshVertices.size();
+				meshVertices.push_back(clusterIndices[i]);
+			}
+			localIndices[i] = local;
+		}
+
+		if (!localIndices.empty()) {
+			OptimizeVertexCache(&localIndices[0], localIndices.size(), meshVertices.size());
+		}
+
+		for (unsigned i = 0u; i < it->indicesNumber; ++i) {
+			clusterIndices[i] = meshVertices[localIndices[i]];
+		}
+
+		for (std::vector<unsigned>::const_iterator vertex = meshVertices.begin(); vertex != meshVertices.end(); ++vertex) {
+			localVertices[*vertex] = UINT_MAX;
+		}
+		meshVertices.clear();
+	}
+
+	if (!sortOverdraw || clusters.size() < 2u) {
+		return;
+	}
+
+	// Clusters are culled on their own, so they are sorted whole and the cache order inside them is kept
+	std::vector<OverdrawCluster> sorted(clusters.size());
+	for (unsigned i = 0u; i < clusters.size(); ++i) {
+		sorted[i].firstTriangle = clusters[i].firstIndex / 3u;
+		sorted[i].trianglesNumber = clusters[i].indicesNumber / 3u;
+	}
+
+	if (!ComputeSortKeys(mesh, indices, sorted)) {
+		return;
+	}
+
+	std::vector<unsigned> order(clusters.size());
+	for (unsigned i = 0u; i < order.size(); ++i) {
+		order[i] = i;
+	}
+	std::stable_sort(order.begin(), order.end(), [&sorted](unsigned first, unsigned second) { return sorted[first].sortKey > sorted[second].sortKey; });
+
+	unsigned firstIndex = clusters.front().firstIndex;
+	std::vector<unsigned> output;
+	std::vector<MeshCluster> sortedClusters;
+	sortedClusters.reserve(clusters.size());
+	for (std::vector<unsigned>::const_iterator it = order.begin(); it != order.end(); ++it) {
+		MeshCluster cluster = clusters[*it];
+		output.insert(output.end(), indices + cluster.firstIndex, indices + cluster.firstIndex + cluster.indicesNumber);
+		cluster.firstIndex = firstIndex + output.size() - cluster.indicesNumber;
+		sortedClusters.push_back(cluster);
+	}
+
+	memcpy(indices + firstIndex, &output[0], sizeof(unsigned) * output.size());
+	clusters.swap(sortedClusters);
+}
+
+void MeshOptimizer::OptimizeVertexFetch(Mesh& mesh) {
+	assert(mesh.mapping == nullptr && mesh.indexSize == sizeof(unsigned));
+
+	if (mesh.indicesNumber == 0u || mesh.verticesNumber == 0u) {
+		return;
+	}
+
+	unsigned* indices = (unsigned*)mesh.indices;
+	std::vector<unsigned> remap(mesh.verticesNumber, UINT_MAX);
+	unsigned nextVertex = 0u;
+	for (unsigned i = 0u; i < mesh.indicesNumber; ++i) {
+		unsigned& remapped = remap[indices[i]];
+		if (remapped == UINT_MAX) {
+			remapped = nextVertex++;
+		}
+		indices[i] = remapped;
+	}
+
+	unsigned stride = mesh.format.stride;
+	char* vertexData = new char[stride * nextVertex];
+	for (unsigned i = 0u; i < mesh.verticesNumber; ++i) {
+		if (remap[i] != UINT_MAX) {
+			memcpy(vertexData + remap[i] * stride, mesh.vertexData + i * stride, stride);
+		}
+	}
+
+	delete[] mesh.vertexData;
+	mesh.vertexData = vertexData;
+	mesh.verticesNumber = nextVertex;
+}
+
+VertexCacheStatistics MeshOptimizer::AnalyzeVertexCache(const unsigned* indices, unsigned indicesNumber, unsigned verticesNumber, unsigned cacheSize) {
+	VertexCacheStatistics statistics;
+	unsigned trianglesNumber = indicesNumber / 3u;
+	if (trianglesNumber == 0u || verticesNumber == 0u) {
+		return statistics;
+	}
+
+	// FIFO cache: a vertex is still cached while fewer than cacheSize misses happened after its own
+	std::vector<unsigned> cacheTime(verticesNumber, 0u);
+	std::vector<bool> referenced(verticesNumber, false);
+	unsigned timeStamp = cacheSize + 1u;
+	unsigned misses = 0u;
+	unsigned uniqueVertices = 0u;
+
+	for (unsigned i = 0u; i < trianglesNumber * 3u; ++i) {
+		unsigned vertex = indices[i];
+		if (timeStamp - cacheTime[vertex] > cacheSize) {
+			cacheTime[vertex] = timeStamp++;
+			++misses;
+		}
+
+		if (!referenced[vertex]) {
+			referenced[vertex] = true;
+			++uniqueVertices;
+		}
+	}
+
+	statistics.acmr = (float)misses / trianglesNumber;
+	statistics.atvr = (float)misses / uniqueVertices;
+
+	return statistics;
+}
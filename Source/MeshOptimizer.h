@@ -0,0 +1,43 @@
+#ifndef __MESHOPTIMIZER_H__
+#define __MESHOPTIMIZER_H__
+
+#include <vector>
+
+struct Mesh;
+struct MeshCluster;
+
+#define MESH_OPTIMIZER_CACHE_SIZE 16u
+
+struct VertexCacheStatistics {
+	float	acmr = 0.0f; // transformed vertices per triangle, 0.5 is the ideal for regular grids
+	float	atvr = 0.0f; // transformed vertices per referenced vertex, 1.0 is the ideal
+};
+
+// Import time reordering of triangle lists, all passes keep the triangles themselves untouched.
+// They work on 32 bit indices, so they run before the importer compacts them.
+class MeshOptimizer
+{
+	public:
+		// Tipsify (Sander et al. 2007), linear in the number of triangles. clusters receives the first triangle of every
+		// cluster, one ends at each dead end and after every fan that did not miss the cache more than the average.
+		static void						OptimizeVertexCache(unsigned* indices, unsigned indicesNumber, unsigned verticesNumber, std::vector<unsigned>* clusters = nullptr);
+
+		// Sorts the clusters so the ones facing away from the mesh center are drawn first, they tend to occlude the rest.
+		// Clusters are merged until the ACMR stays within threshold times the one of the cache optimized order.
+		static void						OptimizeOverdraw(Mesh& mesh, const std::vector<unsigned>& clusters, float threshold);
+
+		// Cache optimizes every cluster on its own numbering of at most MESH_CLUSTER_MAX_VERTICES vertices, the triangles
+		// never leave their cluster. With sortOverdraw the clusters are then sorted like OptimizeOverdraw sorts its own.
+		// Cluster first indices are relative to indices.
+		static void						OptimizeClusters(const Mesh& mesh, unsigned* indices, std::vector<MeshCluster>& clusters, bool sortOverdraw);
+
+		// Moves vertices to first use order and drops the unreferenced ones, rewrites both vertexData and indices
+		static void						OptimizeVertexFetch(Mesh& mesh);
+
+		static VertexCacheStatistics	AnalyzeVertexCache(const unsigned* indices, unsigned indicesNumber, unsigned verticesNumber, unsigned cacheSize = MESH_OPTIMIZER_CACHE_SIZE);
+
+	private:
+		static void						SortClusters(Mesh& mesh, const std::vector<unsigned>& clusters);
+};
+
+#endif
@@ -0,0 +1,240 @@
+#include "Globals.h"
+#include "MeshSimplifier.h"
+#include "ModuleTextures.h"
+#include <algorithm>
+#include <map>
+#include <math.h>
+
+#define SIMPLIFIER_MAX_PASSES 64u
+
+// Symmetric 4x4 matrix of the summed squared plane distances
+struct Quadric {
+	double	a2 = 0.0, b2 = 0.0, c2 = 0.0, d2 = 0.0;
+	double	ab = 0.0, ac = 0.0, ad = 0.0, bc = 0.0, bd = 0.0, cd = 0.0;
+	double	weight = 0.0; // summed plane weights, turns the error back into a squared distance
+};
+
+struct Collapse {
+	unsigned	from = 0u;
+	unsigned	to = 0u;
+	double		cost = 0.0;
+};
+
+static void AddPlane(Quadric& quadric, const math::float3& normal, float distance, double weight) {
+	double a = normal.x, b = normal.y, c = normal.z, d = distance;
+
+	quadric.a2 += weight * a * a;
+	quadric.b2 += weight * b * b;
+	quadric.c2 += weight * c * c;
+	quadric.d2 += weight * d * d;
+	quadric.ab += weight * a * b;
+	quadric.ac += weight * a * c;
+	quadric.ad += weight * a * d;
+	quadric.bc += weight * b * c;
+	quadric.bd += weight * b * d;
+	quadric.cd += weight * c * d;
+	quadric.weight += weight;
+}
+
+static void AddQuadric(Quadric& quadric, const Quadric& added) {
+	quadric.a2 += added.a2; quadric.b2 += added.b2; quadric.c2 += added.c2; quadric.d2 += added.d2;
+	quadric.ab += added.ab; quadric.ac += added.ac; quadric.ad += added.ad;
+	quadric.bc += added.bc; quadric.bd += added.bd; quadric.cd += added.cd;
+	quadric.weight += added.weight;
+}
+
+static double Evaluate(const Quadric& quadric, const math::float3& point) {
+	double x = point.x, y = point.y, z = point.z;
+
+	double error = quadric.a2 * x * x + quadric.b2 * y * y + quadric.c2 * z * z + quadric.d2
+		+ 2.0 * (quadric.ab * x * y + quadric.ac * x * z + quadric.bc * y * z)
+		+ 2.0 * (quadric.ad * x + quadric.bd * y + quadric.cd * z);
+
+	return (error > 0.0 && quadric.weight > 0.0) ? error / quadric.weight : 0.0;
+}
+
+// Moving one corner must not flip or squash any of the triangles that stay
+static bool FlipsTriangles(const std::vector<math::float3>& positions, const std::vector<unsigned>& indices, const std::vector<unsigned>& adjacencyOffsets, const std::vector<unsigned>& adjacency, unsigned from, unsigned to) {
+	for (unsigned i = adjacencyOffsets[from]; i < adjacencyOffsets[from + 1]; ++i) {
+		const unsigned* triangle = &indices[adjacency[i] * 3u];
+		if (triangle[0] == to || triangle[1] == to || triangle[2] == to) {
+			continue;
+		}
+
+		math::float3 corners[3] = { positions[triangle[0]], positions[triangle[1]], positions[triangle[2]] };
+		math::float3 before = (corners[1] - corners[0]).Cross(corners[2] - corners[0]);
+
+		for (unsigned j = 0u; j < 3u; ++j) {
+			if (triangle[j] == from) {
+				corners[j] = positions[to];
+			}
+		}
+
+		math::float3 after = (corners[1] - corners[0]).Cross(corners[2] - corners[0]);
+		if (before.Dot(after) <= 0.25f * before.Length() * after.Length()) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+float MeshSimplifier::Simplify(const Mesh& mesh, const unsigned* indices, unsigned indicesNumber, unsigned targetIndicesNumber, std::vector<unsigned>& result) {
+	result.assign(indices, indices + indicesNumber);
+	unsigned verticesNumber = mesh.verticesNumber;
+
+	std::vector<math::float3> positions(verticesNumber);
+	for (unsigned i = 0u; i < verticesNumber; ++i) {
+		positions[i] = mesh.GetPosition(i);
+	}
+
+	// Vertices sharing a position with another one sit on an attribute seam
+	std::vector<bool> locked(verticesNumber, false);
+	std::vector<unsigned> byPosition(verticesNumber);
+	for (unsigned i = 0u; i < verticesNumber; ++i) {
+		byPosition[i] = i;
+	}
+
+	std::sort(byPosition.begin(), byPosition.end(), [&positions](unsigned first, unsigned second) {
+		const math::float3& a = positions[first];
+		const math::float3& b = positions[second];
+		return a.x < b.x || (a.x == b.x && (a.y < b.y || (a.y == b.y && a.z < b.z)));
+	});
+
+	for (unsigned i = 1u; i < verticesNumber; ++i) {
+		if (positions[byPosition[i]].Equals(positions[byPosition[i - 1]], 0.0f)) {
+			locked[byPosition[i]] = true;
+			locked[byPosition[i - 1]] = true;
+		}
+	}
+
+	// Edges used by a single triangle are open borders
+	std::map<std::pair<unsigned, unsigned>, unsigned> edgeUses;
+	for (unsigned i = 0u; i < indicesNumber; i += 3u) {
+		for (unsigned j = 0u; j < 3u; ++j) {
+			unsigned a = indices[i + j];
+			unsigned b = indices[i + (j + 1u) % 3u];
+			++edgeUses[std::make_pair(MIN(a, b), MAX(a, b))];
+		}
+	}
+
+	for (std::map<std::pair<unsigned, unsigned>, unsigned>::const_iterator it = edgeUses.begin(); it != edgeUses.end(); ++it) {
+		if (it->second == 1u) {
+			locked[it->first.first] = true;
+			locked[it->first.second] = true;
+		}
+	}
+
+	// Every vertex starts with the planes of its triangles, weighted by their area
+	std::vector<Quadric> quadrics(verticesNumber);
+	for (unsigned i = 0u; i < indicesNumber; i += 3u) {
+		const math::float3& a = positions[indices[i]];
+		math::float3 normal = (positions[indices[i + 1]] - a).Cross(positions[indices[i + 2]] - a);
+		float area = normal.Normalize();
+		if (area <= 0.0f) {
+			continue;
+		}
+
+		for (unsigned j = 0u; j < 3u; ++j) {
+			AddPlane(quadrics[indices[i + j]], normal, -normal.Dot(a), area);
+		}
+	}
+
+	double maxError = 0.0;
+	std::vector<Collapse> collapses;
+	std::vector<unsigned> adjacencyOffsets(verticesNumber + 1u);
+	std::vector<unsigned> adjacency;
+	std::vector<unsigned> remap(verticesNumber);
+	std::vector<bool> touched(verticesNumber);
+
+	for (unsigned pass = 0u; pass < SIMPLIFIER_MAX_PASSES && result.size() > targetIndicesNumber; ++pass) {
+		std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0u);
+		for (unsigned i = 0u; i < result.size(); ++i) {
+			++adjacencyOffsets[result[i] + 1u];
+		}
+		for (unsigned i = 0u; i < verticesNumber; ++i) {
+			adjacencyOffsets[i + 1u] += adjacencyOffsets[i];
+		}
+
+		adjacency.resize(result.size());
+		std::vector<unsigned> cursor(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (unsigned i = 0u; i < result.size(); ++i) {
+			adjacency[cursor[result[i]]++] = i / 3u;
+		}
+
+		collapses.clear();
+		for (unsigned i = 0u; i < result.size(); ++i) {
+			unsigned a = result[i];
+			unsigned b = result[i - i % 3u + (i + 1u) % 3u];
+
+			Quadric merged = quadrics[a];
+			AddQuadric(merged, quadrics[b]);
+
+			if (!locked[a]) {
+				Collapse collapse;
+				collapse.from = a;
+				collapse.to = b;
+				collapse.cost = Evaluate(merged, positions[b]);
+				collapses.push_back(collapse);
+			}
+
+			if (!locked[b]) {
+				Collapse collapse;
+				collapse.from = b;
+				collapse.to = a;
+				collapse.cost = Evaluate(merged, positions[a]);
+				collapses.push_back(collapse);
+			}
+		}
+
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& first, const Collapse& second) { return first.cost < second.cost; });
+
+		for (unsigned i = 0u; i < verticesNumber; ++i) {
+			remap[i] = i;
+		}
+		std::fill(touched.begin(), touched.end(), false);
+
+		// Collapses in one pass never share a neighbourhood, so their flip checks stay valid
+		unsigned trianglesToRemove = (result.size() - targetIndicesNumber) / 3u;
+		unsigned removed = 0u;
+		for (std::vector<Collapse>::const_iterator it = collapses.begin(); it != collapses.end() && removed < trianglesToRemove; ++it) {
+			if (touched[it->from] || touched[it->to]) {
+				continue;
+			}
+
+			if (FlipsTriangles(positions, result, adjacencyOffsets, adjacency, it->from, it->to)) {
+				continue;
+			}
+
+			for (unsigned i = adjacencyOffsets[it->from]; i < adjacencyOffsets[it->from + 1]; ++i) {
+				const unsigned* triangle = &result[adjacency[i] * 3u];
+				touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = true;
+				removed += (triangle[0] == it->to || triangle[1] == it->to || triangle[2] == it->to) ? 1u : 0u;
+			}
+
+			remap[it->from] = it->to;
+			AddQuadric(quadrics[it->to], quadrics[it->from]);
+			maxError = MAX(maxError, it->cost);
+		}
+
+		if (removed == 0u) {
+			break;
+		}
+
+		unsigned kept = 0u;
+		for (unsigned i = 0u; i < result.size(); i += 3u) {
+			unsigned a = remap[result[i]];
+			unsigned b = remap[result[i + 1]];
+			unsigned c = remap[result[i + 2]];
+
+			if (a != b && b != c && c != a) {
+				result[kept++] = a;
+				result[kept++] = b;
+				result[kept++] = c;
+			}
+		}
+		result.resize(kept);
+	}
+
+	return (float)sqrt(maxError);
+}
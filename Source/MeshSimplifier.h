@@ -0,0 +1,18 @@
+#ifndef __MESHSIMPLIFIER_H__
+#define __MESHSIMPLIFIER_H__
+
+#include <vector>
+
+struct Mesh;
+
+// Quadric error edge collapse (Garland & Heckbert). Vertices only collapse onto other existing vertices, so the
+// simplified index list keeps referencing the vertex buffer of the mesh and the levels can share it.
+// Attribute seams and open borders are locked so the simplified surface does not tear.
+class MeshSimplifier
+{
+	public:
+		// Returns the largest collapse error, as a distance in mesh units
+		static float	Simplify(const Mesh& mesh, const unsigned* indices, unsigned indicesNumber, unsigned targetIndicesNumber, std::vector<unsigned>& result);
+};
+
+#endif
@@ -10,6 +10,7 @@
 #include "ModuleEditor.h"
 #include "ModuleCamera.h"
 #include "KuadTree.h"
+#include "MeshBvh.h"
 
 ModuleCamera::ModuleCamera() { }
 
@@ -176,7 +177,7 @@ void ModuleCamera::SelectGameObject() {
 	App->scene->quadTree->CollectIntersections(objectsPossiblePick, rayCast);
 
 	for (std::list<ComponentMesh*>::iterator iterator = App->renderer->meshes.begin(); iterator != App->renderer->meshes.end(); ++iterator) {
-		if (!(*iterator)->goContainer->staticGo && (*iterator)->mesh.verticesNumber > 0 && rayCast.Intersects((*iterator)->goContainer->bbox)) {
+		if (!(*iterator)->goContainer->staticGo && (*iterator)->resource != nullptr) {
 			objectsPossiblePick.push_back((*iterator)->goContainer);
 		}
 	}
@@ -188,18 +189,43 @@ void ModuleCamera::SelectGameObject() {
 			ComponentMesh* componentMesh = (ComponentMesh*)(*iterator)->GetComponent(ComponentType::MESH);
 			ComponentTransform* componentTransform = (ComponentTransform*)(*iterator)->GetComponent(ComponentType::TRANSFORM);
 
-			if (componentTransform != nullptr && componentMesh != nullptr) {
-				Mesh mesh = componentMesh->mesh;
+			// The quadtree only tested the boxes, the sphere and the obb skip most of the triangle tests
+			if (!rayCast.Intersects((*iterator)->bsphere) || !rayCast.Intersects((*iterator)->obb)) {
+				continue;
+			}
+
+			if (componentTransform != nullptr && componentMesh != nullptr && componentMesh->GetMesh() != nullptr) {
+				const Mesh& mesh = *componentMesh->GetMesh();
 				math::LineSegment localTransformPikingLine(rayCast);
 				localTransformPikingLine.Transform(componentTransform->GetGlobalTransform().Inverted());
 
+				// Distances are along the local segment, from 0 at its start to 1 at its end
+				if (mesh.bvhNodesNumber > 0u) {
+					float triangleDistance = 1.0f;
+					if (MeshBvh::Intersect(mesh, localTransformPikingLine.a, localTransformPikingLine.b - localTransformPikingLine.a, triangleDistance)) {
+						if (minDistance == -.1f * App->scene->scaleFactor || triangleDistance < minDistance) {
+							minDistance = triangleDistance;
+							gameObjectHit = *iterator;
+						}
+					}
+					continue;
+				}
+
+				// The full resolution level is first in the indices, the simplified ones follow it
 				math::Triangle triangle;
-				for (unsigned i = 0u; i < mesh.indicesNumber; i += 3) {
+				unsigned pickedIndices = mesh.GetLod(0u).indicesNumber;
+				unsigned submesh = 0u;
+				for (unsigned i = 0u; i < pickedIndices; i += 3) {
 					//Only the parmesh meshes does not contains indices, also we dont want to check triangles if GO has no mesh selected
-					if (mesh.indices != nullptr && mesh.verticesNumber > 0) {
-						triangle.a = { mesh.vertices[mesh.indices[i] * 3], mesh.vertices[mesh.indices[i] * 3 + 1], mesh.vertices[mesh.indices[i] * 3 + 2] };
-						triangle.b = { mesh.vertices[mesh.indices[i + 1] * 3], mesh.vertices[mesh.indices[i + 1] * 3 + 1], mesh.vertices[mesh.indices[i + 1] * 3 + 2] };
-						triangle.c = { mesh.vertices[mesh.indices[i + 2] * 3], mesh.vertices[mesh.indices[i + 2] * 3 + 1], mesh.vertices[mesh.indices[i + 2] * 3 + 2] };
+					if (mesh.indices != nullptr && mesh.vertexData != nullptr) {
+						while (i >= mesh.GetSubmesh(submesh).firstIndex + mesh.GetSubmesh(submesh).indicesNumber) {
+							++submesh;
+						}
+
+						unsigned baseVertex = mesh.GetSubmesh(submesh).baseVertex;
+						triangle.a = mesh.GetPosition(baseVertex + mesh.GetIndex(i));
+						triangle.b = mesh.GetPosition(baseVertex + mesh.GetIndex(i + 1));
+						triangle.c = mesh.GetPosition(baseVertex + mesh.GetIndex(i + 2));
 
 						float triangleDistance;
 						math::float3 hitPoint;
@@ -2,12 +2,20 @@
 #include "ModuleDebugDraw.h"
 #include "Application.h"
 #include "ModuleRender.h"
+#include "GLStateCache.h"
+#include "StreamBuffer.h"
+#include "imgui.h"
 
 #define DEBUG_DRAW_IMPLEMENTATION
 #include "DebugDraw.h"     // Debug Draw API. Notice that we need the DEBUG_DRAW_IMPLEMENTATION macro here!
 
 #include "glew-2.1.0\include\GL\glew.h"
 #include <assert.h>
+#include <vector>
+
+// Batches are at most DEBUG_DRAW_VERTEX_BUFFER_SIZE vertices, a region holds several of them
+#define DEBUG_DRAW_STREAM_REGION (DEBUG_DRAW_VERTEX_BUFFER_SIZE * 16)
+#define DEBUG_DRAW_STREAM_REGIONS 3
 
 class DDRenderInterfaceCoreGL final : public dd::RenderInterface
 {
@@ -22,44 +30,25 @@ public:
         assert(points != nullptr);
         assert(count > 0 && count <= DEBUG_DRAW_VERTEX_BUFFER_SIZE);
 
-        glBindVertexArray(linePointVAO);
-        glUseProgram(linePointProgram);
+        GLStateCache* state = App->renderer->glState;
+        state->BindVertexArray(linePointVAO);
+        state->UseProgram(linePointProgram);
 
         glUniformMatrix4fv(linePointProgram_MvpMatrixLocation,
                            1, GL_TRUE, reinterpret_cast<float*>(&mvpMatrix));
 
-        bool already = glIsEnabled(GL_DEPTH_TEST);
+        bool already = state->IsEnabled(GL_DEPTH_TEST);
+        state->SetEnabled(GL_DEPTH_TEST, depthEnabled);
 
-        if (depthEnabled)
-        {
-            glEnable(GL_DEPTH_TEST);
-        }
-        else
-        {
-            glDisable(GL_DEPTH_TEST);
-        }
-
-        // NOTE: Could also use glBufferData to take advantage of the buffer orphaning trick...
-        glBindBuffer(GL_ARRAY_BUFFER, linePointVBO);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(dd::DrawVertex), points);
+        // Streamed through the ring, no sync with draws still reading older batches
+        GLint first = stream.Write(points, count);
 
         // Issue the draw call:
-        glDrawArrays(GL_POINTS, 0, count);
-
-        glUseProgram(0);
-        glBindVertexArray(0);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glDrawArrays(GL_POINTS, first, count);
         checkGLError(__FILE__, __LINE__);
 
-        if (already)
-        {
-            glEnable(GL_DEPTH_TEST);
-        }
-        else
-        {
-            glDisable(GL_DEPTH_TEST);
-        }
-
+        // Bindings are left as they are, the state cache skips them on the next batch
+        state->SetEnabled(GL_DEPTH_TEST, already);
     }
 
     void drawLineList(const dd::DrawVertex * lines, int count, bool depthEnabled) override
@@ -67,44 +56,24 @@ public:
         assert(lines != nullptr);
         assert(count > 0 && count <= DEBUG_DRAW_VERTEX_BUFFER_SIZE);
 
-        glBindVertexArray(linePointVAO);
-        glUseProgram(linePointProgram);
+        GLStateCache* state = App->renderer->glState;
+        state->BindVertexArray(linePointVAO);
+        state->UseProgram(linePointProgram);
 
         glUniformMatrix4fv(linePointProgram_MvpMatrixLocation,
                            1, GL_TRUE, reinterpret_cast<const float*>(&mvpMatrix));
 
-        bool already = glIsEnabled(GL_DEPTH_TEST);
-
-        if (depthEnabled)
-        {
-            glEnable(GL_DEPTH_TEST);
-        }
-        else
-        {
-            glDisable(GL_DEPTH_TEST);
-        }
+        bool already = state->IsEnabled(GL_DEPTH_TEST);
+        state->SetEnabled(GL_DEPTH_TEST, depthEnabled);
 
-        // NOTE: Could also use glBufferData to take advantage of the buffer orphaning trick...
-        glBindBuffer(GL_ARRAY_BUFFER, linePointVBO);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(dd::DrawVertex), lines);
+        GLint first = stream.Write(lines, count);
 
         // Issue the draw call:
-        glDrawArrays(GL_LINES, 0, count);
-
-        glUseProgram(0);
-        glBindVertexArray(0);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glDrawArrays(GL_LINES, first, count);
         checkGLError(__FILE__, __LINE__);
 
-        if (already)
-        {
-            glEnable(GL_DEPTH_TEST);
-        }
-        else
-        {
-            glDisable(GL_DEPTH_TEST);
-        }
-
+        // Bindings are left as they are, the state cache skips them on the next batch
+        state->SetEnabled(GL_DEPTH_TEST, already);
     }
 
     void drawGlyphList(const dd::DrawVertex * glyphs, int count, dd::GlyphTextureHandle glyphTex) override
@@ -112,8 +81,9 @@ public:
         assert(glyphs != nullptr);
         assert(count > 0 && count <= DEBUG_DRAW_VERTEX_BUFFER_SIZE);
 
-        glBindVertexArray(textVAO);
-        glUseProgram(textProgram);
+        GLStateCache* state = App->renderer->glState;
+        state->BindVertexArray(textVAO);
+        state->UseProgram(textProgram);
 
         // These doesn't have to be reset every draw call, I'm just being lazy ;)
         glUniform1i(textProgram_GlyphTextureLocation, 0);
@@ -123,31 +93,22 @@ public:
 
         if (glyphTex != nullptr)
         {
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, handleToGL(glyphTex));
+            state->ActiveTexture(GL_TEXTURE0);
+            state->BindTexture(GL_TEXTURE_2D, handleToGL(glyphTex));
         }
 
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-        bool already = glIsEnabled(GL_DEPTH_TEST);
-        glDisable(GL_DEPTH_TEST);
+        state->Enable(GL_BLEND);
+        state->BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        bool already = state->IsEnabled(GL_DEPTH_TEST);
+        state->Disable(GL_DEPTH_TEST);
 
-        glBindBuffer(GL_ARRAY_BUFFER, textVBO);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(dd::DrawVertex), glyphs);
+        GLint first = stream.Write(glyphs, count);
 
-        glDrawArrays(GL_TRIANGLES, 0, count); // Issue the draw call
-
-        glDisable(GL_BLEND);
-        glUseProgram(0);
-        glBindVertexArray(0);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindTexture(GL_TEXTURE_2D,  0);
+        glDrawArrays(GL_TRIANGLES, first, count); // Issue the draw call
         checkGLError(__FILE__, __LINE__);
 
-        if (already)
-        {
-            glEnable(GL_DEPTH_TEST);
-        }
+        state->Disable(GL_BLEND);
+        state->SetEnabled(GL_DEPTH_TEST, already);
     }
 
     dd::GlyphTextureHandle createGlyphTexture(int width, int height, const void * pixels) override
@@ -157,7 +118,7 @@ public:
 
         GLuint textureId = 0;
         glGenTextures(1, &textureId);
-        glBindTexture(GL_TEXTURE_2D, textureId);
+        App->renderer->glState->BindTexture(GL_TEXTURE_2D, textureId);
 
         glPixelStorei(GL_PACK_ALIGNMENT,   1);
         glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
@@ -168,8 +129,6 @@ public:
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-
-        glBindTexture(GL_TEXTURE_2D, 0);
         checkGLError(__FILE__, __LINE__);
 
         return GLToHandle(textureId);
@@ -182,11 +141,87 @@ public:
             return;
         }
 
-        const GLuint textureId = handleToGL(glyphTex);
-        glBindTexture(GL_TEXTURE_2D, 0);
-        glDeleteTextures(1, &textureId);
+        GLuint textureId = handleToGL(glyphTex);
+        App->renderer->glState->DeleteTexture(textureId);
+    }
+
+    void drawGrid(const float mins, const float maxs, const float y, const float step, const math::float3& color)
+    {
+        // The grid only changes with the scene scale, it is kept in its own buffer instead of streamed per view
+        if (gridVertices == 0 || mins != gridMins || maxs != gridMaxs || y != gridY || step != gridStep || !color.Equals(gridColor))
+        {
+            buildGrid(mins, maxs, y, step, color);
+        }
+
+        if (gridVertices == 0)
+        {
+            return;
+        }
+
+        GLStateCache* state = App->renderer->glState;
+        state->BindVertexArray(gridVAO);
+        state->UseProgram(linePointProgram);
+
+        glUniformMatrix4fv(linePointProgram_MvpMatrixLocation,
+                           1, GL_TRUE, reinterpret_cast<const float*>(&mvpMatrix));
+
+        bool already = state->IsEnabled(GL_DEPTH_TEST);
+        state->Enable(GL_DEPTH_TEST);
+
+        glDrawArrays(GL_LINES, 0, gridVertices);
+        checkGLError(__FILE__, __LINE__);
+
+        state->SetEnabled(GL_DEPTH_TEST, already);
+    }
+
+    void buildGrid(const float mins, const float maxs, const float y, const float step, const math::float3& color)
+    {
+        gridMins = mins;
+        gridMaxs = maxs;
+        gridY = y;
+        gridStep = step;
+        gridColor = color;
+
+        // Same lines dd::xzSquareGrid would queue every call
+        std::vector<dd::DrawVertex> vertices;
+        for (float i = mins; step > 0.0f && i <= maxs; i += step)
+        {
+            pushGridLine(vertices, math::float3(mins, y, i), math::float3(maxs, y, i), color);
+            pushGridLine(vertices, math::float3(i, y, mins), math::float3(i, y, maxs), color);
+        }
+
+        gridVertices = static_cast<GLsizei>(vertices.size());
+        if (gridVertices == 0)
+        {
+            return;
+        }
+
+        App->renderer->glState->BindBuffer(GL_ARRAY_BUFFER, gridVBO);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(dd::DrawVertex), &vertices[0], GL_STATIC_DRAW);
+        checkGLError(__FILE__, __LINE__);
+    }
+
+    static void pushGridLine(std::vector<dd::DrawVertex>& vertices, const math::float3& from, const math::float3& to, const math::float3& color)
+    {
+        dd::DrawVertex vertex = {};
+        vertex.line.r = color.x;
+        vertex.line.g = color.y;
+        vertex.line.b = color.z;
+
+        vertex.line.x = from.x;
+        vertex.line.y = from.y;
+        vertex.line.z = from.z;
+        vertices.push_back(vertex);
+
+        vertex.line.x = to.x;
+        vertex.line.y = to.y;
+        vertex.line.z = to.z;
+        vertices.push_back(vertex);
     }
 
+    unsigned streamWaits() const { return stream.waits; }
+    bool streamPersistent() const { return stream.persistent; }
+
     // These two can also be implemented to perform GL render
     // state setup/cleanup, but we don't use them in this sample.
     //void beginDraw() override { }
@@ -206,9 +241,15 @@ public:
         , textProgram_GlyphTextureLocation(-1)
         , textProgram_ScreenDimensions(-1)
         , linePointVAO(0)
-        , linePointVBO(0)
         , textVAO(0)
-        , textVBO(0)
+        , gridVAO(0)
+        , gridVBO(0)
+        , gridVertices(0)
+        , gridMins(0.0f)
+        , gridMaxs(0.0f)
+        , gridY(0.0f)
+        , gridStep(0.0f)
+        , gridColor(math::float3::zero)
     {
         //std::printf("\n");
         //std::printf("GL_VENDOR    : %s\n",   glGetString(GL_VENDOR));
@@ -218,12 +259,13 @@ public:
         //std::printf("DDRenderInterfaceCoreGL initializing ...\n");
 
         // Default OpenGL states:
-        glEnable(GL_CULL_FACE);
-        glEnable(GL_DEPTH_TEST);
-        glDisable(GL_BLEND);
+        GLStateCache* state = App->renderer->glState;
+        state->Enable(GL_CULL_FACE);
+        state->Enable(GL_DEPTH_TEST);
+        state->Disable(GL_BLEND);
 
         // This has to be enabled since the point drawing shader will use gl_PointSize.
-        glEnable(GL_PROGRAM_POINT_SIZE);
+        state->Enable(GL_PROGRAM_POINT_SIZE);
 
         setupShaderPrograms();
         setupVertexBuffers();
@@ -233,14 +275,17 @@ public:
 
     ~DDRenderInterfaceCoreGL()
     {
+        GLStateCache* state = App->renderer->glState;
+        state->UseProgram(0);
         glDeleteProgram(linePointProgram);
         glDeleteProgram(textProgram);
 
-        glDeleteVertexArrays(1, &linePointVAO);
-        glDeleteBuffers(1, &linePointVBO);
+        state->DeleteVertexArray(linePointVAO);
+        state->DeleteVertexArray(textVAO);
+        stream.CleanUp();
 
-        glDeleteVertexArrays(1, &textVAO);
-        glDeleteBuffers(1, &textVBO);
+        state->DeleteVertexArray(gridVAO);
+        state->DeleteBuffer(gridVBO);
     }
 
     void setupShaderPrograms()
@@ -316,49 +361,41 @@ public:
     {
         //std::printf("> DDRenderInterfaceCoreGL::setupVertexBuffers()\n");
 
+        // Lines, points and text share one ring, every batch gets its own range
+        stream.Init(sizeof(dd::DrawVertex), DEBUG_DRAW_STREAM_REGION, DEBUG_DRAW_STREAM_REGIONS);
+        checkGLError(__FILE__, __LINE__);
+
         //
         // Lines/points vertex buffer:
         //
         {
             glGenVertexArrays(1, &linePointVAO);
-            glGenBuffers(1, &linePointVBO);
-            checkGLError(__FILE__, __LINE__);
-
-            glBindVertexArray(linePointVAO);
-            glBindBuffer(GL_ARRAY_BUFFER, linePointVBO);
-
-            // RenderInterface will never be called with a batch larger than
-            // DEBUG_DRAW_VERTEX_BUFFER_SIZE vertexes, so we can allocate the same amount here.
-            glBufferData(GL_ARRAY_BUFFER, DEBUG_DRAW_VERTEX_BUFFER_SIZE * sizeof(dd::DrawVertex), nullptr, GL_STREAM_DRAW);
             checkGLError(__FILE__, __LINE__);
 
-            // Set the vertex format expected by 3D points and lines:
-            std::size_t offset = 0;
-
-            glEnableVertexAttribArray(0); // in_Position (vec3)
-            glVertexAttribPointer(
-                /* index     = */ 0,
-                /* size      = */ 3,
-                /* type      = */ GL_FLOAT,
-                /* normalize = */ GL_FALSE,
-                /* stride    = */ sizeof(dd::DrawVertex),
-                /* offset    = */ reinterpret_cast<void *>(offset));
-            offset += sizeof(float) * 3;
+            App->renderer->glState->BindVertexArray(linePointVAO);
+            App->renderer->glState->BindBuffer(GL_ARRAY_BUFFER, stream.buffer);
+            setupLinePointFormat();
 
-            glEnableVertexAttribArray(1); // in_ColorPointSize (vec4)
-            glVertexAttribPointer(
-                /* index     = */ 1,
-                /* size      = */ 4,
-                /* type      = */ GL_FLOAT,
-                /* normalize = */ GL_FALSE,
-                /* stride    = */ sizeof(dd::DrawVertex),
-                /* offset    = */ reinterpret_cast<void *>(offset));
+            // VAOs can be a pain in the neck if left enabled...
+            App->renderer->glState->BindVertexArray(0);
+            App->renderer->glState->BindBuffer(GL_ARRAY_BUFFER, 0);
+        }
 
+        //
+        // Retained grid vertex buffer:
+        //
+        {
+            glGenVertexArrays(1, &gridVAO);
+            glGenBuffers(1, &gridVBO);
             checkGLError(__FILE__, __LINE__);
 
-            // VAOs can be a pain in the neck if left enabled...
-            glBindVertexArray(0);
-            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            App->renderer->glState->BindVertexArray(gridVAO);
+            App->renderer->glState->BindBuffer(GL_ARRAY_BUFFER, gridVBO);
+            setupLinePointFormat();
+
+            // Ditto.
+            App->renderer->glState->BindVertexArray(0);
+            App->renderer->glState->BindBuffer(GL_ARRAY_BUFFER, 0);
         }
 
         //
@@ -366,16 +403,10 @@ public:
         //
         {
             glGenVertexArrays(1, &textVAO);
-            glGenBuffers(1, &textVBO);
             checkGLError(__FILE__, __LINE__);
 
-            glBindVertexArray(textVAO);
-            glBindBuffer(GL_ARRAY_BUFFER, textVBO);
-
-            // NOTE: A more optimized implementation might consider combining
-            // both the lines/points and text buffers to save some memory!
-            glBufferData(GL_ARRAY_BUFFER, DEBUG_DRAW_VERTEX_BUFFER_SIZE * sizeof(dd::DrawVertex), nullptr, GL_STREAM_DRAW);
-            checkGLError(__FILE__, __LINE__);
+            App->renderer->glState->BindVertexArray(textVAO);
+            App->renderer->glState->BindBuffer(GL_ARRAY_BUFFER, stream.buffer);
 
             // Set the vertex format expected by the 2D text:
             std::size_t offset = 0;
@@ -412,11 +443,38 @@ public:
             checkGLError(__FILE__, __LINE__);
 
             // Ditto.
-            glBindVertexArray(0);
-            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            App->renderer->glState->BindVertexArray(0);
+            App->renderer->glState->BindBuffer(GL_ARRAY_BUFFER, 0);
         }
     }
 
+    static void setupLinePointFormat()
+    {
+        // Set the vertex format expected by 3D points and lines:
+        std::size_t offset = 0;
+
+        glEnableVertexAttribArray(0); // in_Position (vec3)
+        glVertexAttribPointer(
+            /* index     = */ 0,
+            /* size      = */ 3,
+            /* type      = */ GL_FLOAT,
+            /* normalize = */ GL_FALSE,
+            /* stride    = */ sizeof(dd::DrawVertex),
+            /* offset    = */ reinterpret_cast<void *>(offset));
+        offset += sizeof(float) * 3;
+
+        glEnableVertexAttribArray(1); // in_ColorPointSize (vec4)
+        glVertexAttribPointer(
+            /* index     = */ 1,
+            /* size      = */ 4,
+            /* type      = */ GL_FLOAT,
+            /* normalize = */ GL_FALSE,
+            /* stride    = */ sizeof(dd::DrawVertex),
+            /* offset    = */ reinterpret_cast<void *>(offset));
+
+        checkGLError(__FILE__, __LINE__);
+    }
+
     static GLuint handleToGL(dd::GlyphTextureHandle handle)
     {
         const std::size_t temp = reinterpret_cast<std::size_t>(handle);
@@ -487,10 +545,17 @@ private:
     GLint  textProgram_ScreenDimensions;
 
     GLuint linePointVAO;
-    GLuint linePointVBO;
-
     GLuint textVAO;
-    GLuint textVBO;
+    StreamBuffer stream;
+
+    GLuint gridVAO;
+    GLuint gridVBO;
+    GLsizei gridVertices;
+    float gridMins;
+    float gridMaxs;
+    float gridY;
+    float gridStep;
+    math::float3 gridColor;
 
     static const char * linePointVertShaderSrc;
     static const char * linePointFragShaderSrc;
@@ -577,12 +642,21 @@ ModuleDebugDraw::ModuleDebugDraw() { }
 ModuleDebugDraw::~ModuleDebugDraw() { }
 
 bool ModuleDebugDraw::Init() {
+    // Without a context dd:: calls are ignored, nothing gets initialized
+    if (App->headless) {
+        return true;
+    }
+
     implementation = new DDRenderInterfaceCoreGL;
     dd::initialize(implementation);
     return true;
 }
 
 bool ModuleDebugDraw::CleanUp() {
+    if (implementation == nullptr) {
+        return true;
+    }
+
     dd::shutdown();
 
     delete implementation;
@@ -596,6 +670,10 @@ update_status  ModuleDebugDraw::Update() {
 }
 
 void ModuleDebugDraw::Draw(ComponentCamera* camera, unsigned fbo, unsigned fb_width, unsigned fb_height) {
+	if (implementation == nullptr) {
+		return;
+	}
+
 	math::float4x4 view  = camera->frustum.ViewMatrix();
 	math::float4x4 proj = camera->frustum.ProjectionMatrix();
 
@@ -603,7 +681,33 @@ void ModuleDebugDraw::Draw(ComponentCamera* camera, unsigned fbo, unsigned fb_wi
     implementation->height    = fb_height;
     implementation->mvpMatrix = proj * view;
 
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    App->renderer->glState->BindFramebuffer(GL_FRAMEBUFFER, fbo);
+
+    if (gridRequested) {
+        implementation->drawGrid(gridMins, gridMaxs, gridY, gridStep, gridColor);
+        gridRequested = false;
+    }
+
     dd::flush();
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void ModuleDebugDraw::Grid(float mins, float maxs, float y, float step, const math::float3& color) {
+    if (implementation == nullptr) {
+        return;
+    }
+
+    gridRequested = true;
+    gridMins = mins;
+    gridMaxs = maxs;
+    gridY = y;
+    gridStep = step;
+    gridColor = color;
+}
+
+void ModuleDebugDraw::DrawGUI() const {
+    if (implementation == nullptr) {
+        return;
+    }
+
+    ImGui::Text("Debug draw stream: %s, %u waits", implementation->streamPersistent() ? "persistent" : "orphaned", implementation->streamWaits());
 }
@@ -18,9 +18,19 @@ class ModuleDebugDraw : public Module
 		bool            CleanUp();
 
 		void            Draw(ComponentCamera* camera, unsigned fbo, unsigned fb_width, unsigned fb_height);
+		// Same as dd::xzSquareGrid but kept in a static buffer, drawn with the next Draw()
+		void            Grid(float mins, float maxs, float y, float step, const math::float3& color);
+		void            DrawGUI() const;
 
 	private:
 		static DDRenderInterfaceCoreGL* implementation;
+
+		bool            gridRequested = false;
+		float           gridMins = 0.0f;
+		float           gridMaxs = 0.0f;
+		float           gridY = 0.0f;
+		float           gridStep = 0.0f;
+		math::float3    gridColor = math::float3::zero;
 };
 
 #endif /* _MODULE_DEBUGDRAW_H_ */
@@ -35,6 +35,10 @@ ModuleEditor::~ModuleEditor() { }
 
 bool ModuleEditor::Init() 
 {
+	if (App->headless) {
+		return true;
+	}
+
 	const char* glsl_version = "#version 130"; 
 
 	IMGUI_CHECKVERSION();
@@ -53,6 +57,10 @@ bool ModuleEditor::Init()
 update_status ModuleEditor::PreUpdate() 
 {
 	BROFILER_CATEGORY("EditorPreUpdate()", Profiler::Color::Aqua);
+	if (App->headless) {
+		return UPDATE_CONTINUE;
+	}
+
 	ImGui_ImplOpenGL3_NewFrame();
 	ImGui_ImplSDL2_NewFrame(App->window->window);
 	ImGui::NewFrame();
@@ -120,6 +128,10 @@ update_status ModuleEditor::PreUpdate()
 update_status ModuleEditor::Update() 
 {
 	BROFILER_CATEGORY("EditorUpdate()", Profiler::Color::Aqua);
+	if (App->headless) {
+		return UPDATE_CONTINUE;
+	}
+
 	if (ImGui::BeginMainMenuBar()) 
 	{
 		if (ImGui::BeginMenu("File")) 
@@ -342,6 +354,10 @@ bool ModuleEditor::CleanUp() {
 	}
 	docks.clear();
 
+	if (App->headless) {
+		return true;
+	}
+
 	ImGui_ImplOpenGL3_Shutdown();
 	ImGui_ImplSDL2_Shutdown();
 	ImGui::DestroyContext();
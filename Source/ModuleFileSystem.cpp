@@ -29,6 +29,8 @@ bool ModuleFileSystem::Init() {
 	if (Exists("/Library/Scenes/")) {
 		PHYSFS_mkdir("/Library/Scenes/");
 	}
+	// Cooked content is shared by every library folder, it has to exist before the first import
+	PHYSFS_mkdir("/Library/Content/");
 	return true;
 }
 
@@ -131,6 +133,19 @@ bool ModuleFileSystem::IsDirectory(const char* pathAndFileName) const {
 	return PHYSFS_isDirectory(pathAndFileName) != 0;
 }
 
+bool ModuleFileSystem::GetRealPath(const char* pathAndFileName, std::string& realPath) const {
+	const char* directory = PHYSFS_getRealDir(pathAndFileName);
+
+	if (directory == nullptr) {
+		return false;
+	}
+
+	realPath = directory;
+	realPath.append(pathAndFileName);
+
+	return true;
+}
+
 bool ModuleFileSystem::Copy(const char* sourcePath, const char* destinationPath) {
 	bool result = false;
 
@@ -21,6 +21,8 @@ class ModuleFileSystem : public Module
 		bool Remove(const char* pathAndFileName);
 		bool Exists(const char* pathAndFileName) const;
 		bool IsDirectory(const char* pathAndFileName) const;
+		// OS path of a file in the search path, for APIs that bypass PhysFS such as file mapping
+		bool GetRealPath(const char* pathAndFileName, std::string& realPath) const;
 		void ChangePathSlashes(std::string& fullPath) const;
 		bool Copy(const char* sourcePath, const char* destinationPath);
 		void GetFilesFromDirectory(const char* directory, std::vector<std::string>& fileList) const;
@@ -1,12 +1,12 @@
 #include "Globals.h"
 #include "ModuleInput.h"
 #include "Application.h"
-#include "MeshImporter.h"
 #include "ModuleEditor.h"
 #include "ModuleCamera.h"
 #include "ModuleTextures.h"
 #include "MaterialImporter.h"
 #include "ModuleFileSystem.h"
+#include "ModuleLibrary.h"
 #include "ModuleWindow.h"
 #include "ModuleRender.h"
 #include "SDL.h"
@@ -27,6 +27,11 @@ ModuleInput::~ModuleInput() {
 bool ModuleInput::Init() {
 	LOG("Init SDL input event system");
 	bool ret = true;
+
+	if (App->headless) {
+		return ret;
+	}
+
 	SDL_Init(0);
 
 	if (SDL_InitSubSystem(SDL_INIT_EVENTS) < 0) {
@@ -39,6 +44,10 @@ bool ModuleInput::Init() {
 
 update_status ModuleInput::PreUpdate() {
 	BROFILER_CATEGORY("InputPreUpdate()", Profiler::Color::Chocolate);
+	if (App->headless) {
+		return UPDATE_CONTINUE;
+	}
+
 	static SDL_Event event;
 
 	mouse_motion = { 0, 0 };
@@ -146,7 +155,9 @@ update_status ModuleInput::PreUpdate() {
 // Called before quitting
 bool ModuleInput::CleanUp() {
 	LOG("Quitting SDL event subsystem");
-	SDL_QuitSubSystem(SDL_INIT_EVENTS);
+	if (!App->headless) {
+		SDL_QuitSubSystem(SDL_INIT_EVENTS);
+	}
 	return true;
 }
 
@@ -158,12 +169,12 @@ void ModuleInput::FileDropped(const char* fileDroppedPath) {
 	fileName = fileName.substr(found, fileName.length());
 
 	//TODO: we should be able to drop fbx and png from outside the project
-	if (extension == "png" || extension == "tif") {
+	if (extension == "png" || extension == "tif" || extension == "tga") {
 		App->fileSystem->ChangePathSlashes(fileName);
-		MaterialImporter::Import(fileName.c_str());
+		App->library->ImportTextureFiles(std::vector<std::string>(1u, fileName));
 	} else if (extension == "fbx" || extension == "FBX") {
 		App->fileSystem->ChangePathSlashes(fileName);
-		MeshImporter::ImportFBX(fileName.c_str());
+		App->library->ImportMeshFiles(std::vector<std::string>(1u, fileName));
 	} else {
 		LOG("Error: The file you are trying to drop is not accepted.");
 	}
@@ -2,26 +2,60 @@
 #include "Application.h"
 #include "MeshImporter.h"
 #include "ModuleFileSystem.h"
+#include "ModuleRender.h"
+#include "ModuleScene.h"
+#include "ComponentMesh.h"
+#include "GameObject.h"
+#include "KuadTree.h"
 #include "MaterialImporter.h"
+#include "ResourceMesh.h"
 #include "imgui.h"
-#include "thread";
+#include "SDL\include\SDL.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
-bool stopWatcher = false;
+// Set under the mutex, the watcher waits on the condition between scans so CleanUp wakes it right away
+static std::mutex watcherMutex;
+static std::condition_variable watcherCondition;
+static bool stopWatcher = false;
 
-ModuleLibrary::ModuleLibrary() { }
+ModuleLibrary::ModuleLibrary() : meshesToImport(0u), importedMeshes(0u) { }
 
-ModuleLibrary::~ModuleLibrary() { 
-	CleanUp();
+ModuleLibrary::~ModuleLibrary() {
+	// Still running when Init failed and CleanUp was never called
+	StopWatcher();
+
+	// Released while streaming, they are no longer in the cache
+	for (std::list<ResourceMesh*>::iterator it = streamingMeshes.begin(); it != streamingMeshes.end(); ++it) {
+		if ((*it)->references == 0u) {
+			delete *it;
+		}
+	}
+	streamingMeshes.clear();
+
+	// Components release their meshes with the scene, whatever is left here was never released
+	for (std::map<std::string, ResourceMesh*>::iterator it = meshResources.begin(); it != meshResources.end(); ++it) {
+		LOG("Warning: Mesh %s still has %u references", it->first.c_str(), it->second->references);
+		delete it->second;
+	}
+	meshResources.clear();
 }
 
 void LibraryWatcher() {
 	std::map<std::string, std::string> oldFilesAssets;
 	std::map<std::string, std::string> currentFilesAssets;
 	std::map<std::string, std::string> currentFilesLibrary;
+	std::unique_lock<std::mutex> lock(watcherMutex);
 	while (!stopWatcher) {
+		lock.unlock();
 		App->fileSystem->GetFilesFromDirectoryRecursive("/Assets/", true, currentFilesAssets);
 		if ((oldFilesAssets.size() == 0 && oldFilesAssets.size() != currentFilesAssets.size()) || oldFilesAssets.size() < currentFilesAssets.size()) {
 			App->fileSystem->GetFilesFromDirectoryRecursive("/Library/", false, currentFilesLibrary);
+			std::vector<std::string> meshFiles;
+			std::vector<std::string> textureFiles;
 			for (std::map<std::string, std::string>::iterator iterator = currentFilesAssets.begin(); iterator != currentFilesAssets.end(); ++iterator) {
 				std::string fileName = (*iterator).first;
 				App->fileSystem->ChangePathSlashes(fileName);
@@ -30,14 +64,16 @@ void LibraryWatcher() {
 
 					std::string fullPath = (*iterator).second;
 					fullPath.append(fileName);
-					if (ext == "png" || ext == "tif") {
-						MaterialImporter::Import(fullPath.c_str());
+					if (ext == "png" || ext == "tif" || ext == "tga") {
+						textureFiles.push_back(fullPath);
 					}
 					if (ext == "fbx" || ext == "FBX") {
-						MeshImporter::ImportFBX(fullPath.c_str());
+						meshFiles.push_back(fullPath);
 					}
 				}
 			}
+			App->library->ImportTextureFiles(textureFiles);
+			App->library->ImportMeshFiles(meshFiles);
 			oldFilesAssets = currentFilesAssets;
 			App->library->UpdateMeshesList();
 			App->library->UpdateTexturesList();
@@ -45,30 +81,78 @@ void LibraryWatcher() {
 		} else if (oldFilesAssets.size() > currentFilesAssets.size()) {
 			oldFilesAssets = currentFilesAssets;
 		}
-		Sleep(1000);
+
+		lock.lock();
+		watcherCondition.wait_for(lock, std::chrono::seconds(1), []() { return stopWatcher; });
 	}
+	lock.unlock();
 	oldFilesAssets.clear();
 	currentFilesAssets.clear();
 	currentFilesLibrary.clear();
 }
 
 bool ModuleLibrary::Init() {
-
-	std::thread watcherThread(LibraryWatcher);
-
 	fileScenesList = new std::vector<std::string>();
 	fileMeshesList = new std::vector<std::string>();
 	fileTexturesList = new std::vector<std::string>();
 
-	watcherThread.detach();
-
 	UpdateMeshesList();
 	UpdateTexturesList();
 	UpdateScenesList();
 
+	// Started once the lists exist, it updates them after every import
+	watcher = std::thread(LibraryWatcher);
+
 	return true;
 }
 
+update_status ModuleLibrary::PreUpdate() {
+	BROFILER_CATEGORY("LibraryPreUpdate()", Profiler::Color::Coral);
+	Uint64 uploadStart = SDL_GetPerformanceCounter();
+	uploadedBytes = 0u;
+
+	// Uploaded in request order, so the first meshes asked for are the first to show up
+	for (std::list<ResourceMesh*>::iterator it = streamingMeshes.begin(); it != streamingMeshes.end();) {
+		ResourceMesh* resource = *it;
+		ResourceState state = resource->state;
+
+		if (state == ResourceState::LOADING) {
+			++it;
+			continue;
+		}
+
+		if (resource->references == 0u) {
+			delete resource;
+			it = streamingMeshes.erase(it);
+			continue;
+		}
+
+		if (state == ResourceState::LOADED) {
+			unsigned size = resource->UploadSize();
+			if (uploadedBytes > 0u && uploadedBytes + size > (unsigned)uploadBudget) {
+				break;
+			}
+
+			uploadedBytes += size;
+			if (resource->Upload()) {
+				OnMeshResident(resource);
+			}
+		}
+
+		// Failed meshes leave the cache so asking for them again retries, their components just stay empty
+		if (resource->state == ResourceState::FAILED) {
+			LOG("Error: Mesh %s cannot be loaded", resource->name.c_str());
+			meshResources.erase(resource->name);
+		}
+
+		it = streamingMeshes.erase(it);
+	}
+
+	uploadTime = (float)(SDL_GetPerformanceCounter() - uploadStart) * 1000.0f / (float)SDL_GetPerformanceFrequency();
+
+	return UPDATE_CONTINUE;
+}
+
 update_status ModuleLibrary::Update() {
 	BROFILER_CATEGORY("LibraryUpdate()", Profiler::Color::Coral);
 	if (toBeDeleted) {
@@ -84,14 +168,171 @@ update_status ModuleLibrary::Update() {
 }
 
 bool ModuleLibrary::CleanUp() {
-	stopWatcher = true;
+	StopWatcher();
+
 	fileScenesList->clear();
 	fileMeshesList->clear();
 	fileTexturesList->clear();
-	Sleep(1000);
+	App->jobs->Wait(streamCounter, JobPriority::BACKGROUND);
 	return true;
 }
 
+void ModuleLibrary::StopWatcher() {
+	{
+		std::lock_guard<std::mutex> lock(watcherMutex);
+		stopWatcher = true;
+	}
+	watcherCondition.notify_all();
+
+	// An import in progress finishes first, its jobs must not outlive the job system
+	if (watcher.joinable()) {
+		watcher.join();
+	}
+}
+
+void ModuleLibrary::ImportMeshFiles(const std::vector<std::string>& files) {
+	if (files.empty()) {
+		return;
+	}
+
+	Uint64 importStart = SDL_GetPerformanceCounter();
+	std::atomic<unsigned> importedFiles(0u);
+	std::atomic<unsigned> savedMeshes(0u);
+
+	JobCounter counter;
+	for (std::vector<std::string>::const_iterator it = files.begin(); it != files.end(); ++it) {
+		std::string file(*it);
+		unsigned filesNumber = files.size();
+		App->jobs->Submit([file, filesNumber, &importedFiles, &savedMeshes]() {
+			savedMeshes += MeshImporter::ImportFBX(file.c_str());
+			LOG("Imported %s (%u / %u files)", file.c_str(), ++importedFiles, filesNumber);
+		}, counter, JobPriority::BACKGROUND);
+	}
+	App->jobs->Wait(counter, JobPriority::BACKGROUND);
+
+	float importTime = (float)(SDL_GetPerformanceCounter() - importStart) * 1000.0f / (float)SDL_GetPerformanceFrequency();
+	LOG("Imported %u files with %u meshes in %.1f ms", files.size(), savedMeshes.load(), importTime);
+}
+
+void ModuleLibrary::ImportTextureFiles(const std::vector<std::string>& files) {
+	if (files.empty()) {
+		return;
+	}
+
+	Uint64 importStart = SDL_GetPerformanceCounter();
+	std::atomic<unsigned> cookedTextures(0u);
+
+	JobCounter counter;
+	for (std::vector<std::string>::const_iterator it = files.begin(); it != files.end(); ++it) {
+		std::string file(*it);
+		App->jobs->Submit([file, &cookedTextures]() {
+			if (MaterialImporter::Import(file.c_str())) {
+				++cookedTextures;
+			}
+		}, counter, JobPriority::BACKGROUND);
+	}
+	App->jobs->Wait(counter, JobPriority::BACKGROUND);
+
+	float importTime = (float)(SDL_GetPerformanceCounter() - importStart) * 1000.0f / (float)SDL_GetPerformanceFrequency();
+	LOG("Cooked %u of %u textures in %.1f ms on %u workers", cookedTextures.load(), files.size(), importTime, App->jobs->WorkersNumber());
+}
+
+ResourceMesh* ModuleLibrary::AcquireMesh(const char* name) {
+	// Empty mesh components are saved with no name
+	if (name == nullptr || *name == '\0') {
+		return nullptr;
+	}
+
+	std::map<std::string, ResourceMesh*>::iterator it = meshResources.find(name);
+	if (it != meshResources.end()) {
+		++it->second->references;
+		return it->second;
+	}
+
+	ResourceMesh* resource = new ResourceMesh(name);
+	resource->references = 1u;
+	meshResources[resource->name] = resource;
+	streamingMeshes.push_back(resource);
+
+	// The job is the last to touch the resource before the state changes
+	App->jobs->Submit([resource]() {
+		resource->state = resource->Load() ? ResourceState::LOADED : ResourceState::FAILED;
+	}, streamCounter, JobPriority::BACKGROUND);
+
+	return resource;
+}
+
+ResourceMesh* ModuleLibrary::AcquirePrimitive(GeometryType type, unsigned slices, unsigned stacks, float scale) {
+	// Angle brackets cannot be in a file name, keys never clash with library meshes
+	char key[64];
+	sprintf_s(key, "<primitive %d %ux%u %g>", (int)type, slices, stacks, scale);
+
+	std::map<std::string, ResourceMesh*>::iterator it = meshResources.find(key);
+	if (it != meshResources.end()) {
+		++it->second->references;
+		return it->second;
+	}
+
+	ResourceMesh* resource = new ResourceMesh(key);
+	if (!resource->Generate(type, slices, stacks, scale) || !resource->Upload()) {
+		LOG("Error: Primitive %s could not be generated", key);
+		delete resource;
+		return nullptr;
+	}
+
+	resource->references = 1u;
+	meshResources[resource->name] = resource;
+
+	return resource;
+}
+
+void ModuleLibrary::ReleaseMesh(ResourceMesh* resource) {
+	if (resource == nullptr || --resource->references > 0u) {
+		return;
+	}
+
+	// Library meshes and primitives alike, the next acquire loads or generates it again
+	std::map<std::string, ResourceMesh*>::iterator it = meshResources.find(resource->name);
+	if (it != meshResources.end() && it->second == resource) {
+		meshResources.erase(it);
+	}
+
+	// Its stream job may still be running, PreUpdate deletes it once it is done
+	if (std::find(streamingMeshes.begin(), streamingMeshes.end(), resource) != streamingMeshes.end()) {
+		return;
+	}
+
+	delete resource;
+}
+
+void ModuleLibrary::OnMeshResident(ResourceMesh* resource) const {
+	// The placeholder boxes are replaced by the real ones, static objects move in the quadtree with them
+	for (std::list<ComponentMesh*>::iterator it = App->renderer->meshes.begin(); it != App->renderer->meshes.end(); ++it) {
+		if ((*it)->resource != resource) {
+			continue;
+		}
+
+		GameObject* gameObject = (*it)->goContainer;
+		if (gameObject->staticGo) {
+			App->scene->quadTree->Remove(gameObject);
+			gameObject->ComputeBBox();
+			App->scene->quadTree->Insert(gameObject, true);
+		} else {
+			gameObject->ComputeBBox();
+		}
+	}
+}
+
+void ModuleLibrary::DrawGUI() {
+	int budgetKb = uploadBudget / 1024;
+	if (ImGui::SliderInt("Upload budget (KB per frame)", &budgetKb, 64, 16 * 1024)) {
+		uploadBudget = budgetKb * 1024;
+	}
+	ImGui::Text("Streaming meshes: %u", streamingMeshes.size());
+	ImGui::Text("Uploaded last frame: %.1f KB in %.3f ms", (float)uploadedBytes / 1024.0f, uploadTime);
+	ImGui::Text("Resident meshes: %u", meshResources.size());
+}
+
 void ModuleLibrary::UpdateMeshesList() {
 	fileMeshesList->clear();
 	App->fileSystem->GetFilesFromDirectory("/Library/Meshes/", *fileMeshesList);
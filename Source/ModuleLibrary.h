@@ -5,6 +5,13 @@
 #include "map"
 #include "vector"
 #include "string"
+#include "list"
+#include <atomic>
+#include <thread>
+#include "JobSystem.h"
+
+class ResourceMesh;
+enum class GeometryType;
 
 class ModuleLibrary : public Module
 {
@@ -13,6 +20,7 @@ class ModuleLibrary : public Module
 		~ModuleLibrary();
 
 		bool Init() override;
+		update_status PreUpdate() override;
 		update_status Update() override;
 		bool CleanUp() override;
 
@@ -20,6 +28,22 @@ class ModuleLibrary : public Module
 		void UpdateTexturesList();
 		void UpdateScenesList();
 
+		// Blocks until every file is imported, files run concurrently and so do the meshes inside each of them
+		void ImportMeshFiles(const std::vector<std::string>& files);
+
+		// Blocks until every texture is cooked, one import job per texture
+		void ImportTextureFiles(const std::vector<std::string>& files);
+
+		// Streams the mesh in the first time it is asked for, every call adds a reference to release.
+		// The resource returned is pending until it is uploaded in a later frame.
+		ResourceMesh* AcquireMesh(const char* name);
+		void ReleaseMesh(ResourceMesh* resource);
+
+		// Generated once per type, tessellation and scale and shared like any library mesh, it is resident right away
+		ResourceMesh* AcquirePrimitive(GeometryType type, unsigned slices, unsigned stacks, float scale);
+
+		void DrawGUI();
+
 	public:
 		bool					 toBeDeleted = false;
 		bool			  		 removeHead = false;
@@ -27,6 +51,29 @@ class ModuleLibrary : public Module
 		std::vector<std::string>* fileTexturesList = nullptr;
 		std::vector<std::string>* fileScenesList = nullptr;
 
+		// Only grow, the import is running while they differ
+		std::atomic<unsigned>	 meshesToImport;
+		std::atomic<unsigned>	 importedMeshes;
+
+		// Bytes of decoded meshes uploaded per frame, one mesh is always uploaded even if it is bigger
+		int						 uploadBudget = 2 * 1024 * 1024;
+
+	private:
+		void OnMeshResident(ResourceMesh* resource) const;
+		void StopWatcher();
+
+	private:
+		std::map<std::string, ResourceMesh*> meshResources;
+
+		// Imports whatever appears in Assets, joined on CleanUp
+		std::thread				 watcher;
+
+		// Mesh loads run as background jobs, a frame only pays for the uploads
+		JobCounter				 streamCounter;
+		std::list<ResourceMesh*> streamingMeshes;
+		unsigned				 uploadedBytes = 0u;
+		float					 uploadTime = 0.0f;
+
 };
 
 #endif
@@ -1,49 +1,153 @@
 #include "ModuleProgram.h"
+#include "Application.h"
+#include "ModuleRender.h"
+#include "ModuleFileSystem.h"
+#include "GLStateCache.h"
+#include "SDL\include\SDL.h"
+#include "imgui.h"
+#include <sys/stat.h>
+#include <string>
+
+#define PROGRAM_BINARY_MAGIC 0x42475250u // "PRGB"
+#define FNV_OFFSET 14695981039346656037ull
+#define FNV_PRIME 1099511628211ull
+
+struct ProgramBinaryHeader {
+	unsigned			magic = PROGRAM_BINARY_MAGIC;
+	unsigned			format = 0u;
+	unsigned long long	key = 0u;
+	unsigned			size = 0u;
+	unsigned			padding = 0u;
+};
+
+static unsigned long long HashString(unsigned long long hash, const char* str) {
+	if (str != nullptr) {
+		for (const unsigned char* c = (const unsigned char*)str; *c != '\0'; ++c) {
+			hash ^= *c;
+			hash *= FNV_PRIME;
+		}
+	}
+
+	// Terminator included so "ab" + "c" and "a" + "bc" do not collide
+	return hash * FNV_PRIME;
+}
+
+static long long GetModifiedTime(const char* path) {
+	struct stat fileStat;
+
+	if (stat(path, &fileStat) != 0) {
+		return 0;
+	}
+
+	return (long long)fileStat.st_mtime;
+}
+
+static ProgramSource MakeSource(const char* name, const char* vertShaderPath, const char* fragShaderPath, unsigned* program) {
+	ProgramSource source;
+	source.name = name;
+	source.vertShaderPath = vertShaderPath;
+	source.fragShaderPath = fragShaderPath;
+	source.program = program;
+
+	return source;
+}
 
 ModuleProgram::ModuleProgram() { }
 
 ModuleProgram::~ModuleProgram() { }
 
 bool ModuleProgram::LoadPrograms() {
-	// TODO: this should be pushed back to a vector
-	colorProgram = LoadProgram("./Shaders/color.vs", "./Shaders/color.fs");
-	textureProgram = LoadProgram("./Shaders/texture.vs", "./Shaders/texture.fs");
-	blinnProgram = LoadProgram("./Shaders/blinn.vs", "./Shaders/blinn.fs");
+	Uint64 loadStart = SDL_GetPerformanceCounter();
 
-	return (colorProgram != 0 && textureProgram != 0 && blinnProgram != 0);
-}
+	sources.clear();
+	sources.push_back(MakeSource("color", "./Shaders/color.vs", "./Shaders/color.fs", &colorProgram));
+	sources.push_back(MakeSource("texture", "./Shaders/texture.vs", "./Shaders/texture.fs", &textureProgram));
+	sources.push_back(MakeSource("blinn", "./Shaders/blinn.vs", "./Shaders/blinn.fs", &blinnProgram));
 
-unsigned ModuleProgram::LoadProgram(const char* vertShaderPath, const char* fragShaderPath) {
-	unsigned program = 0u;
+	int binaryFormats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binaryFormats);
+	binaryCache = GLEW_ARB_get_program_binary != 0 && binaryFormats > 0;
 
-	// How to: https://badvertex.com/2012/11/20/how-to-load-a-glsl-shader-in-opengl-using-c.html
-	unsigned vertShader = glCreateShader(GL_VERTEX_SHADER);
-	unsigned fragShader = glCreateShader(GL_FRAGMENT_SHADER);
+	parallelCompile = GLEW_ARB_parallel_shader_compile != 0;
+	if (parallelCompile) {
+		glMaxShaderCompilerThreadsARB(0xFFFFFFFFu);
+	}
 
-	char* vertShaderStr = ReadShaderFile(vertShaderPath);
-	char* fragShaderStr = ReadShaderFile(fragShaderPath);
+	// Binaries are only valid for the driver that produced them
+	driverHash = HashString(FNV_OFFSET, (const char*)glGetString(GL_VENDOR));
+	driverHash = HashString(driverHash, (const char*)glGetString(GL_RENDERER));
+	driverHash = HashString(driverHash, (const char*)glGetString(GL_VERSION));
+	driverHash = HashString(driverHash, (const char*)glGetString(GL_SHADING_LANGUAGE_VERSION));
 
-	if (CompileShader(vertShader, vertShaderStr) && CompileShader(fragShader, fragShaderStr)) {
+	if (binaryCache && !App->fileSystem->Exists(PROGRAM_CACHE_FOLDER)) {
+		App->fileSystem->MakeDirectory(PROGRAM_CACHE_FOLDER);
+	}
 
-		program = glCreateProgram();
+	cachedPrograms = 0u;
+	std::vector<ProgramBuild> builds;
+
+	for (unsigned i = 0u; i < sources.size(); ++i) {
+		ProgramSource& source = sources[i];
+		source.vertModified = GetModifiedTime(source.vertShaderPath);
+		source.fragModified = GetModifiedTime(source.fragShaderPath);
+
+		char* vertShaderStr = ReadShaderFile(source.vertShaderPath);
+		char* fragShaderStr = ReadShaderFile(source.fragShaderPath);
+
+		if (vertShaderStr != nullptr && fragShaderStr != nullptr) {
+			unsigned long long key = HashSources(vertShaderStr, fragShaderStr);
+			*source.program = LoadCachedProgram(source.name, key);
+
+			if (*source.program != 0u) {
+				BindUniformBlocks(*source.program);
+				++cachedPrograms;
+			} else {
+				ProgramBuild build;
+				build.sourceIndex = i;
+				build.key = key;
+				StartBuild(build, vertShaderStr, fragShaderStr);
+				builds.push_back(build);
+			}
+		}
 
-		glAttachShader(program, vertShader);
-		glAttachShader(program, fragShader);
+		delete[] vertShaderStr;
+		delete[] fragShaderStr;
+	}
 
-		glLinkProgram(program);
+	// Every compile is queued before checking any, with parallel compile the driver works on all of them at once
+	for (std::vector<ProgramBuild>::iterator it = builds.begin(); it != builds.end(); ++it) {
+		ProgramSource& source = sources[it->sourceIndex];
+		*source.program = FinishBuild(*it);
 
-		CompileProgram(program);
+		if (*source.program != 0u) {
+			BindUniformBlocks(*source.program);
+			SaveCachedProgram(source.name, it->key, *source.program);
+		}
 	}
-	
-	glDeleteShader(vertShader);
-	glDeleteShader(fragShader);
-	// Remove shaders, we wont need them anymore if they are loaded correctly into Program
-	delete[] vertShaderStr; 
-	delete[] fragShaderStr;
-	vertShaderStr = nullptr;
-	fragShaderStr = nullptr;
 
-	return program;
+	loadTime = (float)(SDL_GetPerformanceCounter() - loadStart) * 1000.0f / (float)SDL_GetPerformanceFrequency();
+	LOG("Programs loaded in %.2f ms, %u of %u from the binary cache", loadTime, cachedPrograms, sources.size());
+
+	lastWatch = SDL_GetTicks();
+
+	return (colorProgram != 0 && textureProgram != 0 && blinnProgram != 0);
+}
+
+update_status ModuleProgram::Update() {
+	BROFILER_CATEGORY("ProgramUpdate()", Profiler::Color::DarkOrchid);
+	if (App->headless) {
+		return UPDATE_CONTINUE;
+	}
+
+	// Builds are checked a frame after they start, without parallel compile the driver still gets that frame before the status query blocks
+	SwapReloadedPrograms();
+
+	if (hotReload && SDL_GetTicks() - lastWatch >= PROGRAM_WATCH_INTERVAL) {
+		lastWatch = SDL_GetTicks();
+		WatchSources();
+	}
+
+	return UPDATE_CONTINUE;
 }
 
 char* ModuleProgram::ReadShaderFile(const char* shaderPath) {
@@ -54,11 +158,12 @@ char* ModuleProgram::ReadShaderFile(const char* shaderPath) {
 		fseek(file, 0, SEEK_END);
 		int size = ftell(file);
 		rewind(file);
-		shaderData = (char*)malloc(size + 1);
+		shaderData = new char[size + 1];
 		int res = fread(shaderData, 1, size, file);
 		shaderData[size] = 0;
 		if (res != size) {
 			LOG("Error: Shader not loaded correctly");
+			delete[] shaderData;
 			shaderData = nullptr;
 		}
 		fclose(file);
@@ -70,13 +175,78 @@ char* ModuleProgram::ReadShaderFile(const char* shaderPath) {
 	return shaderData;
 }
 
-bool ModuleProgram::CompileShader(unsigned shaderAddress, const char* shaderContent) {
-	assert(shaderContent != nullptr);
+unsigned long long ModuleProgram::HashSources(const char* vertShaderStr, const char* fragShaderStr) const {
+	return HashString(HashString(driverHash, vertShaderStr), fragShaderStr);
+}
 
-	int compiled = GL_FALSE;
+void ModuleProgram::StartBuild(ProgramBuild& build, const char* vertShaderStr, const char* fragShaderStr) const {
+	assert(vertShaderStr != nullptr && fragShaderStr != nullptr);
+
+	// How to: https://badvertex.com/2012/11/20/how-to-load-a-glsl-shader-in-opengl-using-c.html
+	build.vertShader = glCreateShader(GL_VERTEX_SHADER);
+	build.fragShader = glCreateShader(GL_FRAGMENT_SHADER);
+
+	glShaderSource(build.vertShader, 1, &vertShaderStr, NULL);
+	glShaderSource(build.fragShader, 1, &fragShaderStr, NULL);
+	glCompileShader(build.vertShader);
+	glCompileShader(build.fragShader);
+
+	build.program = glCreateProgram();
+	if (binaryCache) {
+		glProgramParameteri(build.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+
+	glAttachShader(build.program, build.vertShader);
+	glAttachShader(build.program, build.fragShader);
+
+	// Status is not queried here, that would block until the driver finishes
+	glLinkProgram(build.program);
+}
+
+bool ModuleProgram::IsBuildReady(const ProgramBuild& build) const {
+	if (!parallelCompile) {
+		return true;
+	}
+
+	int completed = GL_FALSE;
+	glGetProgramiv(build.program, GL_COMPLETION_STATUS_ARB, &completed);
+
+	return completed == GL_TRUE;
+}
+
+unsigned ModuleProgram::FinishBuild(ProgramBuild& build) const {
+	bool vertCompiled = CheckShaderStatus(build.vertShader);
+	bool fragCompiled = CheckShaderStatus(build.fragShader);
+	bool linked = vertCompiled && fragCompiled && CheckLinkStatus(build.program);
+
+	unsigned program = build.program;
+	DiscardBuild(build);
+
+	if (!linked) {
+		glDeleteProgram(program); // Don't leak the program.
+		program = 0u;
+	}
+
+	return program;
+}
 
-	glShaderSource(shaderAddress, 1, &shaderContent, NULL);
-	glCompileShader(shaderAddress);
+void ModuleProgram::DiscardBuild(ProgramBuild& build) const {
+	// Remove shaders, we wont need them anymore if they are loaded correctly into Program
+	if (build.program != 0u) {
+		glDetachShader(build.program, build.vertShader);
+		glDetachShader(build.program, build.fragShader);
+	}
+
+	glDeleteShader(build.vertShader);
+	glDeleteShader(build.fragShader);
+
+	build.program = 0u;
+	build.vertShader = 0u;
+	build.fragShader = 0u;
+}
+
+bool ModuleProgram::CheckShaderStatus(unsigned shaderAddress) const {
+	int compiled = GL_FALSE;
 	glGetShaderiv(shaderAddress, GL_COMPILE_STATUS, &compiled);
 
 	if (!compiled) {
@@ -92,33 +262,217 @@ bool ModuleProgram::CompileShader(unsigned shaderAddress, const char* shaderCont
 			delete[] strInfoLog;
 			strInfoLog = nullptr;
 		}
+	}
+
+	return compiled == GL_TRUE;
+}
+
+bool ModuleProgram::CheckLinkStatus(unsigned programAddress) const {
+	int linked = GL_FALSE;
+	glGetProgramiv(programAddress, GL_LINK_STATUS, &linked);
+
+	if (!linked) {
+		int errorLength = 0;
+		glGetProgramiv(programAddress, GL_INFO_LOG_LENGTH, &errorLength);
+
+		if (errorLength > 0) {
+			GLchar* strInfoLog = new GLchar[errorLength + 1];
+			glGetProgramInfoLog(programAddress, errorLength, NULL, strInfoLog);
+
+			LOG("Error: Program compilation failed at %s", strInfoLog);
+
+			delete[] strInfoLog;
+			strInfoLog = nullptr;
+		}
+	}
+
+	return linked == GL_TRUE;
+}
+
+void ModuleProgram::BindUniformBlocks(unsigned programAddress) const {
+	// Linking, binary loads included, resets block bindings, so every new program goes through here
+	unsigned blockIndex = glGetUniformBlockIndex(programAddress, "Matrices");
+
+	if (blockIndex != GL_INVALID_INDEX) {
+		glUniformBlockBinding(programAddress, blockIndex, 0);
+	}
+}
+
+unsigned ModuleProgram::LoadCachedProgram(const char* name, unsigned long long key) const {
+	if (!binaryCache) {
+		return 0u;
+	}
+
+	std::string path(PROGRAM_CACHE_FOLDER);
+	path.append(name);
+	path.append(".bin");
+
+	if (!App->fileSystem->Exists(path.c_str())) {
+		return 0u;
+	}
+
+	char* buffer = nullptr;
+	unsigned size = App->fileSystem->Load(path.c_str(), &buffer);
+	unsigned program = 0u;
+
+	if (buffer != nullptr && size > sizeof(ProgramBinaryHeader)) {
+		const ProgramBinaryHeader* header = (const ProgramBinaryHeader*)buffer;
+
+		// A different key means the sources or the driver changed since the binary was saved
+		if (header->magic == PROGRAM_BINARY_MAGIC && header->key == key && header->size == size - sizeof(ProgramBinaryHeader)) {
+			program = glCreateProgram();
+			glProgramBinary(program, header->format, buffer + sizeof(ProgramBinaryHeader), header->size);
+
+			int linked = GL_FALSE;
+			glGetProgramiv(program, GL_LINK_STATUS, &linked);
+
+			if (!linked) {
+				LOG("Warning: Cached program %s rejected by the driver, compiling it", name);
+				glDeleteProgram(program);
+				program = 0u;
+			}
+		}
+	}
+
+	delete[] buffer;
+	buffer = nullptr;
+
+	return program;
+}
+
+void ModuleProgram::SaveCachedProgram(const char* name, unsigned long long key, unsigned programAddress) const {
+	if (!binaryCache) {
+		return;
+	}
 
-		glDeleteShader(shaderAddress); // Don't leak the shader.
+	int length = 0;
+	glGetProgramiv(programAddress, GL_PROGRAM_BINARY_LENGTH, &length);
+
+	if (length <= 0) {
+		return;
 	}
 
-	return compiled;
+	char* buffer = new char[sizeof(ProgramBinaryHeader) + length];
+	ProgramBinaryHeader header;
+	header.key = key;
+
+	GLsizei written = 0;
+	GLenum format = 0;
+	glGetProgramBinary(programAddress, length, &written, &format, buffer + sizeof(ProgramBinaryHeader));
+
+	header.format = format;
+	header.size = written;
+	memcpy(buffer, &header, sizeof(ProgramBinaryHeader));
+
+	std::string path(PROGRAM_CACHE_FOLDER);
+	path.append(name);
+	path.append(".bin");
+
+	App->fileSystem->Save(path.c_str(), buffer, sizeof(ProgramBinaryHeader) + written, false);
+
+	delete[] buffer;
+	buffer = nullptr;
+}
+
+void ModuleProgram::WatchSources() {
+	for (unsigned i = 0u; i < sources.size(); ++i) {
+		ProgramSource& source = sources[i];
+		long long vertModified = GetModifiedTime(source.vertShaderPath);
+		long long fragModified = GetModifiedTime(source.fragShaderPath);
+
+		if (vertModified != source.vertModified || fragModified != source.fragModified) {
+			source.vertModified = vertModified;
+			source.fragModified = fragModified;
+			ReloadProgram(i);
+		}
+	}
 }
 
-void ModuleProgram::CompileProgram(unsigned programAddress) {
-	int errorLength = 0;
+void ModuleProgram::ReloadProgram(unsigned sourceIndex) {
+	const ProgramSource& source = sources[sourceIndex];
+
+	char* vertShaderStr = ReadShaderFile(source.vertShaderPath);
+	char* fragShaderStr = ReadShaderFile(source.fragShaderPath);
+
+	if (vertShaderStr != nullptr && fragShaderStr != nullptr) {
+		// A newer edit replaces a build still in flight
+		for (std::vector<ProgramBuild>::iterator it = reloads.begin(); it != reloads.end(); ++it) {
+			if (it->sourceIndex == sourceIndex) {
+				unsigned program = it->program;
+				DiscardBuild(*it);
+				glDeleteProgram(program);
+				reloads.erase(it);
+				break;
+			}
+		}
+
+		ProgramBuild build;
+		build.sourceIndex = sourceIndex;
+		build.key = HashSources(vertShaderStr, fragShaderStr);
+		StartBuild(build, vertShaderStr, fragShaderStr);
+		reloads.push_back(build);
+
+		LOG("Recompiling program %s", source.name);
+	}
+
+	delete[] vertShaderStr;
+	delete[] fragShaderStr;
+}
 
-	glGetProgramiv(programAddress, GL_COMPILE_STATUS, &errorLength);
+void ModuleProgram::SwapReloadedPrograms() {
+	for (std::vector<ProgramBuild>::iterator it = reloads.begin(); it != reloads.end();) {
+		if (!IsBuildReady(*it)) {
+			++it;
+			continue;
+		}
 
-	if (errorLength > 0) {
-		GLchar* strInfoLog = new GLchar[errorLength + 1];
-		glGetProgramInfoLog(programAddress, errorLength, NULL, strInfoLog);
+		ProgramSource& source = sources[it->sourceIndex];
+		unsigned long long key = it->key;
+		unsigned program = FinishBuild(*it);
+
+		if (program != 0u) {
+			BindUniformBlocks(program);
+			SaveCachedProgram(source.name, key, program);
+			App->renderer->glState->DeleteProgram(*source.program);
+			*source.program = program;
+			LOG("Program %s reloaded", source.name);
+		} else {
+			LOG("Error: Program %s failed to build, keeping the previous one", source.name);
+		}
 
-		LOG("Error: Program compilation failed at %s", strInfoLog);
+		it = reloads.erase(it);
+	}
+}
 
-		delete[] strInfoLog;
-		strInfoLog = nullptr;
+void ModuleProgram::DrawGUI() {
+	ImGui::Text("Binary cache: %s", binaryCache ? "yes" : "no");
+	ImGui::Text("Parallel compile: %s", parallelCompile ? "yes" : "no");
+	ImGui::Text("Startup load: %.2f ms, %u of %u cached", loadTime, cachedPrograms, sources.size());
+	ImGui::Checkbox("Hot reload", &hotReload);
 
-		glDeleteProgram(programAddress); // Don't leak the program.
+	if (ImGui::Button("Reload all")) {
+		for (unsigned i = 0u; i < sources.size(); ++i) {
+			ReloadProgram(i);
+		}
 	}
 
+	if (!reloads.empty()) {
+		ImGui::Text("Compiling: %u", reloads.size());
+	}
 }
 
 bool ModuleProgram::CleanUp() {
+	if (App->headless) {
+		return true;
+	}
+
+	for (std::vector<ProgramBuild>::iterator it = reloads.begin(); it != reloads.end(); ++it) {
+		unsigned program = it->program;
+		DiscardBuild(*it);
+		glDeleteProgram(program);
+	}
+	reloads.clear();
+
 	glDeleteProgram(colorProgram);
 	glDeleteProgram(textureProgram);
 	glDeleteProgram(blinnProgram);
@@ -4,6 +4,28 @@
 #include "Module.h"
 #include "assert.h"
 #include "glew-2.1.0\include\GL\glew.h"
+#include <vector>
+
+#define PROGRAM_CACHE_FOLDER "/Library/Shaders/"
+#define PROGRAM_WATCH_INTERVAL 1000u
+
+struct ProgramSource {
+	const char*			name = nullptr;
+	const char*			vertShaderPath = nullptr;
+	const char*			fragShaderPath = nullptr;
+	unsigned*			program = nullptr;
+	long long			vertModified = 0;
+	long long			fragModified = 0;
+};
+
+// Program being compiled and linked, with parallel compile it is only checked once the driver is done
+struct ProgramBuild {
+	unsigned			sourceIndex = 0u;
+	unsigned			program = 0u;
+	unsigned			vertShader = 0u;
+	unsigned			fragShader = 0u;
+	unsigned long long	key = 0u;
+};
 
 class ModuleProgram : public Module
 {
@@ -11,19 +33,47 @@ class ModuleProgram : public Module
 		ModuleProgram();
 		~ModuleProgram();
 
-		bool		CleanUp() override;
-		bool		LoadPrograms();
+		update_status	Update() override;
+		bool			CleanUp() override;
+		bool			LoadPrograms();
+
+		void			DrawGUI();
 
 	public:
 		unsigned	colorProgram = 0u;
 		unsigned	textureProgram = 0u;
 		unsigned	blinnProgram = 0u;
 
+		bool		hotReload = true;
+		bool		binaryCache = false;
+		bool		parallelCompile = false;
+		float		loadTime = 0.0f;
+		unsigned	cachedPrograms = 0u;
+
+	private:
+		char*				ReadShaderFile(const char* shaderPath);
+		unsigned long long	HashSources(const char* vertShaderStr, const char* fragShaderStr) const;
+
+		void				StartBuild(ProgramBuild& build, const char* vertShaderStr, const char* fragShaderStr) const;
+		bool				IsBuildReady(const ProgramBuild& build) const;
+		unsigned			FinishBuild(ProgramBuild& build) const;
+		void				DiscardBuild(ProgramBuild& build) const;
+		bool				CheckShaderStatus(unsigned shaderAddress) const;
+		bool				CheckLinkStatus(unsigned programAddress) const;
+		void				BindUniformBlocks(unsigned programAddress) const;
+
+		unsigned			LoadCachedProgram(const char* name, unsigned long long key) const;
+		void				SaveCachedProgram(const char* name, unsigned long long key, unsigned programAddress) const;
+
+		void				WatchSources();
+		void				ReloadProgram(unsigned sourceIndex);
+		void				SwapReloadedPrograms();
+
 	private:
-		unsigned	LoadProgram(const char* vertShaderPath, const char* fragShaderPath);
-		char*		ReadShaderFile(const char* shaderPath);
-		bool		CompileShader(unsigned shaderAddress, const char* shaderContent);
-		void		CompileProgram(unsigned programAddress);
+		std::vector<ProgramSource>	sources;
+		std::vector<ProgramBuild>	reloads;
+		unsigned long long			driverHash = 0u;
+		unsigned					lastWatch = 0u;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -12,11 +12,19 @@
 #include "ComponentCamera.h"
 #include "ComponentMesh.h"
 #include "ComponentMaterial.h"
+#include "ComponentTransform.h"
+#include "GeometryArena.h"
+#include "GLStateCache.h"
+#include "GLRenderBackend.h"
+#include "RecordingRenderBackend.h"
+#include "JobSystem.h"
+#include <algorithm>
 #include "SDL\include\SDL.h"
 #include "glew-2.1.0\include\GL\glew.h"
 #include "debugdraw.h"
 #include "IMGUI\imgui_internal.h"
 #include "MathGeoLib\include\Math\float4x4.h"
+#include "Geometry/Plane.h"
 
 ModuleRender::ModuleRender() { }
 
@@ -27,6 +35,17 @@ ModuleRender::~ModuleRender() { }
 bool ModuleRender::Init() {
 	LOG("Creating Renderer context");
 
+	glState = new GLStateCache();
+	arena = new GeometryArena();
+
+	if (App->headless) {
+		// No window nor context, submission is only recorded
+		LOG("Renderer running headless, draw calls will be recorded");
+		arena->Init(false);
+		backend = new RecordingRenderBackend();
+		return true;
+	}
+
 	InitSDL();
 	glewInit();
 	InitOpenGL();
@@ -39,12 +58,42 @@ bool ModuleRender::Init() {
 	GenerateBlockUniforms();
 	GenerateFallBackMaterial();
 
+	arena->Init(true);
+
+	// The fallback draws read the commands from client memory, only multi draw needs them in a buffer
+	multiDrawIndirect = GLEW_ARB_multi_draw_indirect != 0;
+	if (multiDrawIndirect) {
+		glGenBuffers(1, &indirectBuffer);
+	} else {
+		LOG("Warning: glMultiDrawElementsIndirect not supported, falling back to one draw per command");
+	}
+
+	// The fallback draws need base vertices at least, base instances save rebinding the instance attributes per command
+	bool baseInstance = GLEW_ARB_base_instance != 0;
+	if (!multiDrawIndirect && !baseInstance) {
+		if (!GLEW_ARB_draw_elements_base_vertex) {
+			LOG("Error: Neither GL_ARB_base_instance nor GL_ARB_draw_elements_base_vertex are supported, meshes cannot be drawn");
+			return false;
+		}
+		LOG("Warning: GL_ARB_base_instance not supported, instance attributes are rebound for every draw");
+	}
+
+	backend = new GLRenderBackend(glState, multiDrawIndirect, baseInstance, arena->instanceVbo);
+
 	return true;
 }
 
 update_status ModuleRender::PreUpdate() {
 	BROFILER_CATEGORY("RenderPreUpdate()", Profiler::Color::AliceBlue);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	glState->ResetCounters();
+	backend->BeginFrame();
+	uploadedQueue = nullptr;
+	backend->BindFramebuffer(0);
+	backend->Clear(0.1f, 0.1f, 0.1f, 1.0f);
+
+	if (arena->NeedsDefragment()) {
+		arena->Defragment();
+	}
 
 	return UPDATE_CONTINUE;
 }
@@ -52,36 +101,52 @@ update_status ModuleRender::PreUpdate() {
 // Called every draw update
 update_status ModuleRender::Update() {
 	BROFILER_CATEGORY("RenderUpdate()", Profiler::Color::Aqua);
-	glBindFramebuffer(GL_FRAMEBUFFER, App->camera->sceneCamera->fbo);
-	glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	glPolygonMode(GL_FRONT_AND_BACK, App->camera->sceneCamera->wireFrame);
-	SetProjectionMatrix(App->camera->sceneCamera);
-	SetViewMatrix(App->camera->sceneCamera);
+	Uint64 submissionStart = SDL_GetPerformanceCounter();
 
-	if (frustCulling && App->camera->selectedCamera != nullptr) {
-		DrawMeshes(App->camera->selectedCamera);
-	} else {
-		DrawMeshes(App->camera->sceneCamera);
+	ComponentCamera* selectedCamera = App->camera->selectedCamera;
+	views[VIEW_SCENE].cullingCamera = (frustCulling && selectedCamera != nullptr) ? selectedCamera : App->camera->sceneCamera;
+	views[VIEW_GAME].cullingCamera = selectedCamera;
+
+	// Culling and queues do not depend on the view matrices, only views culled by the same camera share the result
+	sharedCulling = selectedCamera != nullptr && views[VIEW_SCENE].cullingCamera == views[VIEW_GAME].cullingCamera;
+
+	// Levels follow the game camera when there is one, both views draw the same level
+	ComponentCamera* lodCamera = (selectedCamera != nullptr) ? selectedCamera : App->camera->sceneCamera;
+	for (std::list<ComponentMesh*>::iterator it = meshes.begin(); it != meshes.end(); ++it) {
+		(*it)->UpdateLod(lodCamera->frustum, lodThresholds, lodHysteresis, lodEnabled);
 	}
 
-	DrawDebugData(App->camera->sceneCamera);
+	JobCounter counter;
+	App->jobs->Submit([this]() { PrepareView(views[VIEW_SCENE]); }, counter);
+	if (selectedCamera != nullptr && !sharedCulling) {
+		App->jobs->Submit([this]() { PrepareView(views[VIEW_GAME]); }, counter);
+	}
+	App->jobs->Wait(counter);
 
-	if (App->camera->selectedCamera != nullptr) {
-		glBindFramebuffer(GL_FRAMEBUFFER, App->camera->selectedCamera->fbo);
-		glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		glPolygonMode(GL_FRONT_AND_BACK, App->camera->selectedCamera->wireFrame);
-		SetProjectionMatrix(App->camera->selectedCamera);
-		SetViewMatrix(App->camera->selectedCamera);
-		DrawMeshes(App->camera->selectedCamera);
-		DrawDebugData(App->camera->selectedCamera);
+	const RenderView& sceneView = views[VIEW_SCENE];
+	const RenderView& gameView = sharedCulling ? views[VIEW_SCENE] : views[VIEW_GAME];
+
+	backend->BindFramebuffer(App->camera->sceneCamera->fbo);
+	backend->Clear(0.1f, 0.1f, 0.1f, 1.0f);
+	backend->PolygonMode(App->camera->sceneCamera->wireFrame);
+	SetProjectionMatrix(App->camera->sceneCamera);
+	SetViewMatrix(App->camera->sceneCamera);
+	SubmitRenderQueue(sceneView.queue);
+	DrawDebugData(App->camera->sceneCamera, sceneView);
+
+	if (selectedCamera != nullptr) {
+		backend->BindFramebuffer(selectedCamera->fbo);
+		backend->Clear(0.1f, 0.1f, 0.1f, 1.0f);
+		backend->PolygonMode(selectedCamera->wireFrame);
+		SetProjectionMatrix(selectedCamera);
+		SetViewMatrix(selectedCamera);
+		SubmitRenderQueue(gameView.queue);
+		DrawDebugData(selectedCamera, gameView);
 	}
 
  	if (showQuad && App->camera->quadCamera != nullptr) {
-		glBindFramebuffer(GL_FRAMEBUFFER, App->camera->quadCamera->fbo);
-		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		backend->BindFramebuffer(App->camera->quadCamera->fbo);
+		backend->Clear(0.0f, 0.0f, 0.0f, 1.0f);
 
 		SetProjectionMatrix(App->camera->quadCamera);
 		SetViewMatrix(App->camera->quadCamera);
@@ -90,24 +155,32 @@ update_status ModuleRender::Update() {
 		App->debug->Draw(App->camera->quadCamera, App->camera->quadCamera->fbo, App->camera->quadCamera->screenWidth, App->camera->quadCamera->screenHeight);
 	}
 
-	//So we exclude the rest of the quad rendered background of the color selected
-	glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+	backend->BindFramebuffer(0);
+
+	submissionTime = (float)(SDL_GetPerformanceCounter() - submissionStart) * 1000.0f / (float)SDL_GetPerformanceFrequency();
 
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 	return UPDATE_CONTINUE;
 }
 
 update_status ModuleRender::PostUpdate() {
 	BROFILER_CATEGORY("RenderPostUpdate()", Profiler::Color::Orchid);
+	if (App->headless) {
+		return UpdateBenchmark();
+	}
+
 	App->editor->RenderGUI();
+	// ImGui backend binds its own program, buffers and textures
+	glState->Invalidate();
 	SDL_GL_SwapWindow(App->window->window);
 
 	return UPDATE_CONTINUE;
 }
 
-void ModuleRender::DrawDebugData(ComponentCamera* camera) const {
+void ModuleRender::DrawDebugData(ComponentCamera* camera, const RenderView& view) const {
 	BROFILER_CATEGORY("DrawDebugData()", Profiler::Color::Orange);
-	if (camera->debugDraw == false) return;
+	if (camera->debugDraw == false || App->headless) return;
+
+	DrawViewDebugData(view);
 
 	//TODO: probably we can render every frustum and paint the active in green
 	if (App->camera->selectedCamera != nullptr) {
@@ -123,7 +196,7 @@ void ModuleRender::DrawDebugData(ComponentCamera* camera) const {
 	}
 
 	//Grid and axis debug
-	dd::xzSquareGrid(-42.0f * App->scene->scaleFactor, 42.0f * App->scene->scaleFactor, 0.0f, 0.1f * App->scene->scaleFactor, math::float3(0.65f, 0.65f, 0.65f));
+	App->debug->Grid(-42.0f * App->scene->scaleFactor, 42.0f * App->scene->scaleFactor, 0.0f, 0.1f * App->scene->scaleFactor, math::float3(0.65f, 0.65f, 0.65f));
 	dd::axisTriad(math::float4x4::identity, 0.01f * App->scene->scaleFactor, .1f * App->scene->scaleFactor, 0, true);
 
 	if (showQuad) {
@@ -138,30 +211,18 @@ void ModuleRender::DrawDebugData(ComponentCamera* camera) const {
 }
 
 void ModuleRender::SetViewMatrix(ComponentCamera* camera) const {
-	glBindBuffer(GL_UNIFORM_BUFFER, ubo);
-	glBufferSubData(GL_UNIFORM_BUFFER, sizeof(math::float4x4), sizeof(math::float4x4), &camera->GetViewMatrix()[0][0]);
-	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	backend->UpdateUniformBuffer(ubo, sizeof(math::float4x4), sizeof(math::float4x4), &camera->GetViewMatrix()[0][0]);
 }
 
 void ModuleRender::SetProjectionMatrix(ComponentCamera* camera) const {
-	glBindBuffer(GL_UNIFORM_BUFFER, ubo);
-	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(math::float4x4), &camera->GetProjectionMatrix()[0][0]);
-	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	backend->UpdateUniformBuffer(ubo, 0, sizeof(math::float4x4), &camera->GetProjectionMatrix()[0][0]);
 }
 
 void ModuleRender::GenerateBlockUniforms() {
-	unsigned uniformBlockIndexDefault = glGetUniformBlockIndex(App->program->colorProgram, "Matrices");
-	unsigned uniformBlockIndexTexture = glGetUniformBlockIndex(App->program->textureProgram, "Matrices");
-	unsigned uniformBlockIndexBlinn = glGetUniformBlockIndex(App->program->blinnProgram, "Matrices");
-
-	glUniformBlockBinding(App->program->colorProgram, uniformBlockIndexDefault, 0);
-	glUniformBlockBinding(App->program->textureProgram, uniformBlockIndexTexture, 0);
-	glUniformBlockBinding(App->program->blinnProgram, uniformBlockIndexBlinn, 0);
-
+	// Programs bind their "Matrices" block to point 0 when they are linked, see ModuleProgram::BindUniformBlocks
 	glGenBuffers(1, &ubo);
-	glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+	glState->BindBuffer(GL_UNIFORM_BUFFER, ubo);
 	glBufferData(GL_UNIFORM_BUFFER, 2 * sizeof(math::float4x4), nullptr, GL_STATIC_DRAW);
-	glBindBuffer(GL_UNIFORM_BUFFER, 0);
 
 	glBindBufferRange(GL_UNIFORM_BUFFER, 0, ubo, 0, 2 * sizeof(math::float4x4));
 }
@@ -179,13 +240,13 @@ void ModuleRender::InitSDL() {
 	SDL_GetWindowSize(App->window->window, &App->window->width, &App->window->height);
 }
 
-void ModuleRender::InitOpenGL() const {
+void ModuleRender::InitOpenGL() {
 	glHint(GL_PERSPECTIVE_CORRECTION_HINT, GL_NICEST);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_CULL_FACE);
+	glState->BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glState->Enable(GL_DEPTH_TEST);
+	glState->Enable(GL_CULL_FACE);
 	glFrontFace(GL_CCW);
-	glEnable(GL_TEXTURE_2D);
+	glState->Enable(GL_TEXTURE_2D);
 
 	glClearDepth(1.0f);
 	glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
@@ -197,7 +258,8 @@ void ModuleRender::GenerateFallBackMaterial() {
 
 	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 	glGenTextures(1, &fallback);
-	glBindTexture(GL_TEXTURE_2D, fallback);
+	glState->ActiveTexture(GL_TEXTURE0);
+	glState->BindTexture(GL_TEXTURE_2D, fallback);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
@@ -205,72 +267,346 @@ void ModuleRender::GenerateFallBackMaterial() {
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 1, 1, 0, GL_RGB, GL_UNSIGNED_BYTE, fallbackImage);
 }
 
-void ModuleRender::DrawMeshes(ComponentCamera* camera) {
-	BROFILER_CATEGORY("DrawMeshes()", Profiler::Color::Gold);
-	for (std::list<ComponentMesh*>::iterator it = meshes.begin(); it != meshes.end(); ++it) {
-		if ((*it)->enabled) {
-			if (frustCulling) {
-				if (frustumCullingType == 1) {
-					CullingFromQuadTree(camera, *it);
-				} else {
-					CullingFromFrustum(camera, *it);
-				}
-			} else {
-					DrawWithoutCulling(*it);
+void ModuleRender::PrepareView(RenderView& view) const {
+	BROFILER_CATEGORY("PrepareView()", Profiler::Color::Gold);
+	view.visibleMeshes.clear();
+	view.culledMeshes.clear();
+
+	if (frustCulling) {
+		if (frustumCullingType == 1) {
+			CullingFromQuadTree(view);
+		} else {
+			CullingFromFrustum(view);
+		}
+	} else {
+		for (std::list<ComponentMesh*>::const_iterator it = meshes.begin(); it != meshes.end(); ++it) {
+			if ((*it)->enabled) {
+				view.visibleMeshes.push_back(*it);
 			}
 		}
 	}
+
+	view.queue.Clear();
+	view.clustersTested = 0u;
+	view.clustersFrustumCulled = 0u;
+	view.clustersBackfaceCulled = 0u;
+	for (std::vector<ComponentMesh*>::const_iterator it = view.visibleMeshes.begin(); it != view.visibleMeshes.end(); ++it) {
+		EnqueueMesh(view, *it);
+	}
+	view.queue.Build();
 }
 
-void ModuleRender::DrawWithoutCulling(ComponentMesh* mesh) const {
-	if (mesh->goContainer->transform != nullptr) {
-		if (App->scene->goSelected == mesh->goContainer) {
-			dd::aabb(mesh->goContainer->bbox.minPoint, mesh->goContainer->bbox.maxPoint, math::float3(0.0f, 1.0f, 0.0f), true);
+void ModuleRender::CullingFromFrustum(RenderView& view) const {
+	math::Plane planes[6];
+	view.cullingCamera->frustum.GetPlanes(planes);
+
+	for (std::list<ComponentMesh*>::const_iterator it = meshes.begin(); it != meshes.end(); ++it) {
+		if (!(*it)->enabled) {
+			continue;
 		}
 
-		unsigned program = App->program->blinnProgram;
-		ComponentMaterial* compMat = (ComponentMaterial*)mesh->goContainer->GetComponent(ComponentType::MATERIAL);
+		if (!InsideFrustum(planes, (*it)->goContainer)) {
+			view.culledMeshes.push_back(*it);
+		} else {
+			view.visibleMeshes.push_back(*it);
+		}
+	}
+}
 
-		glUseProgram(program);
+void ModuleRender::CullingFromQuadTree(RenderView& view) const {
+	const math::Frustum& frustum = view.cullingCamera->frustum;
+	math::Plane planes[6];
+	frustum.GetPlanes(planes);
 
-		glUniformMatrix4fv(glGetUniformLocation(program, "model"), 1, GL_TRUE, &mesh->goContainer->transform->GetGlobalTransform()[0][0]);
-	
-		mesh->Draw(program, compMat);
+	view.quadCollided.clear();
+	App->scene->quadTree->CollectIntersections(view.quadCollided, frustum);
 
-		glUseProgram(0);
+	for (std::list<ComponentMesh*>::const_iterator it = meshes.begin(); it != meshes.end(); ++it) {
+		if (!(*it)->goContainer->staticGo && (*it)->resource != nullptr) {
+			view.quadCollided.push_back((*it)->goContainer);
+		}
 	}
+
+	// The quadtree only knows the boxes, every object is tested with its own volumes
+	for (std::vector<GameObject*>::const_iterator it = view.quadCollided.begin(); it != view.quadCollided.end(); ++it){
+		ComponentMesh* mesh = (ComponentMesh*)(*it)->GetComponent(ComponentType::MESH);
+		if ((*it)->enabled && mesh != nullptr && mesh->enabled && InsideFrustum(planes, *it)) {
+			view.visibleMeshes.push_back(mesh);
+		}
+	}
+}
+
+// The sphere rejects or accepts most objects, the ones it leaves across a plane test their obb against it
+bool ModuleRender::InsideFrustum(const math::Plane* planes, const GameObject* gameObject) const {
+	const math::Sphere& sphere = gameObject->bsphere;
+	const math::OBB& obb = gameObject->obb;
+
+	for (unsigned i = 0u; i < 6u; ++i) {
+		float distance = planes[i].SignedDistance(sphere.pos);
+		if (distance > sphere.r) {
+			return false;
+		}
+
+		if (distance < -sphere.r) {
+			continue;
+		}
+
+		const math::float3& normal = planes[i].normal;
+		float radius = obb.r.x * fabsf(normal.Dot(obb.axis[0])) + obb.r.y * fabsf(normal.Dot(obb.axis[1])) + obb.r.z * fabsf(normal.Dot(obb.axis[2]));
+		if (planes[i].SignedDistance(obb.pos) > radius) {
+			return false;
+		}
+	}
+
+	return true;
 }
 
-void ModuleRender::CullingFromFrustum(ComponentCamera* camera, ComponentMesh* mesh) const {
-	if (!camera->frustum.Intersects(mesh->goContainer->bbox)) {
-		dd::aabb(mesh->goContainer->bbox.minPoint, mesh->goContainer->bbox.maxPoint, math::float3(0.0f, 1.0f, 0.0f), true);
+void ModuleRender::EnqueueMesh(RenderView& view, ComponentMesh* mesh) const {
+	if (mesh->goContainer->transform == nullptr) {
+		return;
+	}
+
+	const Mesh* sharedMesh = mesh->GetMesh();
+	const ArenaAllocation* allocation = sharedMesh != nullptr ? arena->GetAllocation(sharedMesh->arenaHandle) : nullptr;
+	ComponentMaterial* compMat = (ComponentMaterial*)mesh->goContainer->GetComponent(ComponentType::MATERIAL);
+
+	if (allocation == nullptr || compMat == nullptr) {
+		return;
+	}
+
+	const Mesh& meshData = *sharedMesh;
+	MeshLod lod = meshData.GetLod(mesh->activeLod);
+
+	RenderItem item;
+	item.vertexFormat = allocation->vertexFormat;
+	item.indexSize = allocation->indexSize;
+	item.indicesNumber = lod.indicesNumber;
+	item.firstIndex = allocation->firstIndex + lod.firstIndex;
+	item.baseVertex = allocation->baseVertex;
+	item.material = &compMat->material;
+	item.materialEnabled = compMat->enabled;
+	item.model = mesh->goContainer->transform->GetGlobalTransform();
+	item.positionOffset = meshData.positionOffset;
+	item.positionScale = meshData.positionScale;
+
+	// Culling clusters only pays on the full level, the simplified ones are small on screen anyway
+	view.visibleRanges.clear();
+	if (clusterCulling && frustCulling && mesh->activeLod == 0u && meshData.clustersNumber > 0u) {
+		CullClusters(view, meshData, item.model);
 	} else {
-		DrawWithoutCulling(mesh);
+		view.visibleRanges.push_back(lod);
+	}
+
+	for (std::vector<MeshLod>::const_iterator range = view.visibleRanges.begin(); range != view.visibleRanges.end(); ++range) {
+		if (meshData.submeshesNumber == 0u) {
+			item.indicesNumber = range->indicesNumber;
+			item.firstIndex = allocation->firstIndex + range->firstIndex;
+			view.queue.Add(item);
+			continue;
+		}
+
+		// Split meshes draw every submesh of the level from its own base vertex, a range may cross several of them
+		unsigned rangeEnd = range->firstIndex + range->indicesNumber;
+		for (unsigned i = 0u; i < meshData.submeshesNumber; ++i) {
+			const MeshSubmesh& submesh = meshData.submeshes[i];
+			unsigned first = MAX(submesh.firstIndex, range->firstIndex);
+			unsigned last = MIN(submesh.firstIndex + submesh.indicesNumber, rangeEnd);
+			if (first < last) {
+				item.indicesNumber = last - first;
+				item.firstIndex = allocation->firstIndex + first;
+				item.baseVertex = allocation->baseVertex + submesh.baseVertex;
+				view.queue.Add(item);
+			}
+		}
 	}
 }
 
-void ModuleRender::CullingFromQuadTree(ComponentCamera* camera, ComponentMesh* mesh) {
-	quadGOCollided.clear();
-	App->scene->quadTree->CollectIntersections(quadGOCollided, camera->frustum);
+void ModuleRender::CullClusters(RenderView& view, const Mesh& mesh, const math::float4x4& model) const {
+	const math::Frustum& frustum = view.cullingCamera->frustum;
+	math::Plane planes[6];
+	frustum.GetPlanes(planes);
+
+	// Which side of a triangle the camera sees does not change with the transform, so the camera goes to mesh space
+	// instead of every cone coming to world space. Mirrored transforms flip the winding and skip the cone test.
+	math::float4x4 inverse = model.Inverted();
+	math::float3 localCamera = inverse.TransformPos(frustum.pos);
+	math::float3 localFront = inverse.TransformDir(frustum.front);
+	bool orthographic = frustum.type == math::OrthographicFrustum;
+	bool coneCulling = model.Float3x3Part().Determinant() > 0.0f;
+	float scale = model.GetScale().MaxElement();
+
+	view.clustersTested += mesh.clustersNumber;
+	for (unsigned i = 0u; i < mesh.clustersNumber; ++i) {
+		const MeshCluster& cluster = mesh.clusters[i];
+
+		math::float3 center = model.TransformPos(cluster.center);
+		float radius = cluster.radius * scale;
+		bool culled = false;
+		for (unsigned j = 0u; j < 6u && !culled; ++j) {
+			culled = planes[j].SignedDistance(center) > radius;
+		}
 
-	for (std::list<ComponentMesh*>::iterator it = meshes.begin(); it != meshes.end(); ++it) {
-		if (!(*it)->goContainer->staticGo && (*it)->mesh.verticesNumber > 0 && camera->frustum.Intersects((*it)->goContainer->bbox)) {
-			quadGOCollided.push_back((*it)->goContainer);
+		if (culled) {
+			++view.clustersFrustumCulled;
+			continue;
 		}
+
+		// Every normal of the cone points away from every point of the sphere seen from the camera
+		if (coneCulling && cluster.coneCutoff < 1.0f) {
+			math::float3 direction = orthographic ? localFront : cluster.center - localCamera;
+			float sphereMargin = orthographic ? 0.0f : cluster.radius * (1.0f + cluster.coneCutoff);
+			if (direction.Dot(cluster.coneAxis) >= cluster.coneCutoff * direction.Length() + sphereMargin) {
+				++view.clustersBackfaceCulled;
+				continue;
+			}
+		}
+
+		// Neighbour clusters drawn together are a single range
+		if (!view.visibleRanges.empty() && view.visibleRanges.back().firstIndex + view.visibleRanges.back().indicesNumber == cluster.firstIndex) {
+			view.visibleRanges.back().indicesNumber += cluster.indicesNumber;
+		} else {
+			MeshLod range;
+			range.firstIndex = cluster.firstIndex;
+			range.indicesNumber = cluster.indicesNumber;
+			view.visibleRanges.push_back(range);
+		}
+	}
+}
+
+void ModuleRender::DrawViewDebugData(const RenderView& view) const {
+	for (std::vector<ComponentMesh*>::const_iterator it = view.culledMeshes.begin(); it != view.culledMeshes.end(); ++it) {
+		dd::aabb((*it)->goContainer->bbox.minPoint, (*it)->goContainer->bbox.maxPoint, math::float3(0.0f, 1.0f, 0.0f), true);
+	}
+
+	GameObject* selected = App->scene->goSelected;
+	if (selected != nullptr && std::find(view.visibleMeshes.begin(), view.visibleMeshes.end(), selected->GetComponent(ComponentType::MESH)) != view.visibleMeshes.end()) {
+		dd::aabb(selected->bbox.minPoint, selected->bbox.maxPoint, math::float3(0.0f, 1.0f, 0.0f), true);
 	}
+}
+
+void ModuleRender::SubmitRenderQueue(const RenderQueue& queue) {
+	if (queue.commands.empty()) {
+		return;
+	}
+
+	unsigned program = App->program->blinnProgram;
+	backend->UseProgram(program);
 
-	for (std::vector<GameObject*>::iterator it = quadGOCollided.begin(); it != quadGOCollided.end(); ++it){
-		if ((*it)->enabled) {
-			DrawWithoutCulling((ComponentMesh*)(*it)->GetComponent(ComponentType::MESH));
+	// Orphan and refill the per frame buffers, a queue shared by two views is uploaded once
+	if (uploadedQueue != &queue) {
+		backend->UploadBuffer(GL_ARRAY_BUFFER, arena->instanceVbo, sizeof(InstanceData) * queue.instances.size(), &queue.instances[0]);
+		if (multiDrawIndirect) {
+			backend->UploadBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer, sizeof(DrawElementsIndirectCommand) * queue.commands.size(), &queue.commands[0]);
 		}
+		uploadedQueue = &queue;
 	}
+
+	backend->SetUniform3fv(program, "light_pos", (float*)&App->scene->lightPosition);
+	backend->SetUniform1f(program, "ambient", App->scene->ambientLight);
+
+	VertexFormat format;
+	for (std::vector<RenderBatch>::const_iterator it = queue.batches.begin(); it != queue.batches.end(); ++it) {
+		format.FromKey(it->vertexFormat);
+		backend->BindVertexArray(arena->GetVao(it->vertexFormat));
+		backend->SetUniform1i(program, "octahedralNormals", format.IsOctahedral(ATTRIBUTE_NORMAL) ? 1 : 0);
+		BindMaterial(program, *it);
+		backend->DrawIndirect(&queue.commands[0], it->firstCommand, it->commandsNumber, it->indexSize);
+	}
+}
+
+void ModuleRender::BindMaterial(unsigned program, const RenderBatch& batch) const {
+	const Material& material = *batch.material;
+	math::float4 diffuseColor(material.diffuseColor.xyz(), 1.0f);
+	math::float4 emissiveColor(material.emissiveColor.xyz(), 1.0f);
+	math::float4 specularColor(material.specularColor.xyz(), 1.0f);
+
+	backend->SetUniform4fv(program, "diffuseColor", diffuseColor.ptr());
+	backend->SetUniform4fv(program, "emissiveColor", emissiveColor.ptr());
+	backend->SetUniform4fv(program, "specularColor", specularColor.ptr());
+	backend->SetUniform1f(program, "shininess", material.shininess);
+	backend->SetUniform1f(program, "k_ambient", material.ambientK);
+	backend->SetUniform1f(program, "k_diffuse", material.diffuseK);
+	backend->SetUniform1f(program, "k_specular", material.specularK);
+	backend->SetUniform4fv(program, "newColor", (float*)&material.color);
+
+	backend->BindTexture(0u, (batch.materialEnabled && material.diffuseMap != 0) ? material.diffuseMap : fallback);
+	backend->SetUniform1i(program, "diffuseMap", 0);
+
+	backend->BindTexture(1u, (batch.materialEnabled && material.emissiveMap != 0) ? material.emissiveMap : fallback);
+	backend->SetUniform1i(program, "emissiveMap", 1);
+
+	backend->BindTexture(2u, (batch.materialEnabled && material.occlusionMap != 0) ? material.occlusionMap : fallback);
+	backend->SetUniform1i(program, "occlusionMap", 2);
+
+	backend->BindTexture(3u, (batch.materialEnabled && material.specularMap != 0) ? material.specularMap : fallback);
+	backend->SetUniform1i(program, "specularMap", 3);
+}
+
+void ModuleRender::DrawGUI() {
+	ImGui::Text("Scene view: %u draw commands, %u batches", views[VIEW_SCENE].queue.commands.size(), views[VIEW_SCENE].queue.batches.size());
+	if (App->camera->selectedCamera != nullptr) {
+		const RenderView& gameView = sharedCulling ? views[VIEW_SCENE] : views[VIEW_GAME];
+		ImGui::Text("Game view: %u draw commands, %u batches", gameView.queue.commands.size(), gameView.queue.batches.size());
+	}
+	ImGui::Text("Shared culling: %s", sharedCulling ? "yes" : "no");
+	ImGui::Checkbox("Cluster culling", &clusterCulling);
+	if (clusterCulling) {
+		const RenderView& sceneView = views[VIEW_SCENE];
+		ImGui::Text("Clusters: %u tested, %u outside the frustum, %u backfacing", sceneView.clustersTested, sceneView.clustersFrustumCulled, sceneView.clustersBackfaceCulled);
+	}
+	ImGui::Text("Job workers: %u", App->jobs->WorkersNumber());
+	ImGui::Text("Backend: %s", backend->GetName());
+	ImGui::Text("Submission: %.3f ms", submissionTime);
+	ImGui::Text("Multi draw indirect: %s", multiDrawIndirect ? "yes" : "no");
+	ImGui::Checkbox("Mesh LODs", &lodEnabled);
+	if (lodEnabled) {
+		ImGui::DragFloat3("LOD thresholds", lodThresholds, 0.005f, 0.0f, 1.0f, "%.3f");
+		ImGui::DragFloat("LOD hysteresis", &lodHysteresis, 0.01f, 0.0f, 0.5f, "%.2f");
+	}
+	glState->DrawGUI();
+	App->debug->DrawGUI();
+	ImGui::Separator();
+	arena->DrawGUI();
 }
 
 bool ModuleRender::CleanUp() {
-	glDeleteBuffers(1, &ubo);
+	glState->DeleteBuffer(ubo);
+	glState->DeleteBuffer(indirectBuffer);
+	glState->DeleteTexture(fallback);
+
+	delete backend;
+	backend = nullptr;
+
+	delete arena;
+	arena = nullptr;
+
+	delete glState;
+	glState = nullptr;
+
 	return true;
 }
 
+update_status ModuleRender::UpdateBenchmark() {
+	RecordingRenderBackend* recorder = (RecordingRenderBackend*)backend;
+
+	++benchmarkFrames;
+	benchmarkTime += submissionTime;
+	benchmarkDrawCalls += recorder->drawCalls;
+	benchmarkCommands += recorder->commands.size();
+	benchmarkClustersCulled += views[VIEW_SCENE].clustersFrustumCulled + views[VIEW_SCENE].clustersBackfaceCulled;
+
+	if (App->benchmarkFrames == 0u || benchmarkFrames < App->benchmarkFrames) {
+		return UPDATE_CONTINUE;
+	}
+
+	LOG("Benchmark: %u frames, %.3f ms average submission", benchmarkFrames, benchmarkTime / (float)benchmarkFrames);
+	LOG("Benchmark: %.1f draw calls, %.1f recorded commands per frame", (float)benchmarkDrawCalls / (float)benchmarkFrames, (float)benchmarkCommands / (float)benchmarkFrames);
+	LOG("Benchmark: %.1f clusters culled per frame", (float)benchmarkClustersCulled / (float)benchmarkFrames);
+	LOG("Benchmark last frame: %u instances, %u triangles, %u binds, %u uniforms, %u bytes uploaded, %u index bytes", recorder->instances, recorder->triangles, recorder->binds, recorder->uniformUploads, recorder->uploadedBytes, recorder->indexBytes);
+
+	return UPDATE_STOP;
+}
+
 void ModuleRender::PrintQuadNode(QuadTreeNode* quadNode) const {
 
 	if (quadNode->childs[0] != nullptr) {
@@ -3,6 +3,8 @@
 
 #include "Module.h"
 #include "ImGuizmo/ImGuizmo.h"
+#include "RenderQueue.h"
+#include "ModuleTextures.h"
 #include <list>
 #include <vector>
 
@@ -10,6 +12,30 @@ class GameObject;
 class QuadTreeNode;
 class ComponentMesh;
 class ComponentCamera;
+class GeometryArena;
+class GLStateCache;
+class RenderBackend;
+struct RenderBatch;
+
+enum RenderViewType {
+	VIEW_SCENE = 0,
+	VIEW_GAME,
+	VIEW_COUNT
+};
+
+// Everything a view needs for submission, filled by a job without touching GL
+struct RenderView {
+	ComponentCamera*				cullingCamera = nullptr;
+	std::vector<ComponentMesh*>		visibleMeshes;
+	std::vector<ComponentMesh*>		culledMeshes;
+	std::vector<GameObject*>		quadCollided;
+	std::vector<MeshLod>			visibleRanges;	// index ranges of the mesh being enqueued that survived cluster culling
+	RenderQueue						queue;
+
+	unsigned						clustersTested = 0u;
+	unsigned						clustersFrustumCulled = 0u;
+	unsigned						clustersBackfaceCulled = 0u;
+};
 
 class ModuleRender : public Module
 {
@@ -24,10 +50,11 @@ class ModuleRender : public Module
 		bool			CleanUp();
 
 		void			DrawImGuizmo(float width, float height, float winPosX, float winPosY);
+		void			DrawGUI();
 
 	private:
 		void			InitSDL();
-		void			InitOpenGL() const;
+		void			InitOpenGL();
 
 		void			SetViewMatrix(ComponentCamera* camera) const;
 		void			SetProjectionMatrix(ComponentCamera* camera) const;
@@ -35,15 +62,23 @@ class ModuleRender : public Module
 		void			GenerateFallBackMaterial();
 
 		/* Debug elements drawing */
-		void			DrawDebugData(ComponentCamera* camera) const;
+		void			DrawDebugData(ComponentCamera* camera, const RenderView& view) const;
+		void			DrawViewDebugData(const RenderView& view) const;
 		void			PrintQuadNode(QuadTreeNode* quadNode) const;
 		void			PrintRayCast() const;
 
 		/* Mesh drawing */
-		void			DrawMeshes(ComponentCamera* camera);
-		void			DrawWithoutCulling(ComponentMesh* mesh) const;
-		void			CullingFromQuadTree(ComponentCamera* camera, ComponentMesh* mesh);
-		void			CullingFromFrustum(ComponentCamera* camera, ComponentMesh* mesh) const;
+		void			PrepareView(RenderView& view) const;
+		void			CullingFromQuadTree(RenderView& view) const;
+		void			CullingFromFrustum(RenderView& view) const;
+		bool			InsideFrustum(const math::Plane* planes, const GameObject* gameObject) const;
+		void			EnqueueMesh(RenderView& view, ComponentMesh* mesh) const;
+		void			CullClusters(RenderView& view, const Mesh& mesh, const math::float4x4& model) const;
+		void			SubmitRenderQueue(const RenderQueue& queue);
+		void			BindMaterial(unsigned program, const RenderBatch& batch) const;
+
+		/* Headless runs */
+		update_status	UpdateBenchmark();
 
 	public:
 		bool			selectAncestorOnClick = true;
@@ -55,12 +90,36 @@ class ModuleRender : public Module
 		bool			showQuad = false;
 		bool			showRayCast = false;
 		unsigned		fallback = 0u;
+		unsigned		indirectBuffer = 0u;
+		bool			multiDrawIndirect = false;
+		float			submissionTime = 0.0f;
+
+		GLStateCache*	glState = nullptr;
+		RenderBackend*	backend = nullptr;
+		GeometryArena*	arena = nullptr;
 
 		int				imGuizmoOp = 0;
 		int				imGuizmoMode = 0;
 
 		std::list<ComponentMesh*> meshes;
-		std::vector<GameObject*> quadGOCollided;
+		RenderView		views[VIEW_COUNT];
+		bool			sharedCulling = false;
+
+		// Screen height fractions below which LOD 1, 2 and 3 are drawn
+		bool			lodEnabled = true;
+		float			lodThresholds[3] = { 0.25f, 0.12f, 0.05f };
+		float			lodHysteresis = 0.1f;
+
+		// Clusters of the full level outside the culling frustum or facing away from its camera are not drawn
+		bool			clusterCulling = true;
+
+	private:
+		const RenderQueue*	uploadedQueue = nullptr;
+		unsigned		benchmarkFrames = 0u;
+		unsigned		benchmarkDrawCalls = 0u;
+		unsigned		benchmarkCommands = 0u;
+		unsigned		benchmarkClustersCulled = 0u;
+		float			benchmarkTime = 0.0f;
 };
 
 #endif
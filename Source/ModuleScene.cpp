@@ -87,30 +87,13 @@ GameObject* ModuleScene::CreateCamera(GameObject* goParent, const math::float4x4
 }
 
 void ModuleScene::LoadGeometry(GameObject* goParent, GeometryType geometryType) {
-	par_shapes_mesh_s* parMesh = nullptr;
-
-	switch (geometryType) {
-		case GeometryType::SPHERE:
-			parMesh = par_shapes_create_parametric_sphere(30, 30);
-			break;
-		case GeometryType::TORUS:
-			parMesh = par_shapes_create_torus(30, 30, 0.5f);
-			break;
-		case GeometryType::PLANE:
-			parMesh = par_shapes_create_plane(30, 30);
-			break;
-		case GeometryType::CUBE:
-			parMesh = par_shapes_create_cube();
-			break;
-	}
-
-	if (parMesh != nullptr) {
-		par_shapes_scale(parMesh, 0.5f * App->scene->scaleFactor, 0.5f * App->scene->scaleFactor, 0.5f * App->scene->scaleFactor);
+	// The cube is not tessellated
+	unsigned tessellation = (geometryType == GeometryType::CUBE) ? 0u : 30u;
 
-		ComponentMesh* mesh = (ComponentMesh*)goParent->AddComponent(ComponentType::MESH);
-		mesh->ComputeMesh(parMesh);
-		par_shapes_free_mesh(parMesh);
+	ComponentMesh* mesh = (ComponentMesh*)goParent->AddComponent(ComponentType::MESH);
+	mesh->LoadPrimitive(geometryType, tessellation, tessellation, 0.5f * scaleFactor);
 
+	if (mesh->resource != nullptr) {
 		ComponentMaterial* mat = (ComponentMaterial*)goParent->AddComponent(ComponentType::MATERIAL);
 		goParent->ComputeBBox();
 	} else {
@@ -6,12 +6,14 @@
 #include "ComponentMaterial.h"
 #include "MaterialImporter.h"
 #include "ModuleFileSystem.h"
+#include "GLStateCache.h"
+#include "ContentStore.h"
+#include "DdsFile.h"
+#include "SDL_image/include/SDL_image.h"
 
 ModuleTextures::ModuleTextures() { }
 
-ModuleTextures::~ModuleTextures() {
-	CleanUp();
-}
+ModuleTextures::~ModuleTextures() { }
 
 bool ModuleTextures::Init() {
 	LOG("Init Image library");
@@ -21,6 +23,16 @@ bool ModuleTextures::Init() {
 	iluInit();
 	ilutInit();
 
+	// Loads the decoders before the import jobs use them. Game/ ships no libtiff, until it does TIF is decoded by DevIL
+	// and those cooks run one at a time on its lock
+	int imageFormats = IMG_Init(IMG_INIT_PNG | IMG_INIT_TIF);
+	sdlTif = (imageFormats & IMG_INIT_TIF) != 0;
+	LOG("SDL_image decoders: png %s, tif %s", (imageFormats & IMG_INIT_PNG) ? "yes" : "no", sdlTif ? "yes" : "no (DevIL, serialized)");
+
+	if (App->headless) {
+		return true;
+	}
+
 	LoadDefaulTextures();
 
 	return ilutRenderer(ILUT_OPENGL);
@@ -30,12 +42,15 @@ bool ModuleTextures::CleanUp() {
 	delete noCameraSelectedTexture;
 	noCameraSelectedTexture = nullptr;
 
+	IMG_Quit();
+
 	return true;
 }
 
 Texture* const ModuleTextures::Load(const char* path) {
 	assert(path != nullptr);
 
+	std::lock_guard<std::mutex> lock(devilLock);
 	ILuint imageId = 0u;
 
 	ilGenImages(1, &imageId);
@@ -53,7 +68,7 @@ Texture* const ModuleTextures::Load(const char* path) {
 		glGenTextures(1, &textureId);
 
 		// Bind the texture to a name
-		glBindTexture(GL_TEXTURE_2D, textureId);
+		App->renderer->glState->BindTexture(GL_TEXTURE_2D, textureId);
 
 		iluGetImageInfo(&imageInfo);
 
@@ -101,7 +116,6 @@ Texture* const ModuleTextures::Load(const char* path) {
 		} 
 
 		ilDeleteImages(1, &imageId); 
-		glBindTexture(GL_TEXTURE_2D, 0);
 
 		return new Texture(textureId, width, height); 
 	}
@@ -112,53 +126,184 @@ Texture* const ModuleTextures::Load(const char* path) {
 }
 
 void ModuleTextures::LoadMaterial(std::string path, unsigned& textureID, int& width, int& height) {
-	unsigned imageID;
-
-	ilGenImages(1, &imageID);
-
-	ilBindImage(imageID);
-
 	path.insert(0, "/Library/Textures/");
 
 	LOG("Loading material %s", path.c_str());
 
-	char* fileBuffer;
+	// A failed load must not leave the id of the texture it replaces, that one may be another material's now
+	textureID = 0u;
+
+	// Textures that are not content store references are found before reading them again
+	if (AcquireResident(path, textureID, width, height)) {
+		return;
+	}
+
+	char* fileBuffer = nullptr;
 	unsigned lenghBuffer = App->fileSystem->Load(path.c_str(), &fileBuffer);
 
-	if (ilLoadL(IL_DDS, fileBuffer, lenghBuffer)) {
-		ILinfo ImageInfo;
-		iluGetImageInfo(&ImageInfo);
-		if (ImageInfo.Origin == IL_ORIGIN_UPPER_LEFT) {
-			iluFlipImage();
-		}
+	// Materials pointing to the same cooked content share one texture
+	unsigned long long contentHash = 0u;
+	if (ContentStore::ReadReference(fileBuffer, lenghBuffer, contentHash)) {
+		path = ContentStore::GetPath(contentHash, ".dds");
 
-		if (!ilConvertImage(IL_RGB, IL_UNSIGNED_BYTE)) {
-			LOG("Error: Image conversion failed %s", iluErrorString(ilGetError()));
+		delete[] fileBuffer;
+		fileBuffer = nullptr;
+		if (AcquireResident(path, textureID, width, height)) {
 			return;
 		}
 
-		glGenTextures(1, &textureID);
-		glBindTexture(GL_TEXTURE_2D, textureID);
+		lenghBuffer = App->fileSystem->Load(path.c_str(), &fileBuffer);
+	}
 
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	// Blocks go to the GPU as they are, DevIL only converts what the parser or the driver cannot take
+	unsigned bytes = 0u;
+	DdsTexture dds;
+	if (DdsFile::Read(fileBuffer, lenghBuffer, dds) && (dds.bottomUp || DdsFile::Flip(dds)) && (App->headless || GLEW_EXT_texture_compression_s3tc)) {
+		width = dds.levels[0].width;
+		height = dds.levels[0].height;
 
-		width = ilGetInteger(IL_IMAGE_WIDTH);
-		height = ilGetInteger(IL_IMAGE_HEIGHT);
+		// Headless runs still parse so loading times are comparable, there is just nowhere to upload
+		if (!App->headless) {
+			bytes = UploadCompressed(dds, textureID);
+		}
+	} else {
+		LOG("Warning: %s is not block compressed as expected, converting it", path.c_str());
+		bytes = UploadConverted(fileBuffer, lenghBuffer, textureID, width, height);
+	}
 
-		glTexImage2D(GL_TEXTURE_2D, 0, ilGetInteger(IL_IMAGE_FORMAT), width, height, 0, ilGetInteger(IL_IMAGE_FORMAT), GL_UNSIGNED_BYTE, ilGetData());
+	if (textureID != 0u) {
+		ResidentTexture& resident = residentTextures[path];
+		resident.id = textureID;
+		resident.width = width;
+		resident.height = height;
+		resident.bytes = bytes;
+		resident.references = 1u;
+		texturePaths[textureID] = path;
+		residentBytes += bytes;
 	}
 
-	ilDeleteImages(1, &imageID);
 	delete[] fileBuffer;
 	fileBuffer = nullptr;
 
 	LOG("Material creation successful.");
 }
 
+bool ModuleTextures::AcquireResident(const std::string& path, unsigned& textureID, int& width, int& height) {
+	std::map<std::string, ResidentTexture>::iterator resident = residentTextures.find(path);
+	if (resident == residentTextures.end()) {
+		return false;
+	}
+
+	++resident->second.references;
+	textureID = resident->second.id;
+	width = resident->second.width;
+	height = resident->second.height;
+
+	LOG("Material already resident, shared by %u materials.", resident->second.references);
+	return true;
+}
+
+unsigned ModuleTextures::UploadCompressed(const DdsTexture& dds, unsigned& textureID) const {
+	GLenum format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	if (dds.fourCC == DDS_FOURCC('D', 'X', 'T', '1')) {
+		format = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+	} else if (dds.fourCC == DDS_FOURCC('D', 'X', 'T', '3')) {
+		format = GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;
+	}
+
+	glGenTextures(1, &textureID);
+	App->renderer->glState->BindTexture(GL_TEXTURE_2D, textureID);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, (dds.levels.size() > 1u) ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, dds.levels.size() - 1u);
+
+	unsigned bytes = 0u;
+	for (unsigned level = 0u; level < dds.levels.size(); ++level) {
+		const DdsLevel& ddsLevel = dds.levels[level];
+		glCompressedTexImage2D(GL_TEXTURE_2D, level, format, ddsLevel.width, ddsLevel.height, 0, ddsLevel.blocks.size(), &ddsLevel.blocks[0]);
+		bytes += ddsLevel.blocks.size();
+	}
+
+	return bytes;
+}
+
+unsigned ModuleTextures::UploadConverted(const char* buffer, unsigned size, unsigned& textureID, int& width, int& height) {
+	// Cooked files keep their rows bottom up whoever decodes them
+	DdsHeader header;
+	bool bottomUp = DdsFile::ReadHeader(buffer, size, header) && header.reserved1[9] == DDS_BOTTOM_UP;
+
+	std::lock_guard<std::mutex> lock(devilLock);
+	unsigned imageID;
+
+	ilGenImages(1, &imageID);
+
+	ilBindImage(imageID);
+
+	unsigned bytes = 0u;
+	if (ilLoadL(IL_TYPE_UNKNOWN, buffer, size)) {
+		width = ilGetInteger(IL_IMAGE_WIDTH);
+		height = ilGetInteger(IL_IMAGE_HEIGHT);
+
+		int levels = ilGetInteger(IL_NUM_MIPMAPS) + 1;
+
+		if (!App->headless) {
+			glGenTextures(1, &textureID);
+			App->renderer->glState->BindTexture(GL_TEXTURE_2D, textureID);
+
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		}
+
+		int level = 0;
+		for (; level < levels; ++level) {
+			// Selecting a mip moves away from the base image, it is bound again for every level
+			ilBindImage(imageID);
+			if (level > 0 && !ilActiveMipmap(level)) {
+				LOG("Error: Mip %d cannot be read", level);
+				break;
+			}
+
+			ILinfo ImageInfo;
+			iluGetImageInfo(&ImageInfo);
+			if (ImageInfo.Origin == IL_ORIGIN_UPPER_LEFT && !bottomUp) {
+				iluFlipImage();
+			}
+
+			if (!ilConvertImage(IL_RGBA, IL_UNSIGNED_BYTE)) {
+				LOG("Error: Image conversion failed %s", iluErrorString(ilGetError()));
+				break;
+			}
+
+			if (!App->headless) {
+				glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, ilGetInteger(IL_IMAGE_WIDTH), ilGetInteger(IL_IMAGE_HEIGHT), 0, GL_RGBA, GL_UNSIGNED_BYTE, ilGetData());
+				bytes += ilGetInteger(IL_IMAGE_WIDTH) * ilGetInteger(IL_IMAGE_HEIGHT) * 4u;
+			}
+		}
+
+		if (!App->headless) {
+			// A broken chain is cut at the last level that made it
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, (level > 1) ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, MAX(level - 1, 0));
+		}
+	} else {
+		LOG("Error: Texture loading %s", iluErrorString(ilGetError()));
+	}
+
+	ilDeleteImages(1, &imageID);
+
+	return bytes;
+}
+
 void ModuleTextures::LoadMaterial(const char* path, ComponentMaterial* componentMaterial, MaterialType materialTypeSelected) {
+	// Scenes save empty slots with no name
+	if (path == nullptr || *path == '\0') {
+		return;
+	}
+
 	switch (materialTypeSelected) {
 		case MaterialType::OCCLUSION_MAP:
 			if (componentMaterial->material.occlusionMap != 0u) {
@@ -187,10 +332,43 @@ void ModuleTextures::LoadMaterial(const char* path, ComponentMaterial* component
 	}
 }
 
+void ModuleTextures::AddReference(unsigned id) {
+	std::map<unsigned, std::string>::iterator path = texturePaths.find(id);
+	if (path != texturePaths.end()) {
+		++residentTextures[path->second].references;
+	}
+}
+
 void ModuleTextures::Unload(unsigned id) {
-	if (id != 0u) {
-		glDeleteTextures(1, &id);
+	if (id == 0u) {
+		return;
 	}
+
+	std::map<unsigned, std::string>::iterator path = texturePaths.find(id);
+	if (path != texturePaths.end()) {
+		std::map<std::string, ResidentTexture>::iterator resident = residentTextures.find(path->second);
+		if (resident != residentTextures.end()) {
+			if (--resident->second.references > 0u) {
+				return;
+			}
+
+			residentBytes -= resident->second.bytes;
+			residentTextures.erase(resident);
+		}
+		texturePaths.erase(path);
+	}
+
+	App->renderer->glState->DeleteTexture(id);
+}
+
+unsigned ModuleTextures::TextureBytes(unsigned id) const {
+	std::map<unsigned, std::string>::const_iterator path = texturePaths.find(id);
+	if (path == texturePaths.end()) {
+		return 0u;
+	}
+
+	std::map<std::string, ResidentTexture>::const_iterator resident = residentTextures.find(path->second);
+	return (resident != residentTextures.end()) ? resident->second.bytes : 0u;
 }
 
 void ModuleTextures::LoadDefaulTextures() {
@@ -198,6 +376,8 @@ void ModuleTextures::LoadDefaulTextures() {
 }
 
 void ModuleTextures::DrawGUI() {
+	ImGui::Text("Resident material textures: %u (%.2f MB)", residentTextures.size(), (float)residentBytes / (1024.0f * 1024.0f));
+	ImGui::Separator();
 	ImGui::Text("This will be applied only to the next loaded models");
 	ImGui::Text("Filter type:");
 	ImGui::RadioButton("Linear", &filterType, GL_LINEAR); ImGui::SameLine();
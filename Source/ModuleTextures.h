@@ -2,6 +2,8 @@
 #define __MODULETEXTURES_H__
 
 #include <list>
+#include <map>
+#include <mutex>
 #include "Module.h"
 #include "Globals.h"
 #include "imgui.h"
@@ -9,9 +11,19 @@
 #include "IL/ilut.h"
 #include "Math/float4.h"
 #include "Geometry/AABB.h"
+#include "Geometry/OBB.h"
+#include "Geometry/Sphere.h"
+#include "VertexFormat.h"
+#include "Material.h"
+
+class MappedFile;
+struct MeshBvhNode;
+
+#define MESH_MAX_LODS 4u
 
 enum class MaterialType;
 class ComponentMaterial;
+struct DdsTexture;
 
 struct Texture {
 	int id = 0;
@@ -20,51 +32,140 @@ struct Texture {
 	Texture(int id, int width, int height) : id(id), width(width), height(height) { }
 };
 
-struct Mesh {
-	unsigned vao = 0u;
-	unsigned vbo = 0u;
-	unsigned ibo = 0u;
-
-	float*		normals = nullptr;
-	float*		colors = nullptr;
-	float*		uvs = nullptr;
-	unsigned	verticesNumber = 0u;
-	float*		vertices = nullptr;
+// Texture uploaded once for every material using the same file, its GL id is the handle materials keep
+struct ResidentTexture {
+	unsigned	id = 0u;
+	int			width = 0;
+	int			height = 0;
+	unsigned	bytes = 0u;	// GPU memory of all its levels
+	unsigned	references = 0u;
+};
+
+// Range of the mesh indices drawn for one level of detail, every level uses the same vertex buffer.
+// Meshes split for 16 bit indices give lower levels the full level's copies, only triangles across submeshes add vertices.
+struct MeshLod {
+	unsigned	firstIndex = 0u;
 	unsigned	indicesNumber = 0u;
-	unsigned*	indices = nullptr;
+};
 
-	unsigned normalsOffset = 0u;
-	unsigned texturesOffset = 0u;
-	unsigned vertexSize = 0u;
+// Range of the indices addressing its vertices from baseVertex, lets meshes too big for 16 bit indices use them
+struct MeshSubmesh {
+	unsigned	firstIndex = 0u;
+	unsigned	indicesNumber = 0u;
+	unsigned	baseVertex = 0u;
+};
 
-	math::AABB	bbox;
+// Contiguous triangles of the full level culled on their own, bounds are in mesh space
+struct MeshCluster {
+	unsigned		firstIndex = 0u;
+	unsigned		indicesNumber = 0u;
+	math::float3	center = math::float3::zero;
+	float			radius = 0.0f;
+	math::float3	coneAxis = math::float3::unitZ;	// average normal
+	float			coneCutoff = 1.0f;				// sine of the angle of the widest normal to the axis, 1 is never backfacing
 };
 
-struct Material {
-	unsigned		occlusionMap = 0u;
-	float			ambientK = 0.5f;
-	int				ambientWidth = 0;
-	int				ambientHeight = 0;
-
-	unsigned		diffuseMap = 0u;
-	math::float4	diffuseColor = math::float4(1.0f, 1.0f, 1.0f, 1.0f);
-	float			diffuseK = 1.0f;
-	int				diffuseWidth = 0;
-	int				diffuseHeight = 0;
-
-	unsigned		specularMap = 0u;
-	math::float4	specularColor = math::float4(1.0f, 1.0f, 1.0f, 1.0f);
-	float			specularK = 0.6f;
-	float			shininess = 64.0f;
-	int				specularWidth = 0;
-	int				specularHeight = 0;
-
-	unsigned		emissiveMap = 0u;
-	math::float4	emissiveColor = math::float4(0.0f, 0.0f, 0.0f, 0.0f);
-	int				emissiveWidth = 0;
-	int				emissiveHeight = 0;
-
-	math::float4	color = math::float4::one;
+struct Mesh {
+	unsigned		arenaHandle = 0u;
+
+	VertexFormat	format;
+	char*			vertexData = nullptr; // Interleaved as described by format, uploaded as is
+	unsigned		verticesNumber = 0u;
+	unsigned		indicesNumber = 0u; // all the levels
+	unsigned		indexSize = sizeof(unsigned); // bytes per index, sizeof(unsigned short) once compacted
+	void*			indices = nullptr;
+
+	// No levels means a single one covering all the indices
+	MeshLod			lods[MESH_MAX_LODS];
+	unsigned		lodsNumber = 0u;
+
+	// No submeshes means a single one over all the indices and vertices, otherwise every level is split in whole submeshes
+	MeshSubmesh*	submeshes = nullptr;
+	unsigned		submeshesNumber = 0u;
+
+	// Partition of the full level, empty when it is culled as a whole
+	MeshCluster*	clusters = nullptr;
+	unsigned		clustersNumber = 0u;
+
+	// Over the triangles of the full level in mesh space, empty when picking tests every triangle
+	MeshBvhNode*	bvhNodes = nullptr;
+	unsigned		bvhNodesNumber = 0u;
+	unsigned*		bvhTriangles = nullptr; // leaves point into it, full level triangle numbers
+	unsigned		bvhTrianglesNumber = 0u;
+
+	// When set, vertexData, indices, submeshes, clusters and the bvh point into this read only mapping instead of owning arrays
+	MappedFile*		mapping = nullptr;
+
+	// Of the content store file it was loaded from, meshes with the same one share their arena allocation
+	unsigned long long	contentHash = 0u;
+
+	math::AABB		bbox;
+	math::Sphere	bsphere;	// close to the minimal one, cooked with the bounds
+	math::OBB		obb;		// along the principal axes of the vertices, cooked with the bounds
+
+	// Quantized positions are stored normalized to the bounds, position = stored * scale + offset
+	math::float3	positionOffset = math::float3::zero;
+	math::float3	positionScale = math::float3::one;
+
+	// Picking reads positions straight from the interleaved data, no planar copy is kept
+	math::float3 GetPosition(unsigned index) const {
+		math::float3 position;
+		format.ReadAttribute(vertexData + index * format.stride, ATTRIBUTE_POSITION, position.ptr());
+		return position.Mul(positionScale) + positionOffset;
+	}
+
+	unsigned LodsNumber() const {
+		return (lodsNumber > 0u) ? lodsNumber : 1u;
+	}
+
+	MeshLod GetLod(unsigned level) const {
+		if (lodsNumber == 0u) {
+			MeshLod whole;
+			whole.indicesNumber = indicesNumber;
+			return whole;
+		}
+
+		return lods[MIN(level, lodsNumber - 1u)];
+	}
+
+	unsigned SubmeshesNumber() const {
+		return (submeshesNumber > 0u) ? submeshesNumber : 1u;
+	}
+
+	MeshSubmesh GetSubmesh(unsigned submesh) const {
+		if (submeshesNumber == 0u) {
+			MeshSubmesh whole;
+			whole.indicesNumber = indicesNumber;
+			return whole;
+		}
+
+		return submeshes[submesh];
+	}
+
+	// Base vertex of the submesh holding the index
+	unsigned GetBaseVertex(unsigned index) const {
+		unsigned first = 0u;
+		unsigned last = SubmeshesNumber();
+		while (last - first > 1u) {
+			unsigned middle = (first + last) / 2u;
+			if (GetSubmesh(middle).firstIndex <= index) {
+				first = middle;
+			} else {
+				last = middle;
+			}
+		}
+
+		return GetSubmesh(first).baseVertex;
+	}
+
+	// Relative to the base vertex of the submesh holding it
+	unsigned GetIndex(unsigned index) const {
+		if (indexSize == sizeof(unsigned short)) {
+			return ((const unsigned short*)indices)[index];
+		}
+
+		return ((const unsigned*)indices)[index];
+	}
 };
 
 class ModuleTextures : public Module
@@ -81,8 +182,17 @@ class ModuleTextures : public Module
 
 		void			LoadMaterial(std::string path, unsigned& textureID, int& width, int& height);
 		void			LoadMaterial(const char* path, ComponentMaterial* componentMaterial, MaterialType materialTypeSelected);
+		void			AddReference(unsigned id);	// of a texture loaded for a material, released with Unload
 		void			Unload(unsigned id);
 
+		// GPU memory of a texture loaded for a material, 0 for any other
+		unsigned		TextureBytes(unsigned id) const;
+
+	private:
+		bool			AcquireResident(const std::string& path, unsigned& textureID, int& width, int& height);
+		unsigned		UploadCompressed(const DdsTexture& dds, unsigned& textureID) const;
+		unsigned		UploadConverted(const char* buffer, unsigned size, unsigned& textureID, int& width, int& height);
+
 	public:
 		bool		mipmaping = false;
 		int			filterType = GL_LINEAR;
@@ -90,6 +200,18 @@ class ModuleTextures : public Module
 		int			wrapMode = GL_CLAMP;
 		Texture*	noCameraSelectedTexture = nullptr;
 
+		// DevIL binds images globally, every use of it from any thread holds this
+		std::mutex	devilLock;
+
+		// SDL_image found libtiff, TIF cooks can decode in parallel
+		bool		sdlTif = false;
+
+	private:
+		// By the path of the file uploaded, every reference to the same content store file shares it
+		std::map<std::string, ResidentTexture>	residentTextures;
+		std::map<unsigned, std::string>			texturePaths;		// of every resident texture id
+		unsigned								residentBytes = 0u;
+
 };		   
 
 #endif
\ No newline at end of file
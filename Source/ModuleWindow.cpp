@@ -13,6 +13,11 @@ bool ModuleWindow::Init() {
 	LOG("Init SDL window & surface");
 	bool ret = true;
 
+	if (App->headless) {
+		LOG("Headless run, no window created");
+		return ret;
+	}
+
 	if(SDL_Init(SDL_INIT_VIDEO) < 0) {
 		LOG("Error: SDL_VIDEO could not be initialized. %s\n", SDL_GetError());
 		ret = false;
@@ -58,7 +63,9 @@ bool ModuleWindow::CleanUp() {
 		SDL_DestroyWindow(window);
 	}
 
-	SDL_Quit();
+	if (!App->headless) {
+		SDL_Quit();
+	}
 	return true;
 }
 
@@ -0,0 +1,137 @@
+#include "Globals.h"
+#include "RecordingRenderBackend.h"
+#include "RenderQueue.h"
+
+RecordingRenderBackend::RecordingRenderBackend() { }
+
+RecordingRenderBackend::~RecordingRenderBackend() { }
+
+const char* RecordingRenderBackend::GetName() const {
+	return "Recording";
+}
+
+void RecordingRenderBackend::BeginFrame() {
+	commands.clear();
+	drawCalls = 0u;
+	instances = 0u;
+	triangles = 0u;
+	binds = 0u;
+	uniformUploads = 0u;
+	uploadedBytes = 0u;
+	indexBytes = 0u;
+}
+
+RenderCommand& RecordingRenderBackend::Record(RenderCommandType type) {
+	commands.push_back(RenderCommand());
+	commands.back().type = type;
+
+	return commands.back();
+}
+
+void RecordingRenderBackend::BindFramebuffer(unsigned fbo) {
+	Record(RenderCommandType::BIND_FRAMEBUFFER).args[0] = fbo;
+	++binds;
+}
+
+void RecordingRenderBackend::Clear(float red, float green, float blue, float alpha) {
+	RenderCommand& command = Record(RenderCommandType::CLEAR);
+	command.values[0] = red;
+	command.values[1] = green;
+	command.values[2] = blue;
+	command.values[3] = alpha;
+}
+
+void RecordingRenderBackend::PolygonMode(unsigned mode) {
+	Record(RenderCommandType::POLYGON_MODE).args[0] = mode;
+}
+
+void RecordingRenderBackend::UpdateUniformBuffer(unsigned buffer, unsigned offset, unsigned size, const void* data) {
+	RenderCommand& command = Record(RenderCommandType::UPDATE_UNIFORM_BUFFER);
+	command.args[0] = buffer;
+	command.args[1] = offset;
+	command.args[2] = size;
+	uploadedBytes += size;
+}
+
+void RecordingRenderBackend::UploadBuffer(unsigned target, unsigned buffer, unsigned size, const void* data) {
+	RenderCommand& command = Record(RenderCommandType::UPLOAD_BUFFER);
+	command.args[0] = target;
+	command.args[1] = buffer;
+	command.args[2] = size;
+	uploadedBytes += size;
+}
+
+void RecordingRenderBackend::UseProgram(unsigned program) {
+	Record(RenderCommandType::USE_PROGRAM).args[0] = program;
+	++binds;
+}
+
+void RecordingRenderBackend::BindVertexArray(unsigned vao) {
+	Record(RenderCommandType::BIND_VERTEX_ARRAY).args[0] = vao;
+	++binds;
+}
+
+void RecordingRenderBackend::BindTexture(unsigned unit, unsigned texture) {
+	RenderCommand& command = Record(RenderCommandType::BIND_TEXTURE);
+	command.args[0] = unit;
+	command.args[1] = texture;
+	++binds;
+}
+
+void RecordingRenderBackend::RecordUniform(unsigned program, const char* name, const float* values, unsigned valuesNumber) {
+	assert(name != nullptr && valuesNumber <= 4u);
+
+	RenderCommand& command = Record(RenderCommandType::SET_UNIFORM);
+	command.args[0] = program;
+	command.args[1] = valuesNumber;
+	command.name = name;
+
+	for (unsigned i = 0u; i < valuesNumber; ++i) {
+		command.values[i] = values[i];
+	}
+
+	++uniformUploads;
+}
+
+void RecordingRenderBackend::SetUniform1i(unsigned program, const char* name, int value) {
+	float converted = (float)value;
+	RecordUniform(program, name, &converted, 1u);
+}
+
+void RecordingRenderBackend::SetUniform1f(unsigned program, const char* name, float value) {
+	RecordUniform(program, name, &value, 1u);
+}
+
+void RecordingRenderBackend::SetUniform3fv(unsigned program, const char* name, const float* values) {
+	RecordUniform(program, name, values, 3u);
+}
+
+void RecordingRenderBackend::SetUniform4fv(unsigned program, const char* name, const float* values) {
+	RecordUniform(program, name, values, 4u);
+}
+
+void RecordingRenderBackend::DrawIndirect(const DrawElementsIndirectCommand* drawCommands, unsigned firstCommand, unsigned commandsNumber, unsigned indexSize) {
+	RenderCommand& command = Record(RenderCommandType::DRAW_INDIRECT);
+	command.args[0] = firstCommand;
+	command.args[1] = commandsNumber;
+	command.args[2] = indexSize;
+
+	++drawCalls;
+	for (unsigned i = firstCommand; i < firstCommand + commandsNumber; ++i) {
+		instances += drawCommands[i].instanceCount;
+		triangles += drawCommands[i].instanceCount * drawCommands[i].count / 3u;
+		indexBytes += drawCommands[i].instanceCount * drawCommands[i].count * indexSize;
+	}
+}
+
+unsigned RecordingRenderBackend::CountCommands(RenderCommandType type) const {
+	unsigned count = 0u;
+
+	for (std::vector<RenderCommand>::const_iterator it = commands.begin(); it != commands.end(); ++it) {
+		if (it->type == type) {
+			++count;
+		}
+	}
+
+	return count;
+}
@@ -0,0 +1,75 @@
+#ifndef __RECORDINGRENDERBACKEND_H__
+#define __RECORDINGRENDERBACKEND_H__
+
+#include "RenderBackend.h"
+#include <string>
+#include <vector>
+
+enum class RenderCommandType {
+	BIND_FRAMEBUFFER,
+	CLEAR,
+	POLYGON_MODE,
+	UPDATE_UNIFORM_BUFFER,
+	UPLOAD_BUFFER,
+	USE_PROGRAM,
+	BIND_VERTEX_ARRAY,
+	BIND_TEXTURE,
+	SET_UNIFORM,
+	DRAW_INDIRECT
+};
+
+struct RenderCommand {
+	RenderCommandType	type = RenderCommandType::CLEAR;
+	unsigned			args[4] = { 0u, 0u, 0u, 0u };
+	float				values[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	std::string			name;
+};
+
+// Never touches GL, keeps the frame as a command stream so submission can be checked and timed without a GPU
+class RecordingRenderBackend : public RenderBackend
+{
+	public:
+		RecordingRenderBackend();
+		~RecordingRenderBackend();
+
+		const char*	GetName() const override;
+		void		BeginFrame() override;
+
+		void		BindFramebuffer(unsigned fbo) override;
+		void		Clear(float red, float green, float blue, float alpha) override;
+		void		PolygonMode(unsigned mode) override;
+
+		void		UpdateUniformBuffer(unsigned buffer, unsigned offset, unsigned size, const void* data) override;
+		void		UploadBuffer(unsigned target, unsigned buffer, unsigned size, const void* data) override;
+
+		void		UseProgram(unsigned program) override;
+		void		BindVertexArray(unsigned vao) override;
+		void		BindTexture(unsigned unit, unsigned texture) override;
+
+		void		SetUniform1i(unsigned program, const char* name, int value) override;
+		void		SetUniform1f(unsigned program, const char* name, float value) override;
+		void		SetUniform3fv(unsigned program, const char* name, const float* values) override;
+		void		SetUniform4fv(unsigned program, const char* name, const float* values) override;
+
+		void		DrawIndirect(const DrawElementsIndirectCommand* commands, unsigned firstCommand, unsigned commandsNumber, unsigned indexSize) override;
+
+		unsigned	CountCommands(RenderCommandType type) const;
+
+	private:
+		RenderCommand&	Record(RenderCommandType type);
+		void			RecordUniform(unsigned program, const char* name, const float* values, unsigned valuesNumber);
+
+	public:
+		std::vector<RenderCommand>	commands;
+
+		// Per frame counters, reset on BeginFrame
+		unsigned	drawCalls = 0u;
+		unsigned	instances = 0u;
+		unsigned	triangles = 0u;
+		unsigned	binds = 0u;
+		unsigned	uniformUploads = 0u;
+		unsigned	uploadedBytes = 0u;
+		unsigned	indexBytes = 0u; // fetched by the draws
+};
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef __RENDERBACKEND_H__
+#define __RENDERBACKEND_H__
+
+struct DrawElementsIndirectCommand;
+
+// Everything the renderer submits per frame goes through here, so the GL calls can be swapped for a recorder
+class RenderBackend
+{
+	public:
+		virtual ~RenderBackend() { }
+
+		virtual const char*	GetName() const = 0;
+		virtual void		BeginFrame() { }
+
+		virtual void		BindFramebuffer(unsigned fbo) = 0;
+		virtual void		Clear(float red, float green, float blue, float alpha) = 0;
+		virtual void		PolygonMode(unsigned mode) = 0;
+
+		virtual void		UpdateUniformBuffer(unsigned buffer, unsigned offset, unsigned size, const void* data) = 0;
+		virtual void		UploadBuffer(unsigned target, unsigned buffer, unsigned size, const void* data) = 0;
+
+		virtual void		UseProgram(unsigned program) = 0;
+		virtual void		BindVertexArray(unsigned vao) = 0;
+		virtual void		BindTexture(unsigned unit, unsigned texture) = 0;
+
+		virtual void		SetUniform1i(unsigned program, const char* name, int value) = 0;
+		virtual void		SetUniform1f(unsigned program, const char* name, float value) = 0;
+		virtual void		SetUniform3fv(unsigned program, const char* name, const float* values) = 0;
+		virtual void		SetUniform4fv(unsigned program, const char* name, const float* values) = 0;
+
+		// Commands must already be uploaded to the bound indirect buffer, the array is kept for backends that loop.
+		// indexSize is in bytes, firstIndex of every command counts indices of that size.
+		virtual void		DrawIndirect(const DrawElementsIndirectCommand* commands, unsigned firstCommand, unsigned commandsNumber, unsigned indexSize) = 0;
+};
+
+#endif
@@ -0,0 +1,154 @@
+#include "RenderQueue.h"
+#include "Material.h"
+#include <algorithm>
+
+// Orders materials by what SameMaterial compares, equal ones keep their meshes next to each other to become instances
+static int CompareMaterials(const Material* first, const Material* second) {
+	if (first == second) {
+		return 0;
+	}
+
+	if (first == nullptr || second == nullptr) {
+		return (first == nullptr) ? -1 : 1;
+	}
+
+	unsigned firstMaps[] = { first->occlusionMap, first->specularMap, first->emissiveMap };
+	unsigned secondMaps[] = { second->occlusionMap, second->specularMap, second->emissiveMap };
+	for (unsigned i = 0u; i < 3u; ++i) {
+		if (firstMaps[i] != secondMaps[i]) {
+			return (firstMaps[i] < secondMaps[i]) ? -1 : 1;
+		}
+	}
+
+	const math::float4* firstColors[] = { &first->diffuseColor, &first->specularColor, &first->emissiveColor, &first->color };
+	const math::float4* secondColors[] = { &second->diffuseColor, &second->specularColor, &second->emissiveColor, &second->color };
+	for (unsigned i = 0u; i < 4u; ++i) {
+		for (unsigned j = 0u; j < 4u; ++j) {
+			if ((*firstColors[i])[j] != (*secondColors[i])[j]) {
+				return ((*firstColors[i])[j] < (*secondColors[i])[j]) ? -1 : 1;
+			}
+		}
+	}
+
+	float firstFactors[] = { first->ambientK, first->diffuseK, first->specularK, first->shininess };
+	float secondFactors[] = { second->ambientK, second->diffuseK, second->specularK, second->shininess };
+	for (unsigned i = 0u; i < 4u; ++i) {
+		if (firstFactors[i] != secondFactors[i]) {
+			return (firstFactors[i] < secondFactors[i]) ? -1 : 1;
+		}
+	}
+
+	return 0;
+}
+
+static bool RenderItemLess(const RenderItem& first, const RenderItem& second) {
+	if (first.vertexFormat != second.vertexFormat) {
+		return first.vertexFormat < second.vertexFormat;
+	}
+
+	if (first.indexSize != second.indexSize) {
+		return first.indexSize < second.indexSize;
+	}
+
+	// Textures first so different materials sharing maps stay next to each other
+	unsigned firstDiffuse = (first.material != nullptr) ? first.material->diffuseMap : 0u;
+	unsigned secondDiffuse = (second.material != nullptr) ? second.material->diffuseMap : 0u;
+	if (firstDiffuse != secondDiffuse) {
+		return firstDiffuse < secondDiffuse;
+	}
+
+	int materialOrder = CompareMaterials(first.material, second.material);
+	if (materialOrder != 0) {
+		return materialOrder < 0;
+	}
+
+	if (first.materialEnabled != second.materialEnabled) {
+		return first.materialEnabled < second.materialEnabled;
+	}
+
+	if (first.firstIndex != second.firstIndex) {
+		return first.firstIndex < second.firstIndex;
+	}
+
+	return first.baseVertex < second.baseVertex;
+}
+
+RenderQueue::RenderQueue() { }
+
+RenderQueue::~RenderQueue() { }
+
+void RenderQueue::Clear() {
+	items.clear();
+	commands.clear();
+	instances.clear();
+	batches.clear();
+}
+
+void RenderQueue::Add(const RenderItem& item) {
+	items.push_back(item);
+}
+
+void RenderQueue::Build() {
+	commands.clear();
+	instances.clear();
+	batches.clear();
+
+	// Sorting by format and material keeps state changes to one per batch, identical meshes end up together as instances
+	std::stable_sort(items.begin(), items.end(), RenderItemLess);
+
+	commands.reserve(items.size());
+	instances.reserve(items.size());
+
+	for (std::vector<RenderItem>::const_iterator it = items.begin(); it != items.end(); ++it) {
+		bool newBatch = batches.empty() || batches.back().vertexFormat != it->vertexFormat || batches.back().indexSize != it->indexSize
+			|| !SameMaterial(batches.back().material, batches.back().materialEnabled, it->material, it->materialEnabled);
+
+		if (newBatch) {
+			RenderBatch batch;
+			batch.vertexFormat = it->vertexFormat;
+			batch.indexSize = it->indexSize;
+			batch.material = it->material;
+			batch.materialEnabled = it->materialEnabled;
+			batch.firstCommand = commands.size();
+			batches.push_back(batch);
+		}
+
+		// Model matrices are read as vertex attributes, GL expects them column major
+		InstanceData instance;
+		instance.model = it->model.Transposed();
+		instance.positionOffset = math::float4(it->positionOffset, 0.0f);
+		instance.positionScale = math::float4(it->positionScale, 1.0f);
+		instances.push_back(instance);
+
+		DrawElementsIndirectCommand* previous = (!newBatch && commands.size() > 0) ? &commands.back() : nullptr;
+		if (previous != nullptr && previous->firstIndex == it->firstIndex && previous->baseVertex == it->baseVertex && previous->count == it->indicesNumber) {
+			++previous->instanceCount;
+		} else {
+			DrawElementsIndirectCommand command;
+			command.count = it->indicesNumber;
+			command.instanceCount = 1u;
+			command.firstIndex = it->firstIndex;
+			command.baseVertex = it->baseVertex;
+			command.baseInstance = instances.size() - 1;
+			commands.push_back(command);
+			++batches.back().commandsNumber;
+		}
+	}
+}
+
+bool RenderQueue::SameMaterial(const Material* first, bool firstEnabled, const Material* second, bool secondEnabled) {
+	if (first == second) {
+		return firstEnabled == secondEnabled;
+	}
+
+	if (first == nullptr || second == nullptr || firstEnabled != secondEnabled) {
+		return false;
+	}
+
+	return first->diffuseMap == second->diffuseMap && first->occlusionMap == second->occlusionMap
+		&& first->specularMap == second->specularMap && first->emissiveMap == second->emissiveMap
+		&& first->diffuseColor.Equals(second->diffuseColor) && first->specularColor.Equals(second->specularColor)
+		&& first->emissiveColor.Equals(second->emissiveColor) && first->color.Equals(second->color)
+		&& first->ambientK == second->ambientK && first->diffuseK == second->diffuseK
+		&& first->specularK == second->specularK && first->shininess == second->shininess;
+}
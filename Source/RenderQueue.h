@@ -0,0 +1,73 @@
+#ifndef __RENDERQUEUE_H__
+#define __RENDERQUEUE_H__
+
+#include <vector>
+#include "Math/float4x4.h"
+#include "Math/float4.h"
+
+struct Material;
+
+// Same layout as the GL indirect command, so the vector can be uploaded as is
+struct DrawElementsIndirectCommand {
+	unsigned	count = 0u;
+	unsigned	instanceCount = 0u;
+	unsigned	firstIndex = 0u;
+	int			baseVertex = 0;
+	unsigned	baseInstance = 0u;
+};
+
+// Per draw vertex attributes, indexed through the baseInstance of each indirect command
+// Instance data is read as vec4 attributes from this location on, one per float4 of InstanceData
+#define INSTANCE_FIRST_ATTRIBUTE 3u
+#define INSTANCE_ATTRIBUTE_VECTORS 6u
+
+struct InstanceData {
+	math::float4x4		model;			// column major
+	math::float4		positionOffset;	// dequantizes positions stored normalized to the mesh bounds
+	math::float4		positionScale;
+};
+
+struct RenderItem {
+	unsigned			vertexFormat = 0u;
+	unsigned			indexSize = sizeof(unsigned);
+	unsigned			indicesNumber = 0u;
+	unsigned			firstIndex = 0u;
+	int					baseVertex = 0;
+	const Material*		material = nullptr;
+	bool				materialEnabled = true;
+	math::float4x4		model = math::float4x4::identity;
+	math::float3		positionOffset = math::float3::zero;
+	math::float3		positionScale = math::float3::one;
+};
+
+// Consecutive commands sharing vertex format, index size and material, submitted with a single multi draw
+struct RenderBatch {
+	unsigned			vertexFormat = 0u;
+	unsigned			indexSize = sizeof(unsigned);
+	const Material*		material = nullptr;
+	bool				materialEnabled = true;
+	unsigned			firstCommand = 0u;
+	unsigned			commandsNumber = 0u;
+};
+
+// Builds the indirect command buffer on the CPU, it does not touch GL so it can run without a context
+class RenderQueue
+{
+	public:
+		RenderQueue();
+		~RenderQueue();
+
+		void		Clear();
+		void		Add(const RenderItem& item);
+		void		Build();
+
+		static bool	SameMaterial(const Material* first, bool firstEnabled, const Material* second, bool secondEnabled);
+
+	public:
+		std::vector<RenderItem>						items;
+		std::vector<DrawElementsIndirectCommand>	commands;
+		std::vector<InstanceData>					instances;
+		std::vector<RenderBatch>					batches;
+};
+
+#endif
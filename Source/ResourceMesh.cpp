@@ -0,0 +1,104 @@
+#include "Globals.h"
+#include "Application.h"
+#include "ModuleRender.h"
+#include "ResourceMesh.h"
+#include "MeshImporter.h"
+#include "GeometryArena.h"
+#include "ModuleScene.h"
+#include "par_shapes.h"
+#include <vector>
+
+ResourceMesh::ResourceMesh(const char* name) : name(name != nullptr ? name : ""), state(ResourceState::LOADING) { }
+
+ResourceMesh::~ResourceMesh() {
+	Unload();
+}
+
+// Only touches the file system and the mesh, stream jobs run it away from the GL thread
+bool ResourceMesh::Load() {
+	if (!MeshImporter::Load(&mesh, name.c_str())) {
+		MeshImporter::CleanUpStructMesh(&mesh);
+		return false;
+	}
+
+	return true;
+}
+
+// Positions, normals and uvs for every primitive, so they all share a vertex format and batch together
+bool ResourceMesh::Generate(GeometryType type, unsigned slices, unsigned stacks, float scale) {
+	par_shapes_mesh* parMesh = nullptr;
+	switch (type) {
+		case GeometryType::SPHERE:
+			parMesh = par_shapes_create_parametric_sphere(slices, stacks);
+			break;
+		case GeometryType::TORUS:
+			parMesh = par_shapes_create_torus(slices, stacks, 0.5f);
+			break;
+		case GeometryType::PLANE:
+			parMesh = par_shapes_create_plane(slices, stacks);
+			break;
+		case GeometryType::CUBE:
+			// Welded corners would average the normals of three faces
+			parMesh = par_shapes_create_cube();
+			par_shapes_unweld(parMesh, true);
+			par_shapes_compute_normals(parMesh);
+			break;
+	}
+
+	if (parMesh == nullptr) {
+		return false;
+	}
+
+	// The cube has no uvs, every face is mapped whole projecting along its normal
+	std::vector<float> uvs;
+	if (parMesh->tcoords == nullptr) {
+		uvs.resize(parMesh->npoints * 2u);
+		for (int i = 0; i < parMesh->npoints; ++i) {
+			const float* point = &parMesh->points[i * 3];
+			math::float3 normal = math::float3(&parMesh->normals[i * 3]).Abs();
+			unsigned axis = (normal.x > normal.y) ? (normal.x > normal.z ? 0u : 2u) : (normal.y > normal.z ? 1u : 2u);
+			uvs[i * 2] = point[(axis + 1u) % 3u];
+			uvs[i * 2 + 1] = point[(axis + 2u) % 3u];
+		}
+	}
+
+	par_shapes_scale(parMesh, scale, scale, scale);
+
+	MeshImporter::Cook(&mesh, parMesh->npoints, parMesh->points, parMesh->normals, parMesh->tcoords != nullptr ? parMesh->tcoords : &uvs[0]);
+
+	// Primitives are always small enough for the 16 bit indices par_shapes generates, they are taken as they are
+	static_assert(sizeof(PAR_SHAPES_T) == sizeof(unsigned short), "par_shapes indices are expected to be 16 bits");
+	mesh.indicesNumber = parMesh->ntriangles * 3;
+	mesh.indexSize = sizeof(unsigned short);
+	unsigned short* indices = new unsigned short[mesh.indicesNumber];
+	memcpy(indices, parMesh->triangles, sizeof(unsigned short) * mesh.indicesNumber);
+	mesh.indices = indices;
+
+	par_shapes_free_mesh(parMesh);
+
+	return true;
+}
+
+bool ResourceMesh::Upload() {
+	mesh.arenaHandle = App->renderer->arena->Allocate(mesh);
+	state = mesh.arenaHandle != 0u ? ResourceState::RESIDENT : ResourceState::FAILED;
+
+	return mesh.arenaHandle != 0u;
+}
+
+void ResourceMesh::Unload() {
+	// The arena goes away with the renderer, its buffers with it
+	if (App->renderer->arena != nullptr) {
+		App->renderer->arena->Free(mesh.arenaHandle);
+	}
+
+	MeshImporter::CleanUpStructMesh(&mesh);
+}
+
+bool ResourceMesh::IsResident() const {
+	return state == ResourceState::RESIDENT;
+}
+
+unsigned ResourceMesh::UploadSize() const {
+	return mesh.format.stride * mesh.verticesNumber + mesh.indexSize * mesh.indicesNumber;
+}
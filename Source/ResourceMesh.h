@@ -0,0 +1,42 @@
+#ifndef __RESOURCEMESH_H__
+#define __RESOURCEMESH_H__
+
+#include <atomic>
+#include <string>
+#include "ModuleTextures.h"
+
+#define MESH_PLACEHOLDER_EXTENT 0.5f // half size of the local box culled while a mesh streams in
+
+enum class GeometryType;
+
+enum class ResourceState {
+	LOADING,	// queued or decoding in a stream job, the mesh belongs to the job
+	LOADED,		// decoded, waiting for its turn in the per frame upload budget
+	RESIDENT,
+	FAILED
+};
+
+// Cooked mesh loaded and uploaded to the geometry arena once, shared by every component showing it.
+// Owned by ModuleLibrary, components only hold references to it.
+class ResourceMesh
+{
+	public:
+		ResourceMesh(const char* name);
+		~ResourceMesh();
+
+		bool		Load();
+		bool		Generate(GeometryType type, unsigned slices, unsigned stacks, float scale);
+		bool		Upload();
+		void		Unload();
+
+		bool		IsResident() const;
+		unsigned	UploadSize() const;
+
+	public:
+		std::string					name;				// library name, or the primitive key for generated ones
+		Mesh						mesh;
+		unsigned					references = 0u;
+		std::atomic<ResourceState>	state;
+};
+
+#endif
@@ -0,0 +1,137 @@
+#include "Globals.h"
+#include "StreamBuffer.h"
+#include "Application.h"
+#include "ModuleRender.h"
+#include "GLStateCache.h"
+#include "glew-2.1.0\include\GL\glew.h"
+#include <assert.h>
+
+#define STREAM_PERSISTENT_FLAGS (GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT)
+#define STREAM_FENCE_TIMEOUT 1000000u // 1 ms, in nanoseconds
+
+StreamBuffer::StreamBuffer() { }
+
+StreamBuffer::~StreamBuffer() {
+	CleanUp();
+}
+
+void StreamBuffer::Init(unsigned newElementSize, unsigned newRegionElements, unsigned newRegionsNumber) {
+	assert(newElementSize > 0u && newRegionElements > 0u && newRegionsNumber > 1u);
+
+	elementSize = newElementSize;
+	regionElements = newRegionElements;
+	regionsNumber = newRegionsNumber;
+	head = 0u;
+	fences.assign(regionsNumber, nullptr);
+
+	unsigned size = elementSize * regionElements * regionsNumber;
+	persistent = GLEW_ARB_buffer_storage != 0;
+
+	glGenBuffers(1, &buffer);
+	App->renderer->glState->BindBuffer(GL_ARRAY_BUFFER, buffer);
+
+	if (persistent) {
+		glBufferStorage(GL_ARRAY_BUFFER, size, nullptr, STREAM_PERSISTENT_FLAGS);
+		mapped = (char*)glMapBufferRange(GL_ARRAY_BUFFER, 0, size, STREAM_PERSISTENT_FLAGS);
+
+		if (mapped == nullptr) {
+			LOG("Warning: Stream buffer could not be mapped persistently, falling back to orphaning");
+			App->renderer->glState->DeleteBuffer(buffer);
+			glGenBuffers(1, &buffer);
+			App->renderer->glState->BindBuffer(GL_ARRAY_BUFFER, buffer);
+			persistent = false;
+		}
+	}
+
+	if (!persistent) {
+		glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_STREAM_DRAW);
+	}
+}
+
+void StreamBuffer::CleanUp() {
+	for (std::vector<__GLsync*>::iterator it = fences.begin(); it != fences.end(); ++it) {
+		if (*it != nullptr) {
+			glDeleteSync(*it);
+		}
+	}
+	fences.clear();
+
+	if (mapped != nullptr) {
+		App->renderer->glState->BindBuffer(GL_ARRAY_BUFFER, buffer);
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+		mapped = nullptr;
+	}
+
+	if (buffer != 0u) {
+		App->renderer->glState->DeleteBuffer(buffer);
+	}
+}
+
+unsigned StreamBuffer::Write(const void* data, unsigned count) {
+	assert(count > 0u && count <= regionElements);
+
+	unsigned region = head / regionElements;
+	unsigned regionEnd = (region + 1u) * regionElements;
+
+	// A write ending right on a boundary leaves head at the start of the next region without having entered it,
+	// at the end of the buffer that region is the first one again
+	if (head % regionElements == 0u && head != 0u) {
+		EnterRegion(region % regionsNumber);
+	} else if (head + count > regionEnd) {
+		// Batches never straddle two regions, the rest of this one is skipped
+		EnterRegion((region + 1u) % regionsNumber);
+	}
+
+	unsigned first = head;
+	unsigned offset = first * elementSize;
+	unsigned size = count * elementSize;
+	assert(offset + size <= elementSize * regionElements * regionsNumber);
+
+	if (persistent) {
+		memcpy(mapped + offset, data, size);
+	} else {
+		App->renderer->glState->BindBuffer(GL_ARRAY_BUFFER, buffer);
+		void* destination = glMapBufferRange(GL_ARRAY_BUFFER, offset, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+		if (destination != nullptr) {
+			memcpy(destination, data, size);
+			glUnmapBuffer(GL_ARRAY_BUFFER);
+		}
+	}
+
+	head += count;
+
+	return first;
+}
+
+void StreamBuffer::EnterRegion(unsigned region) {
+	if (persistent) {
+		// Draws already issued from the region we leave are the last ones reading it
+		unsigned previous = (region + regionsNumber - 1u) % regionsNumber;
+		fences[previous] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+		if (fences[region] != nullptr) {
+			GLenum result = glClientWaitSync(fences[region], 0, 0);
+
+			if (result == GL_TIMEOUT_EXPIRED) {
+				++waits;
+				do {
+					result = glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, STREAM_FENCE_TIMEOUT);
+				} while (result == GL_TIMEOUT_EXPIRED);
+			}
+
+			glDeleteSync(fences[region]);
+			fences[region] = nullptr;
+		}
+	} else if (region == 0u) {
+		// Fresh storage, the driver keeps the old one alive until pending draws are done
+		unsigned size = elementSize * regionElements * regionsNumber;
+		App->renderer->glState->BindBuffer(GL_ARRAY_BUFFER, buffer);
+		glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_STREAM_DRAW);
+	}
+
+	if (region == 0u) {
+		++wraps;
+	}
+
+	head = region * regionElements;
+}
@@ -0,0 +1,41 @@
+#ifndef __STREAMBUFFER_H__
+#define __STREAMBUFFER_H__
+
+#include <vector>
+
+struct __GLsync;
+
+// Ring of fixed size elements for data rewritten every frame. With ARB_buffer_storage it stays
+// mapped and every region is fenced when left, the CPU only waits if it laps the GPU.
+// Without it the buffer is orphaned on every wrap and written unsynchronized.
+class StreamBuffer
+{
+	public:
+		StreamBuffer();
+		~StreamBuffer();
+
+		void		Init(unsigned elementSize, unsigned regionElements, unsigned regionsNumber);
+		void		CleanUp();
+
+		// Returns the index of the first written element, usable as the first vertex of a draw
+		unsigned	Write(const void* data, unsigned count);
+
+	public:
+		unsigned	buffer = 0u;
+		bool		persistent = false;
+		unsigned	waits = 0u;
+		unsigned	wraps = 0u;
+
+	private:
+		void		EnterRegion(unsigned region);
+
+	private:
+		unsigned					elementSize = 0u;
+		unsigned					regionElements = 0u;
+		unsigned					regionsNumber = 0u;
+		unsigned					head = 0u; // In elements
+		char*						mapped = nullptr;
+		std::vector<__GLsync*>		fences;
+};
+
+#endif
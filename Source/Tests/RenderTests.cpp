@@ -0,0 +1,160 @@
+#include "Globals.h"
+#include "ArenaAllocator.h"
+#include "RenderQueue.h"
+#include "Material.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Tests of the render code that runs without a GL context, the program fails on the first broken check
+
+// The engine log needs the application, here it only prints
+void log(const char file[], int line, const char* format, ...) {
+	va_list arguments;
+	va_start(arguments, format);
+	vprintf(format, arguments);
+	va_end(arguments);
+	printf("\n");
+}
+
+static unsigned failures = 0u;
+
+#define CHECK(condition) if (!(condition)) { printf("FAIL %s(%d): %s\n", __FILE__, __LINE__, #condition); ++failures; }
+
+static void TestFirstFit() {
+	ArenaAllocator allocator(1024u);
+	ArenaBlock first, second, third, fitted;
+	CHECK(allocator.Allocate(100u, 16u, first) && first.offset == 0u);
+	CHECK(allocator.Allocate(100u, 16u, second) && second.offset == 112u);
+	CHECK(allocator.Allocate(100u, 16u, third) && third.offset == 224u);
+
+	// The hole left by the second block is the first one big enough, the end of the arena is not used
+	allocator.Free(second);
+	CHECK(allocator.Allocate(64u, 16u, fitted) && fitted.offset == 112u);
+	CHECK(allocator.Used() == 264u);
+
+	ArenaBlock tooBig;
+	CHECK(!allocator.Allocate(1024u, 1u, tooBig));
+	CHECK(!allocator.Allocate(0u, 1u, tooBig));
+}
+
+static void TestFreeCoalescing() {
+	ArenaAllocator allocator(300u);
+	ArenaBlock blocks[3];
+	for (unsigned i = 0u; i < 3u; ++i) {
+		CHECK(allocator.Allocate(100u, 1u, blocks[i]));
+	}
+	CHECK(allocator.FreeBlocksNumber() == 0u);
+
+	// Freed out of order, the neighbours merge on both sides
+	allocator.Free(blocks[0]);
+	allocator.Free(blocks[2]);
+	CHECK(allocator.FreeBlocksNumber() == 2u && allocator.LargestFreeBlock() == 100u);
+	CHECK(allocator.Fragmentation() == 0.5f);
+
+	allocator.Free(blocks[1]);
+	CHECK(allocator.FreeBlocksNumber() == 1u && allocator.LargestFreeBlock() == 300u);
+	CHECK(allocator.Used() == 0u && allocator.Fragmentation() == 0.0f);
+}
+
+static void TestGrow() {
+	ArenaAllocator allocator(256u);
+	ArenaBlock full, tail, grown;
+	CHECK(allocator.Allocate(200u, 4u, full));
+	CHECK(allocator.Allocate(56u, 4u, tail));
+	CHECK(!allocator.Allocate(100u, 4u, grown));
+
+	// New space starts at the old end, it merges with a freed block right before it
+	allocator.Grow(512u);
+	CHECK(allocator.Capacity() == 512u);
+	CHECK(allocator.Allocate(100u, 4u, grown) && grown.offset == 256u);
+
+	allocator.Free(grown);
+	allocator.Free(tail);
+	CHECK(allocator.FreeBlocksNumber() == 1u && allocator.LargestFreeBlock() == 312u);
+
+	// Shrinking is ignored
+	allocator.Grow(128u);
+	CHECK(allocator.Capacity() == 512u);
+}
+
+static void TestDefragment() {
+	ArenaAllocator allocator(1024u);
+	ArenaBlock blocks[4];
+	for (unsigned i = 0u; i < 4u; ++i) {
+		CHECK(allocator.Allocate(100u, 32u, blocks[i]));
+	}
+	allocator.Free(blocks[0]);
+	allocator.Free(blocks[2]);
+	CHECK(allocator.FreeBlocksNumber() == 3u);
+
+	std::vector<ArenaMove> moves;
+	allocator.Defragment(moves);
+	CHECK(moves.size() == 2u);
+	CHECK(moves.size() == 2u && moves[0].from == blocks[1].offset && moves[0].to == 0u && moves[0].size == 100u);
+	CHECK(moves.size() == 2u && moves[1].from == blocks[3].offset && moves[1].to == 128u && moves[1].size == 100u);
+
+	// Alignment padding stays free, the rest is a single block at the end
+	CHECK(allocator.Used() == 200u && allocator.LargestFreeBlock() == 1024u - 228u);
+
+	ArenaBlock moved;
+	moved.offset = 128u;
+	allocator.Free(moved);
+	moved.offset = 0u;
+	allocator.Free(moved);
+	CHECK(allocator.Used() == 0u && allocator.FreeBlocksNumber() == 1u);
+}
+
+static void TestRenderQueue() {
+	Material stone;
+	Material wood;
+	wood.diffuseMap = 7u;
+	Material woodCopy = wood;
+
+	RenderQueue queue;
+	RenderItem item;
+	item.vertexFormat = 1u;
+	item.indicesNumber = 36u;
+	item.material = &stone;
+	queue.Add(item);
+
+	item.material = &wood;
+	queue.Add(item);
+
+	// Equal materials batch together, the same mesh twice becomes a second instance
+	item.material = &woodCopy;
+	queue.Add(item);
+
+	item.firstIndex = 36u;
+	item.material = &stone;
+	queue.Add(item);
+
+	item.vertexFormat = 2u;
+	queue.Add(item);
+
+	queue.Build();
+	CHECK(queue.instances.size() == 5u);
+	CHECK(queue.batches.size() == 3u);
+	CHECK(queue.commands.size() == 4u);
+	if (queue.batches.size() == 3u && queue.commands.size() == 4u) {
+		CHECK(queue.batches[0].material == &stone && queue.batches[0].commandsNumber == 2u);
+		CHECK(queue.batches[1].material == &wood && queue.batches[1].firstCommand == 2u && queue.batches[1].commandsNumber == 1u);
+		CHECK(queue.commands[2].instanceCount == 2u && queue.commands[2].baseInstance == 2u);
+		CHECK(queue.batches[2].vertexFormat == 2u && queue.commands[3].baseInstance == 4u);
+	}
+
+	queue.Clear();
+	CHECK(queue.items.empty() && queue.commands.empty() && queue.instances.empty() && queue.batches.empty());
+}
+
+int main(int argc, char** argv) {
+	TestFirstFit();
+	TestFreeCoalescing();
+	TestGrow();
+	TestDefragment();
+	TestRenderQueue();
+
+	printf("%s, %u failed checks\n", failures == 0u ? "OK" : "FAIL", failures);
+
+	return failures == 0u ? EXIT_SUCCESS : EXIT_FAILURE;
+}
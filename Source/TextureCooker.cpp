@@ -0,0 +1,368 @@
+#include "Globals.h"
+#include "Application.h"
+#include "ModuleTextures.h"
+#include "TextureCooker.h"
+#include "DdsFile.h"
+#include "SDL/include/SDL.h"
+#include "SDL_image/include/SDL_image.h"
+#include "DevIL/include/IL/il.h"
+#include "DevIL/include/IL/ilu.h"
+#include <ctype.h>
+#include <math.h>
+#include <xmmintrin.h>
+#include <limits.h>
+#include <mutex>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#pragma comment( lib, "./Source/SDL_image/libx86/SDL2_image.lib" )
+
+#define BC3_BLOCK_BYTES 16u
+#define SRGB_ENCODE_STEPS 4096u // linear values are rounded to these many before the table lookup
+
+bool TextureCooker::Decode(const char* buffer, unsigned size, const char* extension, TextureImage& image) {
+	std::string type(extension != nullptr ? extension : "");
+	for (std::string::iterator it = type.begin(); it != type.end(); ++it) {
+		*it = (char)toupper(*it);
+	}
+
+	// TGA has no signature, SDL_image only reads it when told the type
+	bool sdlType = type == "PNG" || type == "TGA";
+
+	// TIF needs libtiff next to SDL2_image.dll, without it those cooks are serialized on DevIL's lock
+	if (type == "TIF" || type == "TIFF") {
+		sdlType = App->textures->sdlTif;
+		type = "TIF";
+	}
+
+	if (sdlType && DecodeSDL(buffer, size, type.c_str(), image)) {
+		return true;
+	}
+
+	return DecodeDevIL(buffer, size, image);
+}
+
+bool TextureCooker::DecodeSDL(const char* buffer, unsigned size, const char* type, TextureImage& image) {
+	SDL_Surface* surface = IMG_LoadTyped_RW(SDL_RWFromConstMem(buffer, size), 1, type);
+	if (surface == nullptr) {
+		return false;
+	}
+
+	SDL_Surface* converted = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGBA32, 0);
+	SDL_FreeSurface(surface);
+	if (converted == nullptr) {
+		return false;
+	}
+
+	image.width = converted->w;
+	image.height = converted->h;
+	image.pixels.resize(image.width * image.height * 4u);
+
+	SDL_LockSurface(converted);
+	for (unsigned y = 0u; y < image.height; ++y) {
+		memcpy(&image.pixels[y * image.width * 4u], (const unsigned char*)converted->pixels + y * converted->pitch, image.width * 4u);
+	}
+	SDL_UnlockSurface(converted);
+	SDL_FreeSurface(converted);
+
+	return image.width > 0u && image.height > 0u;
+}
+
+bool TextureCooker::DecodeDevIL(const char* buffer, unsigned size, TextureImage& image) {
+	// DevIL binds images globally, only one thread may use it at a time
+	std::lock_guard<std::mutex> lock(App->textures->devilLock);
+
+	ILuint imageId = 0u;
+	ilGenImages(1, &imageId);
+	ilBindImage(imageId);
+
+	bool result = ilLoadL(IL_TYPE_UNKNOWN, (const void*)buffer, size) && ilConvertImage(IL_RGBA, IL_UNSIGNED_BYTE);
+	if (result) {
+		ILinfo imageInfo;
+		iluGetImageInfo(&imageInfo);
+		if (imageInfo.Origin == IL_ORIGIN_LOWER_LEFT) {
+			iluFlipImage();
+		}
+
+		image.width = ilGetInteger(IL_IMAGE_WIDTH);
+		image.height = ilGetInteger(IL_IMAGE_HEIGHT);
+		image.pixels.resize(image.width * image.height * 4u);
+		memcpy(&image.pixels[0], ilGetData(), image.pixels.size());
+	}
+
+	ilDeleteImages(1, &imageId);
+
+	return result && image.width > 0u && image.height > 0u;
+}
+
+void TextureCooker::FitToMaxSize(TextureImage& image, unsigned maxSize) {
+	if (image.width <= maxSize && image.height <= maxSize) {
+		return;
+	}
+
+	std::vector<float> linear;
+	std::vector<float> half;
+	ToLinear(image, linear);
+	while (image.width > maxSize || image.height > maxSize) {
+		HalveLinear(linear, image.width, image.height, half);
+		image.width = MAX(image.width / 2u, 1u);
+		image.height = MAX(image.height / 2u, 1u);
+		linear.swap(half);
+	}
+	FromLinear(linear, image.width, image.height, image);
+}
+
+void TextureCooker::GenerateMips(const TextureImage& image, std::vector<TextureImage>& mips) {
+	mips.clear();
+
+	// Every level comes from the linear values of the previous one, only the stored copy is rounded to bytes
+	std::vector<float> linear;
+	std::vector<float> half;
+	ToLinear(image, linear);
+	unsigned width = image.width;
+	unsigned height = image.height;
+	while (width > 1u || height > 1u) {
+		HalveLinear(linear, width, height, half);
+		width = MAX(width / 2u, 1u);
+		height = MAX(height / 2u, 1u);
+		linear.swap(half);
+
+		mips.push_back(TextureImage());
+		FromLinear(linear, width, height, mips.back());
+	}
+}
+
+void TextureCooker::FlipVertical(TextureImage& image) {
+	unsigned rowBytes = image.width * 4u;
+	std::vector<unsigned char> row(rowBytes);
+	for (unsigned top = 0u, bottom = image.height - 1u; top < bottom; ++top, --bottom) {
+		memcpy(&row[0], &image.pixels[top * rowBytes], rowBytes);
+		memcpy(&image.pixels[top * rowBytes], &image.pixels[bottom * rowBytes], rowBytes);
+		memcpy(&image.pixels[bottom * rowBytes], &row[0], rowBytes);
+	}
+}
+
+static float SrgbToLinear(float value) {
+	return (value <= 0.04045f) ? value / 12.92f : powf((value + 0.055f) / 1.055f, 2.4f);
+}
+
+static float LinearToSrgb(float value) {
+	return (value <= 0.0031308f) ? value * 12.92f : 1.055f * powf(value, 1.0f / 2.4f) - 0.055f;
+}
+
+void TextureCooker::ToLinear(const TextureImage& image, std::vector<float>& linear) {
+	// Built once, the first import job to get here fills it
+	static struct DecodeTable {
+		float values[256];
+		DecodeTable() {
+			for (unsigned i = 0u; i < 256u; ++i) {
+				values[i] = SrgbToLinear(i / 255.0f);
+			}
+		}
+	} decode;
+
+	unsigned pixelsNumber = image.width * image.height;
+	linear.resize(pixelsNumber * 4u);
+	for (unsigned i = 0u; i < pixelsNumber; ++i) {
+		linear[i * 4u] = decode.values[image.pixels[i * 4u]];
+		linear[i * 4u + 1u] = decode.values[image.pixels[i * 4u + 1u]];
+		linear[i * 4u + 2u] = decode.values[image.pixels[i * 4u + 2u]];
+		linear[i * 4u + 3u] = image.pixels[i * 4u + 3u] / 255.0f;
+	}
+}
+
+void TextureCooker::FromLinear(const std::vector<float>& linear, unsigned width, unsigned height, TextureImage& image) {
+	static struct EncodeTable {
+		unsigned char values[SRGB_ENCODE_STEPS + 1u];
+		EncodeTable() {
+			for (unsigned i = 0u; i <= SRGB_ENCODE_STEPS; ++i) {
+				values[i] = (unsigned char)(LinearToSrgb((float)i / SRGB_ENCODE_STEPS) * 255.0f + 0.5f);
+			}
+		}
+	} encode;
+
+	image.width = width;
+	image.height = height;
+	image.pixels.resize(width * height * 4u);
+	for (unsigned i = 0u; i < width * height; ++i) {
+		for (unsigned c = 0u; c < 3u; ++c) {
+			float value = MIN(MAX(linear[i * 4u + c], 0.0f), 1.0f);
+			image.pixels[i * 4u + c] = encode.values[(unsigned)(value * SRGB_ENCODE_STEPS + 0.5f)];
+		}
+		image.pixels[i * 4u + 3u] = (unsigned char)(MIN(MAX(linear[i * 4u + 3u], 0.0f), 1.0f) * 255.0f + 0.5f);
+	}
+}
+
+void TextureCooker::HalveLinear(const std::vector<float>& linear, unsigned width, unsigned height, std::vector<float>& half) {
+	unsigned halfWidth = MAX(width / 2u, 1u);
+	unsigned halfHeight = MAX(height / 2u, 1u);
+	half.resize(halfWidth * halfHeight * 4u);
+
+	// A side of one pixel averages the same pixel twice
+	unsigned stepX = (width > 1u) ? 4u : 0u;
+	unsigned stepY = (height > 1u) ? width * 4u : 0u;
+	const __m128 quarter = _mm_set1_ps(0.25f);
+	for (unsigned y = 0u; y < halfHeight; ++y) {
+		const float* row = &linear[(y * 2u) * width * 4u];
+		float* target = &half[y * halfWidth * 4u];
+		for (unsigned x = 0u; x < halfWidth; ++x) {
+			const float* source = row + x * 8u;
+			__m128 top = _mm_add_ps(_mm_loadu_ps(source), _mm_loadu_ps(source + stepX));
+			__m128 bottom = _mm_add_ps(_mm_loadu_ps(source + stepY), _mm_loadu_ps(source + stepY + stepX));
+			_mm_storeu_ps(target + x * 4u, _mm_mul_ps(_mm_add_ps(top, bottom), quarter));
+		}
+	}
+}
+
+void TextureCooker::CompressBC3(const TextureImage& image, DdsLevel& level) {
+	level.width = image.width;
+	level.height = image.height;
+
+	unsigned blocksX = (image.width + TEXTURE_BLOCK_SIZE - 1u) / TEXTURE_BLOCK_SIZE;
+	unsigned blocksY = (image.height + TEXTURE_BLOCK_SIZE - 1u) / TEXTURE_BLOCK_SIZE;
+	level.blocks.resize(blocksX * blocksY * BC3_BLOCK_BYTES);
+
+	unsigned char block[TEXTURE_BLOCK_SIZE * TEXTURE_BLOCK_SIZE * 4u];
+	for (unsigned by = 0u; by < blocksY; ++by) {
+		for (unsigned bx = 0u; bx < blocksX; ++bx) {
+			for (unsigned y = 0u; y < TEXTURE_BLOCK_SIZE; ++y) {
+				unsigned sourceY = MIN(by * TEXTURE_BLOCK_SIZE + y, image.height - 1u);
+				for (unsigned x = 0u; x < TEXTURE_BLOCK_SIZE; ++x) {
+					unsigned sourceX = MIN(bx * TEXTURE_BLOCK_SIZE + x, image.width - 1u);
+					memcpy(&block[(y * TEXTURE_BLOCK_SIZE + x) * 4u], &image.pixels[(sourceY * image.width + sourceX) * 4u], 4u);
+				}
+			}
+
+			unsigned char* output = &level.blocks[(by * blocksX + bx) * BC3_BLOCK_BYTES];
+			CompressAlphaBlock(block, output);
+			CompressColorBlock(block, output + BC3_BLOCK_BYTES / 2u);
+		}
+	}
+}
+
+static unsigned short PackRgb565(const int* color) {
+	return (unsigned short)((((color[0] * 31 + 127) / 255) << 11) | (((color[1] * 63 + 127) / 255) << 5) | ((color[2] * 31 + 127) / 255));
+}
+
+static void UnpackRgb565(unsigned short packed, int* color) {
+	int r = (packed >> 11) & 31;
+	int g = (packed >> 5) & 63;
+	int b = packed & 31;
+	color[0] = (r << 3) | (r >> 2);
+	color[1] = (g << 2) | (g >> 4);
+	color[2] = (b << 3) | (b >> 2);
+}
+
+// Endpoints on the diagonal of the color bounding box that follows the colors, inset a bit so the
+// extremes fall between palette entries, then every pixel takes the closest of the four colors
+void TextureCooker::CompressColorBlock(const unsigned char* block, unsigned char* output) {
+	int minimum[3] = { 255, 255, 255 };
+	int maximum[3] = { 0, 0, 0 };
+	int mean[3] = { 0, 0, 0 };
+	for (unsigned i = 0u; i < 16u; ++i) {
+		for (unsigned c = 0u; c < 3u; ++c) {
+			minimum[c] = MIN(minimum[c], (int)block[i * 4u + c]);
+			maximum[c] = MAX(maximum[c], (int)block[i * 4u + c]);
+			mean[c] += block[i * 4u + c];
+		}
+	}
+
+	// Red and blue run against green when they correlate negatively, the box diagonal flips with them
+	int covarianceRG = 0;
+	int covarianceBG = 0;
+	for (unsigned i = 0u; i < 16u; ++i) {
+		int g = block[i * 4u + 1u] * 16 - mean[1];
+		covarianceRG += (block[i * 4u] * 16 - mean[0]) * g;
+		covarianceBG += (block[i * 4u + 2u] * 16 - mean[2]) * g;
+	}
+	if (covarianceRG < 0) {
+		int swap = minimum[0]; minimum[0] = maximum[0]; maximum[0] = swap;
+	}
+	if (covarianceBG < 0) {
+		int swap = minimum[2]; minimum[2] = maximum[2]; maximum[2] = swap;
+	}
+
+	int endpoints[2][3];
+	for (unsigned c = 0u; c < 3u; ++c) {
+		int inset = (maximum[c] - minimum[c]) / 16;
+		endpoints[0][c] = MIN(MAX(maximum[c] - inset, 0), 255);
+		endpoints[1][c] = MIN(MAX(minimum[c] + inset, 0), 255);
+	}
+
+	unsigned short color0 = PackRgb565(endpoints[0]);
+	unsigned short color1 = PackRgb565(endpoints[1]);
+	unsigned indices = 0u;
+	if (color0 != color1) {
+		// The four color mode needs the first endpoint to be the bigger one
+		if (color0 < color1) {
+			unsigned short swap = color0; color0 = color1; color1 = swap;
+		}
+
+		int palette[4][3];
+		UnpackRgb565(color0, palette[0]);
+		UnpackRgb565(color1, palette[1]);
+		for (unsigned c = 0u; c < 3u; ++c) {
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+
+		for (unsigned i = 0u; i < 16u; ++i) {
+			unsigned best = 0u;
+			int bestDistance = INT_MAX;
+			for (unsigned p = 0u; p < 4u; ++p) {
+				int distance = 0;
+				for (unsigned c = 0u; c < 3u; ++c) {
+					int difference = (int)block[i * 4u + c] - palette[p][c];
+					distance += difference * difference;
+				}
+				if (distance < bestDistance) {
+					best = p;
+					bestDistance = distance;
+				}
+			}
+			indices |= best << (i * 2u);
+		}
+	}
+
+	memcpy(output, &color0, sizeof(unsigned short));
+	memcpy(output + 2, &color1, sizeof(unsigned short));
+	memcpy(output + 4, &indices, sizeof(unsigned));
+}
+
+// Eight interpolated values between the extremes, three bits per pixel packed from the lowest
+void TextureCooker::CompressAlphaBlock(const unsigned char* block, unsigned char* output) {
+	int alpha0 = 0;
+	int alpha1 = 255;
+	for (unsigned i = 0u; i < 16u; ++i) {
+		alpha0 = MAX(alpha0, (int)block[i * 4u + 3u]);
+		alpha1 = MIN(alpha1, (int)block[i * 4u + 3u]);
+	}
+
+	unsigned long long indices = 0u;
+	if (alpha0 != alpha1) {
+		int palette[8] = { alpha0, alpha1 };
+		for (int p = 1; p < 7; ++p) {
+			palette[p + 1] = ((7 - p) * alpha0 + p * alpha1) / 7;
+		}
+
+		for (unsigned i = 0u; i < 16u; ++i) {
+			unsigned long long best = 0u;
+			int bestDistance = INT_MAX;
+			for (unsigned p = 0u; p < 8u; ++p) {
+				int distance = abs((int)block[i * 4u + 3u] - palette[p]);
+				if (distance < bestDistance) {
+					best = p;
+					bestDistance = distance;
+				}
+			}
+			indices |= best << (i * 3u);
+		}
+	}
+
+	output[0] = (unsigned char)alpha0;
+	output[1] = (unsigned char)alpha1;
+	for (unsigned i = 0u; i < 6u; ++i) {
+		output[2u + i] = (unsigned char)(indices >> (i * 8u));
+	}
+}
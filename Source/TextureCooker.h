@@ -0,0 +1,50 @@
+#ifndef __TEXTURECOOKER_H__
+#define __TEXTURECOOKER_H__
+
+#include <vector>
+
+struct DdsLevel;
+
+#define TEXTURE_MAX_SIZE 4096u // bigger sources are halved until they fit
+#define TEXTURE_BLOCK_SIZE 4u
+
+// Decoded texture, rows from the top, four bytes per pixel
+struct TextureImage {
+	unsigned					width = 0u;
+	unsigned					height = 0u;
+	std::vector<unsigned char>	pixels;
+};
+
+// Thread safe texture cooking, every step works on its own image so import jobs run it concurrently.
+// Only the DevIL fallback decoder is serialized, behind the lock of ModuleTextures.
+class TextureCooker
+{
+	public:
+		// PNG, TGA and, when SDL_image found libtiff, TIF are decoded by SDL_image, the rest and any failure by DevIL
+		static bool		Decode(const char* buffer, unsigned size, const char* extension, TextureImage& image);
+		static void		FitToMaxSize(TextureImage& image, unsigned maxSize);
+
+		// Every level after the first down to 1x1, averaged in linear space from the previous one
+		static void		GenerateMips(const TextureImage& image, std::vector<TextureImage>& mips);
+
+		// Rows from the bottom, the order OpenGL uploads them in
+		static void		FlipVertical(TextureImage& image);
+
+		// DXT5, 16 bytes per 4x4 block, the blocks over the edges repeat the last pixels
+		static void		CompressBC3(const TextureImage& image, DdsLevel& level);
+
+	private:
+		static bool		DecodeSDL(const char* buffer, unsigned size, const char* type, TextureImage& image);
+		static bool		DecodeDevIL(const char* buffer, unsigned size, TextureImage& image);
+
+		// Colors are sRGB, they are filtered as light, alpha is already linear. Four floats per pixel.
+		static void		ToLinear(const TextureImage& image, std::vector<float>& linear);
+		static void		FromLinear(const std::vector<float>& linear, unsigned width, unsigned height, TextureImage& image);
+
+		// 2x2 box filter with SSE, a pixel per register, odd sizes drop their last row or column
+		static void		HalveLinear(const std::vector<float>& linear, unsigned width, unsigned height, std::vector<float>& half);
+		static void		CompressColorBlock(const unsigned char* block, unsigned char* output);
+		static void		CompressAlphaBlock(const unsigned char* block, unsigned char* output);
+};
+
+#endif
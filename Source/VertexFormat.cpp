@@ -0,0 +1,291 @@
+#include "Globals.h"
+#include "VertexFormat.h"
+#include "glew-2.1.0\include\GL\glew.h"
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+#define KEY_BITS_PER_ATTRIBUTE 8u
+
+static float Clamp(float value, float minimum, float maximum) {
+	return (value < minimum) ? minimum : (value > maximum) ? maximum : value;
+}
+
+static unsigned short FloatToHalf(float value) {
+	unsigned bits = 0u;
+	memcpy(&bits, &value, sizeof(float));
+
+	unsigned sign = (bits >> 16u) & 0x8000u;
+	int exponent = (int)((bits >> 23u) & 0xFFu) - 127 + 15;
+	unsigned mantissa = bits & 0x7FFFFFu;
+
+	if (exponent <= 0) {
+		// Too small even for a denormal half, flushed to zero
+		if (exponent < -10) {
+			return (unsigned short)sign;
+		}
+		mantissa |= 0x800000u;
+		unsigned shift = (unsigned)(14 - exponent);
+		unsigned half = mantissa >> shift;
+		half += (mantissa >> (shift - 1u)) & 1u;
+		return (unsigned short)(sign | half);
+	}
+
+	if (exponent >= 31) {
+		return (unsigned short)(sign | 0x7C00u);
+	}
+
+	unsigned half = sign | ((unsigned)exponent << 10u) | (mantissa >> 13u);
+	// Round to nearest, a carry into the exponent is still the right value
+	half += (mantissa >> 12u) & 1u;
+	return (unsigned short)half;
+}
+
+static float HalfToFloat(unsigned short half) {
+	unsigned sign = (half & 0x8000u) << 16u;
+	unsigned exponent = (half >> 10u) & 0x1Fu;
+	unsigned mantissa = half & 0x3FFu;
+
+	float value = 0.0f;
+	if (exponent == 0u) {
+		value = ldexpf((float)mantissa, -24);
+	} else if (exponent == 31u) {
+		value = (mantissa == 0u) ? INFINITY : NAN;
+	} else {
+		value = ldexpf((float)(mantissa | 0x400u), (int)exponent - 25);
+	}
+
+	return sign != 0u ? -value : value;
+}
+
+static void StoreComponent(char* destination, VertexComponentType type, bool normalized, float value) {
+	switch (type) {
+		case COMPONENT_FLOAT:
+			memcpy(destination, &value, sizeof(float));
+			break;
+		case COMPONENT_HALF: {
+			unsigned short half = FloatToHalf(value);
+			memcpy(destination, &half, sizeof(half));
+			break;
+		}
+		case COMPONENT_SHORT: {
+			short stored = (short)(normalized ? roundf(Clamp(value, -1.0f, 1.0f) * 32767.0f) : roundf(Clamp(value, -32768.0f, 32767.0f)));
+			memcpy(destination, &stored, sizeof(stored));
+			break;
+		}
+		case COMPONENT_UNSIGNED_SHORT: {
+			unsigned short stored = (unsigned short)(normalized ? roundf(Clamp(value, 0.0f, 1.0f) * 65535.0f) : roundf(Clamp(value, 0.0f, 65535.0f)));
+			memcpy(destination, &stored, sizeof(stored));
+			break;
+		}
+		case COMPONENT_BYTE: {
+			signed char stored = (signed char)(normalized ? roundf(Clamp(value, -1.0f, 1.0f) * 127.0f) : roundf(Clamp(value, -128.0f, 127.0f)));
+			memcpy(destination, &stored, sizeof(stored));
+			break;
+		}
+		default:
+			break;
+	}
+}
+
+// Same conversions GL applies to normalized attributes
+static float LoadComponent(const char* source, VertexComponentType type, bool normalized) {
+	switch (type) {
+		case COMPONENT_FLOAT: {
+			float value;
+			memcpy(&value, source, sizeof(float));
+			return value;
+		}
+		case COMPONENT_HALF: {
+			unsigned short half;
+			memcpy(&half, source, sizeof(half));
+			return HalfToFloat(half);
+		}
+		case COMPONENT_SHORT: {
+			short stored;
+			memcpy(&stored, source, sizeof(stored));
+			return normalized ? fmaxf(stored / 32767.0f, -1.0f) : (float)stored;
+		}
+		case COMPONENT_UNSIGNED_SHORT: {
+			unsigned short stored;
+			memcpy(&stored, source, sizeof(stored));
+			return normalized ? stored / 65535.0f : (float)stored;
+		}
+		case COMPONENT_BYTE: {
+			signed char stored;
+			memcpy(&stored, source, sizeof(stored));
+			return normalized ? fmaxf(stored / 127.0f, -1.0f) : (float)stored;
+		}
+		default:
+			return 0.0f;
+	}
+}
+
+// Projects the unit normal on the octahedron and folds the lower half over the upper one
+static void EncodeOctahedral(const float* normal, float* encoded) {
+	float length = fabsf(normal[0]) + fabsf(normal[1]) + fabsf(normal[2]);
+	float x = (length > 0.0f) ? normal[0] / length : 0.0f;
+	float y = (length > 0.0f) ? normal[1] / length : 0.0f;
+
+	if (normal[2] < 0.0f) {
+		float foldedX = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		float foldedY = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+		x = foldedX;
+		y = foldedY;
+	}
+
+	encoded[0] = x;
+	encoded[1] = y;
+}
+
+static void DecodeOctahedral(const float* encoded, float* normal) {
+	float x = encoded[0];
+	float y = encoded[1];
+	float z = 1.0f - fabsf(x) - fabsf(y);
+
+	if (z < 0.0f) {
+		float unfoldedX = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		float unfoldedY = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+		x = unfoldedX;
+		y = unfoldedY;
+	}
+
+	float length = sqrtf(x * x + y * y + z * z);
+	normal[0] = x / length;
+	normal[1] = y / length;
+	normal[2] = z / length;
+}
+
+VertexFormat::VertexFormat() { }
+
+VertexFormat::~VertexFormat() { }
+
+void VertexFormat::Clear() {
+	for (unsigned i = 0u; i < ATTRIBUTE_COUNT; ++i) {
+		attributes[i] = VertexAttribute();
+	}
+
+	stride = 0u;
+}
+
+void VertexFormat::AddAttribute(VertexAttributeType attribute, unsigned components, VertexComponentType type, bool normalized) {
+	assert(attribute < ATTRIBUTE_COUNT && components > 0u && components <= 4u);
+	assert(!attributes[attribute].enabled);
+
+	VertexAttribute& added = attributes[attribute];
+	added.enabled = true;
+	added.components = components;
+	added.type = type;
+	added.normalized = normalized;
+	added.offset = stride;
+
+	// Keep every attribute 4 bytes aligned, some drivers fall off the fast path otherwise
+	stride += (components * ComponentSize(type) + 3u) & ~3u;
+}
+
+bool VertexFormat::Has(VertexAttributeType attribute) const {
+	return attributes[attribute].enabled;
+}
+
+bool VertexFormat::IsOctahedral(VertexAttributeType attribute) const {
+	return attribute == ATTRIBUTE_NORMAL && attributes[attribute].enabled && attributes[attribute].components == 2u;
+}
+
+unsigned VertexFormat::Key() const {
+	unsigned key = 0u;
+
+	// enabled (1) | normalized (1) | type (3) | components - 1 (3)
+	for (unsigned i = 0u; i < ATTRIBUTE_COUNT; ++i) {
+		const VertexAttribute& attribute = attributes[i];
+		if (attribute.enabled) {
+			unsigned bits = 1u | (attribute.normalized ? 2u : 0u) | ((unsigned)attribute.type << 2u) | ((attribute.components - 1u) << 5u);
+			key |= bits << (i * KEY_BITS_PER_ATTRIBUTE);
+		}
+	}
+
+	return key;
+}
+
+bool VertexFormat::FromKey(unsigned key) {
+	Clear();
+
+	for (unsigned i = 0u; i < ATTRIBUTE_COUNT; ++i) {
+		unsigned bits = (key >> (i * KEY_BITS_PER_ATTRIBUTE)) & 0xFFu;
+		if ((bits & 1u) == 0u) {
+			continue;
+		}
+
+		unsigned type = (bits >> 2u) & 7u;
+		if (type >= COMPONENT_TYPE_COUNT) {
+			Clear();
+			return false;
+		}
+
+		AddAttribute((VertexAttributeType)i, ((bits >> 5u) & 7u) + 1u, (VertexComponentType)type, (bits & 2u) != 0u);
+	}
+
+	return Has(ATTRIBUTE_POSITION);
+}
+
+void VertexFormat::WriteAttribute(char* vertex, VertexAttributeType attribute, const float* values) const {
+	const VertexAttribute& written = attributes[attribute];
+	if (!written.enabled) {
+		return;
+	}
+
+	float encoded[2];
+	if (IsOctahedral(attribute)) {
+		EncodeOctahedral(values, encoded);
+		values = encoded;
+	}
+
+	unsigned componentSize = ComponentSize(written.type);
+	for (unsigned i = 0u; i < written.components; ++i) {
+		StoreComponent(vertex + written.offset + i * componentSize, written.type, written.normalized, values[i]);
+	}
+}
+
+void VertexFormat::ReadAttribute(const char* vertex, VertexAttributeType attribute, float* values) const {
+	const VertexAttribute& read = attributes[attribute];
+	if (!read.enabled) {
+		return;
+	}
+
+	float loaded[4];
+	unsigned componentSize = ComponentSize(read.type);
+	for (unsigned i = 0u; i < read.components; ++i) {
+		loaded[i] = LoadComponent(vertex + read.offset + i * componentSize, read.type, read.normalized);
+	}
+
+	if (IsOctahedral(attribute)) {
+		DecodeOctahedral(loaded, values);
+	} else {
+		memcpy(values, loaded, sizeof(float) * read.components);
+	}
+}
+
+void VertexFormat::SetupAttributes() const {
+	static const unsigned glTypes[COMPONENT_TYPE_COUNT] = { GL_FLOAT, GL_HALF_FLOAT, GL_SHORT, GL_UNSIGNED_SHORT, GL_BYTE };
+
+	for (unsigned i = 0u; i < ATTRIBUTE_COUNT; ++i) {
+		const VertexAttribute& attribute = attributes[i];
+
+		if (attribute.enabled) {
+			glEnableVertexAttribArray(i);
+			glVertexAttribPointer(i, attribute.components, glTypes[attribute.type], attribute.normalized ? GL_TRUE : GL_FALSE, stride, (void*)attribute.offset);
+		} else {
+			glDisableVertexAttribArray(i);
+		}
+	}
+}
+
+unsigned VertexFormat::ComponentSize(VertexComponentType type) {
+	switch (type) {
+		case COMPONENT_FLOAT:			return sizeof(float);
+		case COMPONENT_HALF:			return sizeof(unsigned short);
+		case COMPONENT_SHORT:			return sizeof(short);
+		case COMPONENT_UNSIGNED_SHORT:	return sizeof(unsigned short);
+		case COMPONENT_BYTE:			return sizeof(char);
+		default:						return 0u;
+	}
+}
@@ -0,0 +1,61 @@
+#ifndef __VERTEXFORMAT_H__
+#define __VERTEXFORMAT_H__
+
+// Attribute i is bound to shader location i
+enum VertexAttributeType {
+	ATTRIBUTE_POSITION = 0,
+	ATTRIBUTE_NORMAL,
+	ATTRIBUTE_UV,
+	ATTRIBUTE_COUNT
+};
+
+// Stored in format keys, append new types at the end
+enum VertexComponentType {
+	COMPONENT_FLOAT = 0,
+	COMPONENT_HALF,
+	COMPONENT_SHORT,
+	COMPONENT_UNSIGNED_SHORT,
+	COMPONENT_BYTE,
+	COMPONENT_TYPE_COUNT
+};
+
+struct VertexAttribute {
+	bool				enabled = false;
+	unsigned			components = 0u;
+	VertexComponentType	type = COMPONENT_FLOAT;
+	bool				normalized = false;
+	unsigned			offset = 0u;
+};
+
+// Layout of one interleaved vertex. Attributes are packed in the order they are added.
+// A normal with two components is octahedral encoded, reads and writes still take three floats.
+class VertexFormat
+{
+	public:
+		VertexFormat();
+		~VertexFormat();
+
+		void		Clear();
+		void		AddAttribute(VertexAttributeType attribute, unsigned components, VertexComponentType type = COMPONENT_FLOAT, bool normalized = false);
+		bool		Has(VertexAttributeType attribute) const;
+		bool		IsOctahedral(VertexAttributeType attribute) const;
+
+		// Packs the whole layout in 8 bits per attribute, used to key pools, batches and files
+		unsigned	Key() const;
+		bool		FromKey(unsigned key);
+
+		// Converts from/to floats, so callers do not care about the stored component type
+		void		WriteAttribute(char* vertex, VertexAttributeType attribute, const float* values) const;
+		void		ReadAttribute(const char* vertex, VertexAttributeType attribute, float* values) const;
+
+		// Sets the attribute pointers of the bound VAO over the bound GL_ARRAY_BUFFER
+		void		SetupAttributes() const;
+
+		static unsigned	ComponentSize(VertexComponentType type);
+
+	public:
+		VertexAttribute	attributes[ATTRIBUTE_COUNT];
+		unsigned		stride = 0u;
+};
+
+#endif
@@ -1,9 +1,14 @@
 #include "Globals.h"
 #include "Application.h"
 #include "ModuleEditor.h"
+#include <mutex>
+
+// Jobs log from worker threads, the buffers below are shared
+static std::mutex logMutex;
 
 void log(const char file[], int line, const char* format, ...) {
 	assert(format != nullptr);
+	std::lock_guard<std::mutex> lock(logMutex);
 
 	static char tmpStr[4096];
 	static char tmpStr2[4096];
@@ -14,6 +19,10 @@ void log(const char file[], int line, const char* format, ...) {
 	va_end(ap);
 	sprintf_s(tmpStr2, 4096, "\n%s(%d) : %s", file, line, tmpStr);
 	OutputDebugString(tmpStr2);
+	if (App != nullptr && App->headless) {
+		printf("%s", tmpStr2);
+	}
+
 	if (App != nullptr) {
 		sprintf_s(tmpStr, 4096, "%s \n", tmpStr);
 		if (App->editor->console != nullptr && App->editor->console->IsEnabled()) {